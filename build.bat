@@ -39,9 +39,81 @@ if %errorlevel% neq 0 goto :error
 %CC% %CFLAGS% -c %SRC_DIR%\utils.c -o %OBJ_DIR%\utils.o
 if %errorlevel% neq 0 goto :error
 
+%CC% %CFLAGS% -c %SRC_DIR%\lineedit.c -o %OBJ_DIR%\lineedit.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\completion.c -o %OBJ_DIR%\completion.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\prompt.c -o %OBJ_DIR%\prompt.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\output.c -o %OBJ_DIR%\output.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\server.c -o %OBJ_DIR%\server.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\zygote.c -o %OBJ_DIR%\zygote.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\cache.c -o %OBJ_DIR%\cache.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\pmap.c -o %OBJ_DIR%\pmap.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\tee.c -o %OBJ_DIR%\tee.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\spawnattr.c -o %OBJ_DIR%\spawnattr.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\limits.c -o %OBJ_DIR%\limits.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\jobsched.c -o %OBJ_DIR%\jobsched.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\jobs.c -o %OBJ_DIR%\jobs.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\vars.c -o %OBJ_DIR%\vars.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\script.c -o %OBJ_DIR%\script.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\read.c -o %OBJ_DIR%\read.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\expand.c -o %OBJ_DIR%\expand.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\arena.c -o %OBJ_DIR%\arena.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\arith.c -o %OBJ_DIR%\arith.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\rc.c -o %OBJ_DIR%\rc.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\alias.c -o %OBJ_DIR%\alias.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\xargs.c -o %OBJ_DIR%\xargs.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\redirect.c -o %OBJ_DIR%\redirect.o
+if %errorlevel% neq 0 goto :error
+
+%CC% %CFLAGS% -c %SRC_DIR%\watch.c -o %OBJ_DIR%\watch.o
+if %errorlevel% neq 0 goto :error
+
 echo.
 echo Linking executable...
-%CC% %OBJ_DIR%\main.o %OBJ_DIR%\parser.o %OBJ_DIR%\executor.o %OBJ_DIR%\builtins.o %OBJ_DIR%\history.o %OBJ_DIR%\utils.o %LDFLAGS% -o %BIN_DIR%\mini-shell.exe
+%CC% %OBJ_DIR%\main.o %OBJ_DIR%\parser.o %OBJ_DIR%\executor.o %OBJ_DIR%\builtins.o %OBJ_DIR%\history.o %OBJ_DIR%\utils.o %OBJ_DIR%\lineedit.o %OBJ_DIR%\completion.o %OBJ_DIR%\prompt.o %OBJ_DIR%\output.o %OBJ_DIR%\server.o %OBJ_DIR%\zygote.o %OBJ_DIR%\cache.o %OBJ_DIR%\pmap.o %OBJ_DIR%\tee.o %OBJ_DIR%\spawnattr.o %OBJ_DIR%\limits.o %OBJ_DIR%\jobsched.o %OBJ_DIR%\jobs.o %OBJ_DIR%\vars.o %OBJ_DIR%\script.o %OBJ_DIR%\read.o %OBJ_DIR%\expand.o %OBJ_DIR%\arena.o %OBJ_DIR%\arith.o %OBJ_DIR%\rc.o %OBJ_DIR%\alias.o %OBJ_DIR%\xargs.o %OBJ_DIR%\redirect.o %OBJ_DIR%\watch.o %LDFLAGS% -o %BIN_DIR%\mini-shell.exe
 if %errorlevel% neq 0 goto :error
 
 echo.
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
+#include <stdint.h>
 
 /* Windows-specific includes */
 #ifdef _WIN32
@@ -30,6 +31,16 @@
 #define MAX_NUM_TOKENS 64
 #define MAX_HISTORY_SIZE 100
 #define MAX_PATH_SIZE 256
+#define MAX_PROMPT_SIZE 4096
+#define MAX_TEE_FILES 8
+#define MAX_REDIRECTS 8
+#define SHELL_FD_BASE 10        /* descriptors the shell keeps start here */
+
+/* Command server frames: type byte, u32 big-endian length, payload */
+#define FRAME_HEADER_SIZE 5
+#define FRAME_STDOUT 'o'
+#define FRAME_STDERR 'e'
+#define FRAME_EXIT   'x'
 
 /* Color codes for better UI */
 #ifdef _WIN32
@@ -52,6 +63,31 @@
 #define COLOR_CYAN    "\x1b[36m"
 #endif
 
+/* Kinds of redirection in Command.redirects */
+enum {
+    REDIR_READ,             /* N< file */
+    REDIR_WRITE,            /* N> file */
+    REDIR_APPEND,           /* N>> file */
+    REDIR_RDWR,             /* N<> file */
+    REDIR_DUP,              /* N>&M, N<&M */
+    REDIR_CLOSE             /* N>&- */
+};
+
+typedef struct {
+    int fd;
+    int type;
+    int source;             /* REDIR_DUP: the descriptor copied */
+    char *file;
+} Redirect;
+
+/* Descriptors changed for a builtin or function, see redirect_push() */
+typedef struct {
+    int fd[MAX_REDIRECTS];
+    int saved[MAX_REDIRECTS];   /* copy of the old one, -1 if it was closed */
+    int count;
+    int out_fd;                 /* previous builtin output, -1 if unchanged */
+} RedirectSave;
+
 /* Command structure */
 typedef struct {
     char *tokens[MAX_NUM_TOKENS];
@@ -59,10 +95,61 @@ typedef struct {
     char *input_file;
     char *output_file;
     int append_output;
+    char *tee_files[MAX_TEE_FILES];     /* further > / >> targets of the output */
+    int tee_append[MAX_TEE_FILES];
+    int tee_count;
+    Redirect redirects[MAX_REDIRECTS];  /* all others, applied in order after < and > */
+    int redirect_count;
     int background;
     int pipe_count;
 } Command;
 
+/* Resource limits applied to spawned commands */
+enum {
+    SPAWN_LIMIT_CPU,        /* CPU time, seconds */
+    SPAWN_LIMIT_AS,         /* address space, bytes */
+    SPAWN_LIMIT_NOFILE,     /* open files */
+    SPAWN_LIMIT_NPROC,      /* processes of the user */
+    SPAWN_LIMIT_COUNT
+};
+#define SPAWN_LIMIT_UNLIMITED UINT64_MAX
+
+/* CPU sets of spawned commands, one bit per CPU */
+#define SPAWN_MAX_CPUS 1024
+#define SPAWN_CPU_WORDS (SPAWN_MAX_CPUS / 64)
+
+/* How jobs are placed on CPUs */
+enum {
+    SPAWN_POLICY_OFF,       /* leave placement to the kernel */
+    SPAWN_POLICY_SPREAD     /* background jobs round-robin, off the shell's CPU */
+};
+
+/* Attributes applied in a child between fork and exec */
+typedef struct {
+    uint8_t limit_soft_set[SPAWN_LIMIT_COUNT];
+    uint8_t limit_hard_set[SPAWN_LIMIT_COUNT];
+    uint64_t limit_soft[SPAWN_LIMIT_COUNT];
+    uint64_t limit_hard[SPAWN_LIMIT_COUNT];
+    uint8_t new_pgrp;                   /* run in a process group of its own */
+    uint8_t foreground;                 /* and take the terminal (with new_pgrp) */
+    uint8_t cpus_set;
+    uint8_t nice_set;
+    int32_t nice;                       /* absolute niceness */
+    uint64_t cpus[SPAWN_CPU_WORDS];
+} SpawnAttr;
+
+#ifndef _WIN32
+/* Copies of a command run together by pmap or xargs, see spawn_argv() */
+typedef struct {
+    pid_t pgid;             /* their process group, 0 before the first */
+    int foreground;         /* the group takes the terminal */
+    int running;
+} ArgvGroup;
+#endif
+
+/* Shell variable, see vars.c */
+typedef struct Var Var;
+
 /* History structure */
 typedef struct {
     char **commands;
@@ -70,8 +157,17 @@ typedef struct {
     int capacity;
 } History;
 
+/* Completion candidates for the word under the cursor */
+typedef struct {
+    char **items;
+    int count;
+    int capacity;
+} CompletionList;
+
 /* Parser functions - parser.c */
 Command* parse_command(char *input);
+Command* build_command(char **words, int count);
+int expand_aliases(char **words, int count, char **out);
 void free_command(Command *cmd);
 int tokenize(char *input, char **tokens);
 
@@ -79,12 +175,23 @@ int tokenize(char *input, char **tokens);
 int execute_command(Command *cmd);
 int execute_piped_commands(Command *cmd);
 int execute_with_redirection(Command *cmd);
+int execute_simple(char *input, int *exit_requested);
+int execute_words(char **words, int count, int *exit_requested);
+#ifndef _WIN32
+pid_t spawn_command(Command *cmd, int out_fd, int *via_zygote, int detach_fanout);
+int wait_command(Command *cmd, pid_t pid, int via_zygote);
+void init_subcommand(Command *inner, const Command *cmd, int first);
+int run_subcommand(Command *cmd, int first);
+pid_t spawn_argv(char **argv, int in_fd, int out_fd, ArgvGroup *group);
+int wait_argv(ArgvGroup *group, const pid_t *pids, int count, int *status);
+#endif
 #ifdef _WIN32
 char* find_executable(const char *command);
 #endif
 
 /* Built-in commands - builtins.c */
 int is_builtin(char *command);
+const char** get_builtin_names(void);
 int execute_builtin(Command *cmd);
 int builtin_cd(char **args);
 int builtin_exit(char **args);
@@ -94,6 +201,71 @@ int builtin_pwd(char **args);
 int builtin_echo(char **args);
 int builtin_export(char **args);
 int builtin_clear(char **args);
+int builtin_cache(Command *cmd);
+int builtin_stats(char **args);
+int builtin_pmap(Command *cmd);
+int builtin_xargs(Command *cmd);
+int builtin_tee(Command *cmd);
+int builtin_timeout(Command *cmd);
+int builtin_ulimit(char **args);
+int builtin_taskset(Command *cmd);
+int builtin_nice(Command *cmd);
+int builtin_jobsched(char **args);
+int builtin_jobs(char **args);
+int builtin_fg(char **args);
+int builtin_bg(char **args);
+int builtin_coproc(Command *cmd);
+int builtin_unset(char **args);
+int builtin_read(Command *cmd);
+int builtin_mapfile(Command *cmd);
+int builtin_alias(char **args);
+int builtin_unalias(char **args);
+int builtin_return(char **args);
+
+/* Command lists, loops and functions - script.c */
+int execute_line(char *input, int *exit_requested);
+int is_function(const char *name);
+int is_function_definition(const char *line);
+int call_function(Command *cmd, int *exit_requested);
+int unset_function(const char *name);
+
+/* Aliases - alias.c */
+char** alias_words(const char *name, int *count);
+
+/* Shell variables - vars.c */
+int valid_var_name(const char *name, size_t len);
+int var_set(const char *name, const char *value);
+int var_set_array(const char *name, char **items, size_t count);
+const char* var_get(const char *name);
+const char* var_lookup(const char *name, size_t len);
+const char* var_get_item(const char *name, size_t len, size_t index);
+size_t var_item_count(const char *name, size_t len);
+void var_unset(const char *name);
+void var_forget(const char *name);
+int is_assignment(const char *word);
+int assign_word(const char *word);
+Var* var_resolve(const char *name);
+unsigned long var_generation(void);
+const char* var_value(const Var *v);
+int var_assign(Var *v, const char *value);
+void var_swap_args(char ***args, int *count);
+int var_args(char ***args);
+
+/* Arithmetic - arith.c */
+int arith_eval(const char *expr, size_t len, int64_t *result);
+void arith_print_stats(void);
+
+/* Parameter expansion - expand.c */
+char* expand_word(const char *word);
+void expand_print_stats(void);
+
+/* Per-line arena - arena.c */
+void* arena_alloc(size_t size);
+char* arena_copy(const char *data, size_t len);
+void arena_reset(void);
+
+/* Buffered input of read and mapfile - read.c */
+void read_reset(void);
 
 /* History functions - history.c */
 History* init_history(void);
@@ -102,8 +274,110 @@ void print_history(History *hist);
 void free_history(History *hist);
 char* get_history_command(History *hist, int index);
 
-/* Utility functions - utils.c */
+/* Line editor - lineedit.c */
+char* read_command_line(const char *prompt);
+
+/* Tab completion - completion.c */
+void completion_init(void);
+void completion_path_changed(void);
+void completion_cleanup(void);
+int complete_word(const char *line, size_t pos, size_t *word_start, CompletionList *list);
+void free_completions(CompletionList *list);
+
+/* Prompt - prompt.c */
+void prompt_init(void);
+void prompt_cleanup(void);
+void update_cwd_cache(void);
+int build_prompt(char *buf, size_t size);
 void print_prompt(void);
+void prompt_command_finished(int status, double seconds);
+int prompt_update_fd(void);
+void prompt_consume_update(void);
+double now_seconds(void);
+
+/* Command server - server.c */
+int run_server(const char *socket_path);
+
+/* Spawn zygote - zygote.c */
+int zygote_start(void);
+int zygote_active(void);
+void zygote_stop(void);
+#ifndef _WIN32
+pid_t zygote_spawn(char **argv, const int fds[3], const char *cwd, const SpawnAttr *attr);
+int zygote_wait(pid_t pid, int *status);
+int zygote_fd(void);
+void zygote_set_notify(void (*notify)(pid_t pid, int status));
+void zygote_poll_notices(void);
+#endif
+
+/* Job control - jobs.c */
+void jobs_init(void);
+void jobs_cleanup(void);
+int jobs_interactive(void);
+#ifndef _WIN32
+int jobs_add(pid_t pgid, int via_zygote, const Command *cmd, int stopped);
+int job_wait(pid_t pid, int via_zygote, const Command *cmd);
+void jobs_foreground(pid_t pgid);
+void jobs_reclaim_terminal(void);
+void jobs_notify(pid_t pid, int status);
+int jobs_event_fds(int *fds);
+#endif
+void jobs_update(void);
+void jobs_report(void);
+
+/* Spawned command attributes - spawnattr.c */
+void spawn_attr_current(SpawnAttr *attr);
+int spawn_attr_apply(const SpawnAttr *attr);
+int spawn_limit_set(int which, int soft, int hard, uint64_t value);
+int spawn_limit_get(int which, int hard, uint64_t *value);
+void spawn_attr_restore(const SpawnAttr *attr);
+void spawn_attr_job(SpawnAttr *attr, int background);
+void spawn_set_cpus(const uint64_t *cpus);
+int spawn_set_nice(int increment);
+int spawn_set_policy(int policy, int increment);
+int spawn_get_policy(int *increment);
+
+/* Memoizing cache builtin - cache.c */
+void cache_print_stats(void);
+#ifndef _WIN32
+int cache_dir(char *buf, size_t size);
+#endif
+
+/* Re-running commands - watch.c */
+int builtin_on_change(Command *cmd);
+int builtin_watch(Command *cmd);
+
+/* Descriptor redirections - redirect.c */
+void redirect_init(void);
+int redirect_fd_usable(int fd);
+int redirect_take_slot(int fd);
+void redirect_free_slot(int slot);
+int redirect_apply(const Command *cmd);
+int redirect_push(const Command *cmd, RedirectSave *save, int builtin);
+void redirect_pop(RedirectSave *save);
+int redirect_user_fds(void);
+int builtin_exec(Command *cmd);
+
+/* Startup file - rc.c */
+void rc_load(void);
+
+/* Argument batching - xargs.c */
+void xargs_print_stats(void);
+
+/* Output fan-out - tee.c */
+int open_output_targets(Command *cmd, int *fds);
+int fanout(int in_fd, const int *fds, int count);
+
+/* Buffered builtin output - output.c */
+int out_write(const char *data, size_t len);
+int out_puts(const char *str);
+int out_printf(const char *fmt, ...);
+int out_flush(void);
+int out_set_fd(int fd);
+int out_get_fd(void);
+int out_sendfile(int in_fd, off_t offset, size_t len);
+
+/* Utility functions - utils.c */
 void print_error(char *message);
 void print_success(char *message);
 char* trim_whitespace(char *str);
@@ -112,11 +386,14 @@ void setup_signal_handlers(void);
 void handle_sigint(int sig);
 #ifndef _WIN32
 void handle_sigchld(int sig);
+int signal_fd(void);
+int consume_signals(void);
 #endif
 
 /* Global variables */
 extern History *g_history;
 extern int g_last_exit_status;
+extern char *g_cwd;
 #ifdef _WIN32
 extern volatile int g_interrupted;
 #else
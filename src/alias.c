@@ -0,0 +1,240 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+/*
+ * Aliases
+ *
+ *   alias [NAME[=VALUE]]    define NAME, or show one or all definitions
+ *   unalias [-a] NAME...    remove definitions
+ *
+ * VALUE is the rest of the line, so alias ll=ls -l needs no quotes; quotes
+ * around the whole value, as in other shells' rc files, are removed. The
+ * value is split into words once, when it is defined, and those words
+ * replace the first word of a command (see build_command() in parser.c).
+ */
+
+#define ALIAS_BUCKETS 64
+
+typedef struct Alias {
+    char *name;
+    char *value;
+    char **words;
+    int count;
+    struct Alias *next;
+} Alias;
+
+static Alias *g_aliases[ALIAS_BUCKETS];
+
+static unsigned int alias_hash(const char *name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    }
+    return h % ALIAS_BUCKETS;
+}
+
+static Alias** alias_link(const char *name) {
+    Alias **link = &g_aliases[alias_hash(name)];
+
+    while (*link && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void free_alias(Alias *a) {
+    for (int i = 0; i < a->count; i++) {
+        free(a->words[i]);
+    }
+    free(a->words);
+    free(a->value);
+    free(a->name);
+    free(a);
+}
+
+/**
+ * Words of the alias name, NULL if there is none
+ */
+char** alias_words(const char *name, int *count) {
+    Alias *a = *alias_link(name);
+
+    if (!a || a->count == 0) {
+        return NULL;
+    }
+    *count = a->count;
+    return a->words;
+}
+
+/**
+ * Define name as value, replacing an earlier definition
+ */
+static int alias_define(const char *name, const char *value) {
+    char *tokens[MAX_NUM_TOKENS];
+    char *copy = strdup(value);
+    int count = copy ? tokenize(copy, tokens) : -1;
+    Alias **link;
+    Alias *a;
+
+    free(copy);
+    if (count < 0) {
+        return -1;
+    }
+
+    a = (Alias*)calloc(1, sizeof(Alias));
+    if (!a || !(a->words = (char**)malloc((size_t)(count + 1) * sizeof(char*)))) {
+        for (int i = 0; i < count; i++) free(tokens[i]);
+        free(a);
+        return -1;
+    }
+    memcpy(a->words, tokens, (size_t)count * sizeof(char*));
+    a->words[count] = NULL;
+    a->count = count;
+    if (!(a->name = strdup(name)) || !(a->value = strdup(value))) {
+        free_alias(a);
+        return -1;
+    }
+
+    link = alias_link(name);
+    if (*link) {
+        a->next = (*link)->next;
+        free_alias(*link);
+    }
+    *link = a;
+    return 0;
+}
+
+static void print_alias(const Alias *a) {
+    out_printf("alias %s='%s'\n", a->name, a->value);
+}
+
+static int compare_aliases(const void *x, const void *y) {
+    return strcmp((*(Alias* const*)x)->name, (*(Alias* const*)y)->name);
+}
+
+/**
+ * Print every alias, sorted by name
+ */
+static int print_aliases(void) {
+    Alias **all = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+
+    for (int i = 0; i < ALIAS_BUCKETS; i++) {
+        for (Alias *a = g_aliases[i]; a; a = a->next) {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 16;
+                Alias **grown = (Alias**)realloc(all, cap * sizeof(Alias*));
+                if (!grown) {
+                    free(all);
+                    print_error("Memory allocation failed");
+                    return -1;
+                }
+                all = grown;
+            }
+            all[count++] = a;
+        }
+    }
+
+    if (count > 0) {
+        qsort(all, count, sizeof(Alias*), compare_aliases);
+    }
+    for (size_t i = 0; i < count; i++) {
+        print_alias(all[i]);
+    }
+    free(all);
+    return 0;
+}
+
+/**
+ * alias [NAME[=VALUE]]
+ */
+int builtin_alias(char **args) {
+    char line[MAX_INPUT_SIZE];
+    size_t len = 0;
+    char *eq;
+    char *value;
+
+    if (!args[1]) {
+        return print_aliases();
+    }
+
+    /* The value is the rest of the line */
+    line[0] = '\0';
+    for (int i = 1; args[i]; i++) {
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "%s%s", i > 1 ? " " : "", args[i]);
+        if (len >= sizeof(line)) {
+            print_error("alias: definition too long");
+            return -1;
+        }
+    }
+
+    if (!(eq = strchr(line, '='))) {
+        Alias *a = *alias_link(line);
+        if (!a) {
+            print_error("alias: not found");
+            return 1;
+        }
+        print_alias(a);
+        return 0;
+    }
+
+    *eq = '\0';
+    value = eq + 1;
+    if (*line == '\0' || strpbrk(line, " \t/$")) {
+        print_error("alias: invalid alias name");
+        return -1;
+    }
+
+    /* 'ls -l' and "ls -l" */
+    len = strlen(value);
+    if (len >= 2 && (value[0] == '\'' || value[0] == '"') && value[len - 1] == value[0]) {
+        value[len - 1] = '\0';
+        value++;
+    }
+
+    if (alias_define(line, value) != 0) {
+        print_error("alias: failed to define alias");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * unalias [-a] NAME...
+ */
+int builtin_unalias(char **args) {
+    int status = 0;
+
+    if (!args[1]) {
+        print_error("Usage: unalias [-a] NAME...");
+        return -1;
+    }
+
+    if (strcmp(args[1], "-a") == 0) {
+        for (int i = 0; i < ALIAS_BUCKETS; i++) {
+            while (g_aliases[i]) {
+                Alias *next = g_aliases[i]->next;
+                free_alias(g_aliases[i]);
+                g_aliases[i] = next;
+            }
+        }
+        return 0;
+    }
+
+    for (int i = 1; args[i]; i++) {
+        Alias **link = alias_link(args[i]);
+        Alias *a = *link;
+
+        if (!a) {
+            print_error("unalias: not found");
+            status = 1;
+            continue;
+        }
+        *link = a->next;
+        free_alias(a);
+    }
+    return status;
+}
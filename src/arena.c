@@ -0,0 +1,86 @@
+#include "../include/shell.h"
+
+/*
+ * Per-line arena
+ *
+ * Scratch memory for a command while it is being parsed: expanded words and
+ * the intermediate strings of parameter expansion are bump-allocated here
+ * and released all at once by arena_reset() when the next command is parsed.
+ * One chunk is kept across resets, so a loop running the same command over
+ * and over does not touch malloc for its expansions at all.
+ */
+
+#define ARENA_CHUNK_SIZE 8192
+#define ARENA_ALIGN 16
+
+typedef struct Chunk {
+    struct Chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} Chunk;
+
+static Chunk *g_arena = NULL;
+
+/**
+ * Allocate size bytes that live until the next arena_reset()
+ */
+void* arena_alloc(size_t size) {
+    void *ptr;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!g_arena || g_arena->used + size > g_arena->size) {
+        size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        Chunk *chunk = (Chunk*)malloc(sizeof(Chunk) + cap);
+
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->next = g_arena;
+        chunk->size = cap;
+        chunk->used = 0;
+        g_arena = chunk;
+    }
+
+    ptr = g_arena->data + g_arena->used;
+    g_arena->used += size;
+    return ptr;
+}
+
+/**
+ * Copy len bytes into the arena as a string
+ */
+char* arena_copy(const char *data, size_t len) {
+    char *copy = (char*)arena_alloc(len + 1);
+
+    if (copy) {
+        memcpy(copy, data, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * Release everything allocated since the last reset
+ */
+void arena_reset(void) {
+    Chunk *keep = g_arena;
+
+    if (!g_arena) {
+        return;
+    }
+
+    /* Keep the largest chunk only */
+    for (Chunk *chunk = g_arena->next; chunk; chunk = chunk->next) {
+        if (chunk->size > keep->size) keep = chunk;
+    }
+    while (g_arena) {
+        Chunk *next = g_arena->next;
+        if (g_arena != keep) free(g_arena);
+        g_arena = next;
+    }
+
+    keep->next = NULL;
+    keep->used = 0;
+    g_arena = keep;
+}
@@ -0,0 +1,1018 @@
+#include "../include/shell.h"
+#include <ctype.h>
+
+/*
+ * Arithmetic
+ *
+ *   $(( expression ))       expands to the value of expression
+ *   (( expression ))        succeeds when it is not 0
+ *
+ * Integers are 64-bit and wrap around on overflow. The operators are those
+ * of C plus ** for powers, from the highest precedence to the lowest:
+ *
+ *   id++ id--   ++id --id   - + ! ~   **   * / %   + -   << >>
+ *   < <= > >=   == !=   &   ^   |   &&   ||   ?:
+ *   = *= /= %= += -= <<= >>= &= ^= |=   ,
+ *
+ * Numbers are decimal, 0x hex, 0 octal or BASE#DIGITS. Variables are named
+ * with or without $; the value of one is itself evaluated as an expression,
+ * and an unset or empty one is 0. Other expansions ($?, ${#NAME}, ...) are
+ * done before the expression is parsed.
+ *
+ * An expression is parsed into a tree, folding constant parts as it goes,
+ * and the tree is compiled into code for a small stack machine. Each
+ * variable gets a slot holding its handle in the variable table, which is
+ * looked up again only after a variable has been removed. Compiled
+ * expressions are kept in a cache keyed by their text, so the (( i++ )) of a
+ * loop is parsed once and afterwards only runs.
+ */
+
+#define ARITH_CACHE_SIZE 64
+#define ARITH_STACK_SIZE 128
+#define ARITH_MAX_NESTING 64    /* parentheses */
+#define ARITH_MAX_DEPTH 32      /* variables whose values are expressions */
+
+/* Instructions; the unary and binary operators double as tree operators */
+enum {
+    OP_NUM,                 /* push value */
+    OP_LOAD,                /* push variable arg */
+    OP_STORE,               /* set variable arg to the top */
+    OP_POP,
+    OP_JZ,                  /* pop, jump to arg if 0 */
+    OP_JNZ,                 /* pop, jump to arg if not 0 */
+    OP_JMP,
+    OP_NEG,                 /* unary */
+    OP_NOT,
+    OP_BITNOT,
+    OP_BOOL,                /* 0 or 1 */
+    OP_MUL,                 /* binary */
+    OP_DIV,
+    OP_MOD,
+    OP_ADD,
+    OP_SUB,
+    OP_SHL,
+    OP_SHR,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_XOR,
+    OP_OR,
+    OP_POW
+};
+
+/* Tree nodes */
+enum {
+    N_NUM,
+    N_VAR,
+    N_UNARY,                /* op a */
+    N_BINARY,               /* a op b */
+    N_AND,                  /* a && b */
+    N_OR,                   /* a || b */
+    N_COND,                 /* a ? b : c */
+    N_ASSIGN,               /* slot op= a; op -1 for = */
+    N_PREINC,               /* ++slot, --slot: value is the step */
+    N_POSTINC,              /* slot++, slot-- */
+    N_COMMA                 /* a, b */
+};
+
+typedef struct {
+    int kind;
+    int op;
+    int64_t value;
+    int slot;
+    int a, b, c;
+} Node;
+
+typedef struct {
+    int op;
+    int arg;
+    int64_t value;
+} Insn;
+
+typedef struct {
+    char *name;
+    Var *var;               /* NULL: exported, looked up by name */
+    unsigned long generation;   /* of var; 0: not resolved yet */
+} Slot;
+
+typedef struct {
+    char *text;             /* cache key; NULL: free entry */
+    size_t text_len;
+    Insn *code;
+    int code_len;
+    int code_cap;
+    Slot *slots;
+    int slot_count;
+} Expr;
+
+typedef struct {
+    const char *s;
+    size_t n;
+    size_t pos;
+    int nesting;
+    const char *error;      /* the first error found */
+    Node *nodes;
+    int node_count;
+    int node_cap;
+    Expr *expr;             /* receives the slots and the code */
+    int depth;              /* stack depth after the last instruction */
+} Compiler;
+
+typedef struct {
+    const char *text;
+    const char *not_next;   /* characters that make it another operator */
+    int op;
+} Operator;
+
+static Expr g_exprs[ARITH_CACHE_SIZE];
+static unsigned long g_expr_hits = 0;
+static unsigned long g_expr_compiles = 0;
+static int g_depth = 0;
+
+/* Binary operators from | to * / %, by increasing precedence */
+#define BINARY_LEVELS 8
+static const Operator g_binary[BINARY_LEVELS][5] = {
+    { { "|", "|=", OP_OR } },
+    { { "^", "=", OP_XOR } },
+    { { "&", "&=", OP_AND } },
+    { { "==", "", OP_EQ }, { "!=", "", OP_NE } },
+    { { "<=", "", OP_LE }, { ">=", "", OP_GE }, { "<", "<=", OP_LT }, { ">", ">=", OP_GT } },
+    { { "<<", "=", OP_SHL }, { ">>", "=", OP_SHR } },
+    { { "+", "=", OP_ADD }, { "-", "=", OP_SUB } },
+    { { "*", "*=", OP_MUL }, { "/", "=", OP_DIV }, { "%", "=", OP_MOD } }
+};
+
+static const Operator g_assign[] = {
+    { "=", "=", -1 },
+    { "*=", "", OP_MUL }, { "/=", "", OP_DIV }, { "%=", "", OP_MOD },
+    { "+=", "", OP_ADD }, { "-=", "", OP_SUB },
+    { "<<=", "", OP_SHL }, { ">>=", "", OP_SHR },
+    { "&=", "", OP_AND }, { "^=", "", OP_XOR }, { "|=", "", OP_OR },
+    { NULL, NULL, 0 }
+};
+
+static int value_of(const char *text, int64_t *value);
+
+static void arith_error(const char *message, const char *text, size_t len) {
+    char buf[256];
+
+    while (len > 0 && isspace((unsigned char)*text)) {
+        text++;
+        len--;
+    }
+    while (len > 0 && isspace((unsigned char)text[len - 1])) len--;
+    snprintf(buf, sizeof(buf), "arithmetic: %s in '%.*s'", message, (int)len, text);
+    print_error(buf);
+}
+
+static int64_t unary_op(int op, int64_t a) {
+    switch (op) {
+    case OP_NEG:    return (int64_t)(0 - (uint64_t)a);
+    case OP_NOT:    return !a;
+    case OP_BITNOT: return ~a;
+    default:        return a != 0;
+    }
+}
+
+/**
+ * Apply a binary operator; returns an error message, NULL on success
+ */
+static const char* binary_op(int op, int64_t a, int64_t b, int64_t *result) {
+    uint64_t ua = (uint64_t)a;
+    uint64_t ub = (uint64_t)b;
+
+    switch (op) {
+    case OP_MUL: *result = (int64_t)(ua * ub); break;
+    case OP_DIV:
+    case OP_MOD:
+        if (b == 0) {
+            return "division by 0";
+        }
+        /* INT64_MIN / -1 does not fit */
+        if (b == -1) {
+            *result = op == OP_DIV ? (int64_t)(0 - ua) : 0;
+        } else {
+            *result = op == OP_DIV ? a / b : a % b;
+        }
+        break;
+    case OP_ADD: *result = (int64_t)(ua + ub); break;
+    case OP_SUB: *result = (int64_t)(ua - ub); break;
+    case OP_SHL: *result = (int64_t)(ua << (ub & 63)); break;
+    case OP_SHR: *result = a >> (ub & 63); break;
+    case OP_LT:  *result = a < b; break;
+    case OP_LE:  *result = a <= b; break;
+    case OP_GT:  *result = a > b; break;
+    case OP_GE:  *result = a >= b; break;
+    case OP_EQ:  *result = a == b; break;
+    case OP_NE:  *result = a != b; break;
+    case OP_AND: *result = a & b; break;
+    case OP_XOR: *result = a ^ b; break;
+    case OP_OR:  *result = a | b; break;
+    case OP_POW: {
+        uint64_t power = 1;
+        if (b < 0) {
+            return "exponent less than 0";
+        }
+        for (; ub; ub >>= 1, ua *= ua) {
+            if (ub & 1) power *= ua;
+        }
+        *result = (int64_t)power;
+        break;
+    }
+    }
+    return NULL;
+}
+
+static int digit_value(char ch, int base) {
+    if (isdigit((unsigned char)ch)) return ch - '0';
+    if (islower((unsigned char)ch)) return ch - 'a' + 10;
+    if (isupper((unsigned char)ch)) return ch - 'A' + (base <= 36 ? 10 : 36);
+    if (ch == '@') return 62;
+    if (ch == '_') return 63;
+    return -1;
+}
+
+/**
+ * Parse the number at s[*pos], which starts with a digit
+ * Returns 0 and advances *pos past it, -1 if a digit is out of range
+ */
+static int parse_number(const char *s, size_t n, size_t *pos, int64_t *value) {
+    size_t i = *pos;
+    size_t end = i;
+    uint64_t v = 0;
+    int base = 10;
+
+    while (end < n && (isalnum((unsigned char)s[end]) || s[end] == '#' || s[end] == '@' || s[end] == '_')) {
+        end++;
+    }
+
+    const char *hash = (const char*)memchr(s + i, '#', end - i);
+    if (hash) {
+        for (base = 0; s + i < hash; i++) {
+            if (!isdigit((unsigned char)s[i]) || (base = base * 10 + (s[i] - '0')) > 64) {
+                return -1;
+            }
+        }
+        if (base < 2 || ++i == end) {
+            return -1;
+        }
+    } else if (end - i > 2 && s[i] == '0' && (s[i + 1] == 'x' || s[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    } else if (end - i > 1 && s[i] == '0') {
+        base = 8;
+        i++;
+    }
+
+    for (; i < end; i++) {
+        int d = digit_value(s[i], base);
+        if (d < 0 || d >= base) {
+            return -1;
+        }
+        v = v * (uint64_t)base + (uint64_t)d;
+    }
+    *pos = end;
+    *value = (int64_t)v;
+    return 0;
+}
+
+/* Parser */
+
+static int fail(Compiler *c, const char *error) {
+    if (!c->error) {
+        c->error = error;
+    }
+    return -1;
+}
+
+static void skip_blanks(Compiler *c) {
+    while (c->pos < c->n && isspace((unsigned char)c->s[c->pos])) c->pos++;
+}
+
+/**
+ * Consume op unless it is followed by one of the characters in not_next
+ */
+static int accept(Compiler *c, const char *op, const char *not_next) {
+    size_t len = strlen(op);
+
+    skip_blanks(c);
+    if (c->pos + len > c->n || memcmp(c->s + c->pos, op, len) != 0) {
+        return 0;
+    }
+    if (c->pos + len < c->n && c->s[c->pos + len] != '\0' && strchr(not_next, c->s[c->pos + len])) {
+        return 0;
+    }
+    c->pos += len;
+    return 1;
+}
+
+static int new_node(Compiler *c, int kind, int op, int a, int b) {
+    Node *node;
+
+    if (c->node_count == c->node_cap) {
+        int cap = c->node_cap ? c->node_cap * 2 : 32;
+        Node *grown = (Node*)realloc(c->nodes, (size_t)cap * sizeof(Node));
+        if (!grown) {
+            return fail(c, "out of memory");
+        }
+        c->nodes = grown;
+        c->node_cap = cap;
+    }
+    node = &c->nodes[c->node_count];
+    node->kind = kind;
+    node->op = op;
+    node->value = 0;
+    node->slot = -1;
+    node->a = a;
+    node->b = b;
+    node->c = -1;
+    return c->node_count++;
+}
+
+static int is_const(Compiler *c, int i) {
+    return c->nodes[i].kind == N_NUM;
+}
+
+static int new_num(Compiler *c, int64_t value) {
+    int i = new_node(c, N_NUM, 0, -1, -1);
+
+    if (i >= 0) {
+        c->nodes[i].value = value;
+    }
+    return i;
+}
+
+static int new_unary(Compiler *c, int op, int a) {
+    if (is_const(c, a)) {
+        c->nodes[a].value = unary_op(op, c->nodes[a].value);
+        return a;
+    }
+    return new_node(c, N_UNARY, op, a, -1);
+}
+
+static int new_binary(Compiler *c, int op, int a, int b) {
+    int64_t value;
+
+    /* An error such as 1/0 is left for run time */
+    if (is_const(c, a) && is_const(c, b) &&
+        binary_op(op, c->nodes[a].value, c->nodes[b].value, &value) == NULL) {
+        c->nodes[a].value = value;
+        return a;
+    }
+    return new_node(c, N_BINARY, op, a, b);
+}
+
+/**
+ * a && b or a || b; with a constant, b alone or nothing is left
+ */
+static int new_logical(Compiler *c, int kind, int a, int b) {
+    if (is_const(c, a)) {
+        int64_t value = c->nodes[a].value;
+
+        if (kind == N_AND && value == 0) {
+            return new_num(c, 0);
+        }
+        if (kind == N_OR && value != 0) {
+            return new_num(c, 1);
+        }
+        return new_unary(c, OP_BOOL, b);
+    }
+    return new_node(c, kind, 0, a, b);
+}
+
+static int new_variable_node(Compiler *c, int kind, int op, int slot, int a) {
+    int i = new_node(c, kind, op, a, -1);
+
+    if (i >= 0) {
+        c->nodes[i].slot = slot;
+    }
+    return i;
+}
+
+/**
+ * Slot of the variable name[0..len), added if new
+ */
+static int add_slot(Compiler *c, const char *name, size_t len) {
+    Expr *e = c->expr;
+    Slot *grown;
+
+    for (int i = 0; i < e->slot_count; i++) {
+        if (strncmp(e->slots[i].name, name, len) == 0 && e->slots[i].name[len] == '\0') {
+            return i;
+        }
+    }
+
+    grown = (Slot*)realloc(e->slots, (size_t)(e->slot_count + 1) * sizeof(Slot));
+    if (!grown) {
+        return fail(c, "out of memory");
+    }
+    e->slots = grown;
+    if (!(grown[e->slot_count].name = (char*)malloc(len + 1))) {
+        return fail(c, "out of memory");
+    }
+    memcpy(grown[e->slot_count].name, name, len);
+    grown[e->slot_count].name[len] = '\0';
+    grown[e->slot_count].var = NULL;
+    grown[e->slot_count].generation = 0;
+    return e->slot_count++;
+}
+
+/**
+ * Parse a variable name, $NAME or ${NAME}
+ * Returns its slot, or -1 with nothing consumed when there is none
+ */
+static int parse_variable(Compiler *c) {
+    size_t start;
+    size_t end;
+    int braced;
+
+    skip_blanks(c);
+    start = c->pos;
+    if (c->pos < c->n && c->s[c->pos] == '$') c->pos++;
+    braced = c->pos > start && c->pos < c->n && c->s[c->pos] == '{';
+    if (braced) c->pos++;
+
+    end = c->pos;
+    while (end < c->n && (isalnum((unsigned char)c->s[end]) || c->s[end] == '_')) end++;
+    if (end == c->pos || isdigit((unsigned char)c->s[c->pos]) || end - c->pos > 255 ||
+        (braced && (end == c->n || c->s[end] != '}'))) {
+        c->pos = start;
+        return -1;
+    }
+
+    int slot = add_slot(c, c->s + c->pos, end - c->pos);
+    c->pos = end + (braced ? 1 : 0);
+    return slot;
+}
+
+static int parse_comma(Compiler *c);
+static int parse_assign(Compiler *c);
+static int parse_unary(Compiler *c);
+
+static int parse_primary(Compiler *c) {
+    int slot;
+    int node;
+
+    skip_blanks(c);
+    if (c->pos < c->n && c->s[c->pos] == '(') {
+        if (++c->nesting > ARITH_MAX_NESTING) {
+            return fail(c, "expression too deeply nested");
+        }
+        c->pos++;
+        node = parse_comma(c);
+        c->nesting--;
+        if (node >= 0 && !accept(c, ")", "")) {
+            return fail(c, "missing )");
+        }
+        return node;
+    }
+
+    if (c->pos < c->n && isdigit((unsigned char)c->s[c->pos])) {
+        int64_t value;
+        if (parse_number(c->s, c->n, &c->pos, &value) != 0) {
+            return fail(c, "value too great for base");
+        }
+        return new_num(c, value);
+    }
+
+    if ((slot = parse_variable(c)) < 0) {
+        return fail(c, "operand expected");
+    }
+    if (accept(c, "++", "") || accept(c, "--", "")) {
+        node = new_variable_node(c, N_POSTINC, 0, slot, -1);
+        if (node >= 0) c->nodes[node].value = c->s[c->pos - 1] == '+' ? 1 : -1;
+        return node;
+    }
+    return new_variable_node(c, N_VAR, 0, slot, -1);
+}
+
+static int parse_power(Compiler *c) {
+    int base = parse_unary(c);
+
+    if (base >= 0 && accept(c, "**", "")) {
+        int exponent = parse_power(c);
+        return exponent < 0 ? -1 : new_binary(c, OP_POW, base, exponent);
+    }
+    return base;
+}
+
+static int parse_unary(Compiler *c) {
+    size_t start;
+    int node;
+
+    skip_blanks(c);
+    start = c->pos;
+
+    /* ++NAME and --NAME; otherwise --5 is -(-5) */
+    if (accept(c, "++", "") || accept(c, "--", "")) {
+        int slot = parse_variable(c);
+        if (slot >= 0) {
+            node = new_variable_node(c, N_PREINC, 0, slot, -1);
+            if (node >= 0) c->nodes[node].value = c->s[start] == '+' ? 1 : -1;
+            return node;
+        }
+        if (c->error) {
+            return -1;
+        }
+        c->pos = start;
+    }
+
+    if (accept(c, "-", "")) {
+        return (node = parse_unary(c)) < 0 ? -1 : new_unary(c, OP_NEG, node);
+    }
+    if (accept(c, "+", "")) {
+        return parse_unary(c);
+    }
+    if (accept(c, "!", "")) {
+        return (node = parse_unary(c)) < 0 ? -1 : new_unary(c, OP_NOT, node);
+    }
+    if (accept(c, "~", "")) {
+        return (node = parse_unary(c)) < 0 ? -1 : new_unary(c, OP_BITNOT, node);
+    }
+    return parse_primary(c);
+}
+
+static int parse_binary(Compiler *c, int level) {
+    int left;
+
+    if (level == BINARY_LEVELS) {
+        return parse_power(c);
+    }
+
+    left = parse_binary(c, level + 1);
+    while (left >= 0) {
+        const Operator *op = g_binary[level];
+        int right;
+
+        while (op->text && !accept(c, op->text, op->not_next)) op++;
+        if (!op->text) {
+            break;
+        }
+        right = parse_binary(c, level + 1);
+        left = right < 0 ? -1 : new_binary(c, op->op, left, right);
+    }
+    return left;
+}
+
+static int parse_and(Compiler *c) {
+    int left = parse_binary(c, 0);
+
+    while (left >= 0 && accept(c, "&&", "")) {
+        int right = parse_binary(c, 0);
+        left = right < 0 ? -1 : new_logical(c, N_AND, left, right);
+    }
+    return left;
+}
+
+static int parse_or(Compiler *c) {
+    int left = parse_and(c);
+
+    while (left >= 0 && accept(c, "||", "")) {
+        int right = parse_and(c);
+        left = right < 0 ? -1 : new_logical(c, N_OR, left, right);
+    }
+    return left;
+}
+
+static int parse_cond(Compiler *c) {
+    int cond = parse_or(c);
+    int a;
+    int b;
+
+    if (cond < 0 || !accept(c, "?", "")) {
+        return cond;
+    }
+    if ((a = parse_assign(c)) < 0) {
+        return -1;
+    }
+    if (!accept(c, ":", "")) {
+        return fail(c, "expected : in ?:");
+    }
+    if ((b = parse_cond(c)) < 0) {
+        return -1;
+    }
+
+    if (is_const(c, cond)) {
+        return c->nodes[cond].value ? a : b;
+    }
+    int node = new_node(c, N_COND, 0, cond, a);
+    if (node >= 0) c->nodes[node].c = b;
+    return node;
+}
+
+static int parse_assign(Compiler *c) {
+    int left = parse_cond(c);
+
+    if (left < 0) {
+        return -1;
+    }
+    for (const Operator *op = g_assign; op->text; op++) {
+        if (accept(c, op->text, op->not_next)) {
+            int right;
+
+            if (c->nodes[left].kind != N_VAR) {
+                return fail(c, "attempted assignment to non-variable");
+            }
+            if ((right = parse_assign(c)) < 0) {
+                return -1;
+            }
+            return new_variable_node(c, N_ASSIGN, op->op, c->nodes[left].slot, right);
+        }
+    }
+    return left;
+}
+
+static int parse_comma(Compiler *c) {
+    int left = parse_assign(c);
+
+    while (left >= 0 && accept(c, ",", "")) {
+        int right = parse_assign(c);
+
+        if (right < 0) {
+            return -1;
+        }
+        /* A constant on the left has no effect */
+        left = is_const(c, left) ? right : new_node(c, N_COMMA, 0, left, right);
+    }
+    return left;
+}
+
+/* Code generation */
+
+static int emit(Compiler *c, int op, int arg, int64_t value) {
+    Expr *e = c->expr;
+
+    if (e->code_len == e->code_cap) {
+        int cap = e->code_cap ? e->code_cap * 2 : 16;
+        Insn *grown = (Insn*)realloc(e->code, (size_t)cap * sizeof(Insn));
+        if (!grown) {
+            return fail(c, "out of memory");
+        }
+        e->code = grown;
+        e->code_cap = cap;
+    }
+
+    if (op == OP_NUM || op == OP_LOAD) {
+        c->depth++;
+    } else if (op == OP_POP || op == OP_JZ || op == OP_JNZ || op >= OP_MUL) {
+        c->depth--;
+    }
+    if (c->depth > ARITH_STACK_SIZE) {
+        return fail(c, "expression too complex");
+    }
+
+    e->code[e->code_len].op = op;
+    e->code[e->code_len].arg = arg;
+    e->code[e->code_len].value = value;
+    return e->code_len++;
+}
+
+/**
+ * Point the jump at index at the next instruction
+ */
+static void patch(Compiler *c, int jump) {
+    c->expr->code[jump].arg = c->expr->code_len;
+}
+
+static int gen(Compiler *c, int i) {
+    Node n = c->nodes[i];
+    int jump;
+    int end;
+    int depth;
+
+    switch (n.kind) {
+    case N_NUM:
+        return emit(c, OP_NUM, 0, n.value) < 0 ? -1 : 0;
+    case N_VAR:
+        return emit(c, OP_LOAD, n.slot, 0) < 0 ? -1 : 0;
+    case N_UNARY:
+        return gen(c, n.a) != 0 || emit(c, n.op, 0, 0) < 0 ? -1 : 0;
+    case N_BINARY:
+        return gen(c, n.a) != 0 || gen(c, n.b) != 0 || emit(c, n.op, 0, 0) < 0 ? -1 : 0;
+
+    case N_AND:
+    case N_OR:
+        /* b is evaluated only when a does not decide the result */
+        if (gen(c, n.a) != 0 || (jump = emit(c, n.kind == N_AND ? OP_JZ : OP_JNZ, 0, 0)) < 0) {
+            return -1;
+        }
+        depth = c->depth;
+        if (gen(c, n.b) != 0 || emit(c, OP_BOOL, 0, 0) < 0 || (end = emit(c, OP_JMP, 0, 0)) < 0) {
+            return -1;
+        }
+        patch(c, jump);
+        c->depth = depth;
+        if (emit(c, OP_NUM, 0, n.kind == N_OR) < 0) {
+            return -1;
+        }
+        patch(c, end);
+        return 0;
+
+    case N_COND:
+        if (gen(c, n.a) != 0 || (jump = emit(c, OP_JZ, 0, 0)) < 0) {
+            return -1;
+        }
+        depth = c->depth;
+        if (gen(c, n.b) != 0 || (end = emit(c, OP_JMP, 0, 0)) < 0) {
+            return -1;
+        }
+        patch(c, jump);
+        c->depth = depth;
+        if (gen(c, n.c) != 0) {
+            return -1;
+        }
+        patch(c, end);
+        return 0;
+
+    case N_ASSIGN:
+        if (n.op >= 0 && emit(c, OP_LOAD, n.slot, 0) < 0) {
+            return -1;
+        }
+        if (gen(c, n.a) != 0 || (n.op >= 0 && emit(c, n.op, 0, 0) < 0)) {
+            return -1;
+        }
+        return emit(c, OP_STORE, n.slot, 0) < 0 ? -1 : 0;
+
+    case N_PREINC:
+        return emit(c, OP_LOAD, n.slot, 0) < 0 || emit(c, OP_NUM, 0, n.value) < 0 ||
+               emit(c, OP_ADD, 0, 0) < 0 || emit(c, OP_STORE, n.slot, 0) < 0 ? -1 : 0;
+
+    case N_POSTINC:
+        /* Leaves the old value */
+        return emit(c, OP_LOAD, n.slot, 0) < 0 || emit(c, OP_LOAD, n.slot, 0) < 0 ||
+               emit(c, OP_NUM, 0, n.value) < 0 || emit(c, OP_ADD, 0, 0) < 0 ||
+               emit(c, OP_STORE, n.slot, 0) < 0 || emit(c, OP_POP, 0, 0) < 0 ? -1 : 0;
+
+    case N_COMMA:
+        return gen(c, n.a) != 0 || emit(c, OP_POP, 0, 0) < 0 || gen(c, n.b) != 0 ? -1 : 0;
+    }
+    return -1;
+}
+
+static void free_expr(Expr *e) {
+    for (int i = 0; i < e->slot_count; i++) {
+        free(e->slots[i].name);
+    }
+    free(e->slots);
+    free(e->code);
+    free(e->text);
+    memset(e, 0, sizeof(Expr));
+}
+
+/**
+ * Compile text[0..len) into e
+ */
+static int compile(const char *text, size_t len, Expr *e) {
+    Compiler c;
+    int root;
+
+    memset(&c, 0, sizeof(c));
+    memset(e, 0, sizeof(Expr));
+    c.s = text;
+    c.n = len;
+    c.expr = e;
+
+    skip_blanks(&c);
+    root = c.pos == c.n ? new_num(&c, 0) : parse_comma(&c);
+    if (root >= 0) {
+        skip_blanks(&c);
+        if (c.pos < c.n) {
+            root = fail(&c, "syntax error in expression");
+        }
+    }
+    if (root >= 0) {
+        gen(&c, root);
+    }
+    free(c.nodes);
+
+    if (c.error) {
+        arith_error(c.error, text, len);
+        free_expr(e);
+        return -1;
+    }
+    return 0;
+}
+
+/* Evaluation */
+
+/**
+ * Refresh the handle of a slot if variables were removed since
+ */
+static void resolve(Slot *slot) {
+    if (slot->generation != var_generation()) {
+        slot->var = var_resolve(slot->name);
+        slot->generation = var_generation();
+    }
+}
+
+static int load(Slot *slot, int64_t *value) {
+    resolve(slot);
+    return value_of(slot->var ? var_value(slot->var) : var_get(slot->name), value);
+}
+
+static int store(Slot *slot, int64_t value) {
+    char num[32];
+
+    resolve(slot);
+    snprintf(num, sizeof(num), "%lld", (long long)value);
+    if ((slot->var ? var_assign(slot->var, num) : var_set(slot->name, num)) != 0) {
+        print_error("Failed to set variable");
+        return -1;
+    }
+    return 0;
+}
+
+static int run(Expr *e, const char *text, size_t len, int64_t *result) {
+    int64_t stack[ARITH_STACK_SIZE];
+    int sp = 0;
+    const char *error;
+
+    for (int pc = 0; pc < e->code_len; pc++) {
+        const Insn *in = &e->code[pc];
+
+        switch (in->op) {
+        case OP_NUM:
+            stack[sp++] = in->value;
+            break;
+        case OP_LOAD:
+            if (load(&e->slots[in->arg], &stack[sp++]) != 0) {
+                return -1;
+            }
+            break;
+        case OP_STORE:
+            if (store(&e->slots[in->arg], stack[sp - 1]) != 0) {
+                return -1;
+            }
+            break;
+        case OP_POP:
+            sp--;
+            break;
+        case OP_JZ:
+            if (stack[--sp] == 0) pc = in->arg - 1;
+            break;
+        case OP_JNZ:
+            if (stack[--sp] != 0) pc = in->arg - 1;
+            break;
+        case OP_JMP:
+            pc = in->arg - 1;
+            break;
+        default:
+            if (in->op < OP_MUL) {
+                stack[sp - 1] = unary_op(in->op, stack[sp - 1]);
+                break;
+            }
+            sp--;
+            if ((error = binary_op(in->op, stack[sp - 1], stack[sp], &stack[sp - 1])) != NULL) {
+                arith_error(error, text, len);
+                return -1;
+            }
+        }
+    }
+
+    *result = stack[0];
+    return 0;
+}
+
+/**
+ * Integer value of a variable: a number, or an expression evaluated in turn
+ */
+static int value_of(const char *text, int64_t *value) {
+    size_t len;
+    size_t i = 0;
+    int negative = 0;
+    Expr e;
+    int rc;
+
+    *value = 0;
+    if (!text) {
+        return 0;
+    }
+    len = strlen(text);
+    while (i < len && isspace((unsigned char)text[i])) i++;
+    if (i == len) {
+        return 0;
+    }
+
+    if (text[i] == '-' || text[i] == '+') {
+        negative = text[i++] == '-';
+    }
+    if (i < len && isdigit((unsigned char)text[i])) {
+        int64_t v;
+        size_t pos = i;
+
+        if (parse_number(text, len, &pos, &v) == 0) {
+            while (pos < len && isspace((unsigned char)text[pos])) pos++;
+            if (pos == len) {
+                *value = negative ? (int64_t)(0 - (uint64_t)v) : v;
+                return 0;
+            }
+        }
+    }
+
+    /* Not cached: the expression being run may be in the cache slot */
+    if (g_depth >= ARITH_MAX_DEPTH) {
+        arith_error("expression recursion level exceeded", text, len);
+        return -1;
+    }
+    if (compile(text, len, &e) != 0) {
+        return -1;
+    }
+    g_depth++;
+    rc = run(&e, text, len, value);
+    g_depth--;
+    free_expr(&e);
+    return rc;
+}
+
+/**
+ * Check for expansions other than $NAME and ${NAME}
+ */
+static int needs_expansion(const char *text, size_t len) {
+    for (const char *p = (const char*)memchr(text, '$', len); p; ) {
+        size_t i = (size_t)(p - text) + 1;
+
+        if (i < len && text[i] == '{') {
+            size_t end = ++i;
+            while (end < len && (isalnum((unsigned char)text[end]) || text[end] == '_')) end++;
+            if (end == i || end == len || text[end] != '}') {
+                return 1;
+            }
+        } else if (i == len || !(isalpha((unsigned char)text[i]) || text[i] == '_')) {
+            return 1;
+        }
+        p = (const char*)memchr(text + i, '$', len - i);
+    }
+    return 0;
+}
+
+/**
+ * Compiled form of text[0..len), from the cache if possible
+ */
+static Expr* get_expr(const char *text, size_t len) {
+    unsigned int h = 2166136261u;
+    Expr *e;
+    Expr fresh;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)text[i]) * 16777619u;
+    }
+    e = &g_exprs[h % ARITH_CACHE_SIZE];
+
+    if (e->text && e->text_len == len && memcmp(e->text, text, len) == 0) {
+        g_expr_hits++;
+        return e;
+    }
+
+    if (compile(text, len, &fresh) != 0) {
+        return NULL;
+    }
+    if (!(fresh.text = (char*)malloc(len + 1))) {
+        free_expr(&fresh);
+        print_error("Memory allocation failed");
+        return NULL;
+    }
+    memcpy(fresh.text, text, len);
+    fresh.text[len] = '\0';
+    fresh.text_len = len;
+
+    free_expr(e);
+    *e = fresh;
+    g_expr_compiles++;
+    return e;
+}
+
+/**
+ * Evaluate the expression expr[0..len)
+ * Returns 0 and stores the value in *result, -1 after printing an error
+ */
+int arith_eval(const char *expr, size_t len, int64_t *result) {
+    Expr *e;
+
+    if (needs_expansion(expr, len)) {
+        char *copy = arena_copy(expr, len);
+        char *expanded = copy ? expand_word(copy) : NULL;
+
+        if (!expanded) {
+            print_error("Memory allocation failed");
+            return -1;
+        }
+        expr = expanded;
+        len = strlen(expanded);
+    }
+
+    if (!(e = get_expr(expr, len))) {
+        return -1;
+    }
+    return run(e, expr, len, result);
+}
+
+/**
+ * Print compiled expression cache statistics
+ */
+void arith_print_stats(void) {
+    out_printf("expressions: %lu compiled, %lu cache hits\n", g_expr_compiles, g_expr_hits);
+}
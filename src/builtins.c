@@ -1,13 +1,23 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
 #include "../include/shell.h"
+#include <fcntl.h>
+
+/* Names of all built-in commands */
+static const char *builtins[] = {
+    "cd", "exit", "help", "history", "pwd", "echo", "export", "clear",
+    "cache", "stats", "pmap", "xargs", "tee", "timeout", "ulimit",
+    "taskset", "nice", "jobsched", "jobs", "fg", "bg", "unset",
+    "read", "mapfile", "readarray", ":", "alias", "unalias", "return", "exec", "coproc",
+    "on-change", "watch", NULL
+};
 
 /**
  * Check if command is a built-in
  */
 int is_builtin(char *command) {
-    const char *builtins[] = {
-        "cd", "exit", "help", "history", "pwd", "echo", "export", "clear", NULL
-    };
-
     for (int i = 0; builtins[i] != NULL; i++) {
         if (strcmp(command, builtins[i]) == 0) {
             return 1;
@@ -17,9 +27,16 @@ int is_builtin(char *command) {
 }
 
 /**
- * Execute built-in command
+ * Get the NULL-terminated list of built-in command names
  */
-int execute_builtin(Command *cmd) {
+const char** get_builtin_names(void) {
+    return builtins;
+}
+
+/**
+ * Dispatch a built-in command by name
+ */
+static int run_builtin(Command *cmd) {
     if (strcmp(cmd->tokens[0], "cd") == 0) {
         return builtin_cd(cmd->tokens);
     } else if (strcmp(cmd->tokens[0], "exit") == 0) {
@@ -36,11 +53,118 @@ int execute_builtin(Command *cmd) {
         return builtin_export(cmd->tokens);
     } else if (strcmp(cmd->tokens[0], "clear") == 0) {
         return builtin_clear(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "cache") == 0) {
+        return builtin_cache(cmd);
+    } else if (strcmp(cmd->tokens[0], "stats") == 0) {
+        return builtin_stats(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "pmap") == 0) {
+        return builtin_pmap(cmd);
+    } else if (strcmp(cmd->tokens[0], "xargs") == 0) {
+        return builtin_xargs(cmd);
+    } else if (strcmp(cmd->tokens[0], "tee") == 0) {
+        return builtin_tee(cmd);
+    } else if (strcmp(cmd->tokens[0], "timeout") == 0) {
+        return builtin_timeout(cmd);
+    } else if (strcmp(cmd->tokens[0], "ulimit") == 0) {
+        return builtin_ulimit(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "taskset") == 0) {
+        return builtin_taskset(cmd);
+    } else if (strcmp(cmd->tokens[0], "nice") == 0) {
+        return builtin_nice(cmd);
+    } else if (strcmp(cmd->tokens[0], "jobsched") == 0) {
+        return builtin_jobsched(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "jobs") == 0) {
+        return builtin_jobs(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "fg") == 0) {
+        return builtin_fg(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "bg") == 0) {
+        return builtin_bg(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "coproc") == 0) {
+        return builtin_coproc(cmd);
+    } else if (strcmp(cmd->tokens[0], "on-change") == 0) {
+        return builtin_on_change(cmd);
+    } else if (strcmp(cmd->tokens[0], "watch") == 0) {
+        return builtin_watch(cmd);
+    } else if (strcmp(cmd->tokens[0], "unset") == 0) {
+        return builtin_unset(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "read") == 0) {
+        return builtin_read(cmd);
+    } else if (strcmp(cmd->tokens[0], "mapfile") == 0 ||
+               strcmp(cmd->tokens[0], "readarray") == 0) {
+        return builtin_mapfile(cmd);
+    } else if (strcmp(cmd->tokens[0], ":") == 0) {
+        return 0;
+    } else if (strcmp(cmd->tokens[0], "alias") == 0) {
+        return builtin_alias(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "unalias") == 0) {
+        return builtin_unalias(cmd->tokens);
+    } else if (strcmp(cmd->tokens[0], "return") == 0) {
+        return builtin_return(cmd->tokens);
     }
 
     return -1;
 }
 
+/**
+ * Execute built-in command, sending its output to its redirection targets
+ */
+int execute_builtin(Command *cmd) {
+    int fds[MAX_TEE_FILES + 1];
+    int count = 0;
+    FILE *spool = NULL;
+    int prev_fd = -1;
+    RedirectSave save;
+    int status;
+
+    /* exec's redirections are for the shell itself */
+    if (strcmp(cmd->tokens[0], "exec") == 0) {
+        return builtin_exec(cmd);
+    }
+
+    if (cmd->output_file) {
+        count = open_output_targets(cmd, fds);
+        if (count < 0) {
+            return -1;
+        }
+
+        /* Several targets: spool the output, then fan it out */
+        if (count > 1) {
+            spool = tmpfile();
+            if (!spool) {
+                print_error("Failed to create temporary file");
+                while (count > 0) close(fds[--count]);
+                return -1;
+            }
+            #ifndef _WIN32
+            fcntl(fileno(spool), F_SETFD, FD_CLOEXEC);
+            #endif
+            prev_fd = out_set_fd(fileno(spool));
+        } else {
+            prev_fd = out_set_fd(fds[0]);
+        }
+    }
+
+    if (redirect_push(cmd, &save, 1) == 0) {
+        status = run_builtin(cmd);
+        redirect_pop(&save);
+    } else {
+        status = 1;
+    }
+
+    if (count > 0) {
+        out_set_fd(prev_fd);
+        if (spool) {
+            lseek(fileno(spool), 0, SEEK_SET);
+            fanout(fileno(spool), fds, count);
+            fclose(spool);
+        }
+        for (int i = 0; i < count; i++) {
+            close(fds[i]);
+        }
+    }
+    return status;
+}
+
 /**
  * Change directory
  */
@@ -63,6 +187,8 @@ int builtin_cd(char **args) {
         return -1;
     }
 
+    update_cwd_cache();
+
     return 0;
 }
 
@@ -83,30 +209,67 @@ int builtin_exit(char **args) {
  * Print help information
  */
 int builtin_help(char **args) {
-    printf("%s", COLOR_CYAN);
-    printf("\n==========================================================\n");
-    printf("              Mini Shell - Built-in Commands              \n");
-    printf("==========================================================\n");
-    printf(" cd [dir]        - Change directory                       \n");
-    printf(" pwd             - Print working directory                \n");
-    printf(" echo [args]     - Print arguments                        \n");
-    printf(" export VAR=val  - Set environment variable               \n");
-    printf(" history         - Show command history                   \n");
-    printf(" clear           - Clear the screen                       \n");
-    printf(" help            - Show this help message                 \n");
-    printf(" exit [code]     - Exit the shell                         \n");
-    printf("----------------------------------------------------------\n");
-    printf("                    Features Supported                    \n");
-    printf("----------------------------------------------------------\n");
-    printf(" Redirection:                                             \n");
-    printf("   command > file    - Redirect output to file            \n");
-    printf("   command >> file   - Append output to file              \n");
-    printf("   command < file    - Redirect input from file           \n");
-    printf("                                                           \n");
-    printf(" Background:                                              \n");
-    printf("   command &         - Run command in background          \n");
-    printf("==========================================================\n");
-    printf("%s\n", COLOR_RESET);
+    (void)args;
+    out_puts(COLOR_CYAN);
+    out_puts("\n==========================================================\n");
+    out_puts("              Mini Shell - Built-in Commands              \n");
+    out_puts("==========================================================\n");
+    out_puts(" cd [dir]        - Change directory                       \n");
+    out_puts(" pwd             - Print working directory                \n");
+    out_puts(" echo [args]     - Print arguments                        \n");
+    out_puts(" export VAR=val  - Set environment variable               \n");
+    out_puts(" unset [-f] VAR  - Remove a variable (-f: a function)     \n");
+    out_puts(" read [-r] [-u FD] VARS - Read a line into variables      \n");
+    out_puts(" mapfile [-t] A  - Read lines into array A                \n");
+    out_puts(" alias N=cmd     - Define N as a shorthand for cmd        \n");
+    out_puts(" unalias [-a] N  - Remove aliases                         \n");
+    out_puts(" return [n]      - Return from a function                 \n");
+    out_puts(" exec 3>> file   - Keep descriptors open for the shell    \n");
+    out_puts(" history         - Show command history                   \n");
+    out_puts(" clear           - Clear the screen                       \n");
+    out_puts(" cache -- cmd    - Memoize command output                 \n");
+    out_puts(" stats           - Show shell statistics                  \n");
+    out_puts(" pmap -j N cmd   - Parallel map over chunks of < file     \n");
+    out_puts(" xargs -P J cmd  - Run cmd on the words of its input      \n");
+    out_puts(" on-change P cmd - Run cmd whenever file or dir P changes \n");
+    out_puts(" watch -n S cmd  - Run cmd every S seconds, show changes  \n");
+    out_puts(" tee [-a] files  - Copy input to output and files         \n");
+    out_puts(" timeout DUR cmd - Run command with a time limit          \n");
+    out_puts(" ulimit [-a]     - Limit resources of commands            \n");
+    out_puts(" taskset -c L    - Pin commands to the CPUs in list L     \n");
+    out_puts(" nice [-n N] cmd - Run command at lower priority          \n");
+    out_puts(" jobsched spread - Spread background jobs over CPUs       \n");
+    out_puts(" jobs            - List background and stopped jobs       \n");
+    out_puts(" fg [%n]         - Continue a job in the foreground       \n");
+    out_puts(" bg [%n]         - Continue a stopped job in background   \n");
+    out_puts(" coproc NAME cmd - Start cmd with pipes NAME[0], NAME[1]  \n");
+    out_puts(" help            - Show this help message                 \n");
+    out_puts(" exit [code]     - Exit the shell                         \n");
+    out_puts("----------------------------------------------------------\n");
+    out_puts("                    Features Supported                    \n");
+    out_puts("----------------------------------------------------------\n");
+    out_puts(" Redirection:                                             \n");
+    out_puts("   command > file    - Redirect output to file            \n");
+    out_puts("   command >> file   - Append output to file              \n");
+    out_puts("   command > a > b   - Write output to several files      \n");
+    out_puts("   command < file    - Redirect input from file           \n");
+    out_puts("   command 2> file   - Redirect errors (also N>, N<, N<>) \n");
+    out_puts("   command &> file   - Redirect output and errors         \n");
+    out_puts("   command 2>&1      - Copy a descriptor (N>&- closes)    \n");
+    out_puts("                                                           \n");
+    out_puts(" Background:                                              \n");
+    out_puts("   command &         - Run command in background          \n");
+    out_puts("   Ctrl+Z            - Stop the foreground job            \n");
+    out_puts("                                                           \n");
+    out_puts(" Variables and loops:                                     \n");
+    out_puts("   NAME=value        - Set a shell variable               \n");
+    out_puts("   $NAME ${NAME[i]}  - Expand a variable or array element \n");
+    out_puts("   $((expr)) ((expr)) - Integer arithmetic                \n");
+    out_puts("   cmd1; cmd2        - Run commands one after another     \n");
+    out_puts("   while c; do x; done - Repeat x while c succeeds        \n");
+    out_puts("   f() { x; }        - Define function f; $1 $# $@ in x   \n");
+    out_puts("==========================================================\n");
+    out_printf("%s\n", COLOR_RESET);
 
     return 0;
 }
@@ -115,6 +278,7 @@ int builtin_help(char **args) {
  * Show command history
  */
 int builtin_history(char **args) {
+    (void)args;
     print_history(g_history);
     return 0;
 }
@@ -123,15 +287,14 @@ int builtin_history(char **args) {
  * Print working directory
  */
 int builtin_pwd(char **args) {
-    char cwd[MAX_PATH_SIZE];
-
-    if (getcwd(cwd, sizeof(cwd)) != NULL) {
-        printf("%s\n", cwd);
-        return 0;
-    } else {
+    (void)args;
+    if (g_cwd == NULL) {
         print_error("Failed to get current directory");
         return -1;
     }
+
+    out_printf("%s\n", g_cwd);
+    return 0;
 }
 
 /**
@@ -139,12 +302,12 @@ int builtin_pwd(char **args) {
  */
 int builtin_echo(char **args) {
     for (int i = 1; args[i] != NULL; i++) {
-        printf("%s", args[i]);
+        out_puts(args[i]);
         if (args[i + 1] != NULL) {
-            printf(" ");
+            out_write(" ", 1);
         }
     }
-    printf("\n");
+    out_write("\n", 1);
     return 0;
 }
 
@@ -181,6 +344,19 @@ int builtin_export(char **args) {
     }
     #endif
 
+    /* The environment is the variable's only copy from now on */
+    var_forget(var_name);
+
+    /* Keep the completion index in sync with the new search path */
+    if (strcmp(var_name, "PATH") == 0) {
+        completion_path_changed();
+    }
+
+    /* The prompt shows the cwd relative to HOME */
+    if (strcmp(var_name, "HOME") == 0) {
+        update_cwd_cache();
+    }
+
     return 0;
 }
 
@@ -188,6 +364,19 @@ int builtin_export(char **args) {
  * Clear screen
  */
 int builtin_clear(char **args) {
-    printf("\033[H\033[J");
+    (void)args;
+    out_puts("\033[H\033[J");
+    return 0;
+}
+
+/**
+ * Show shell statistics
+ */
+int builtin_stats(char **args) {
+    (void)args;
+    cache_print_stats();
+    expand_print_stats();
+    arith_print_stats();
+    xargs_print_stats();
     return 0;
 }
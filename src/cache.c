@@ -0,0 +1,336 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/*
+ * Memoizing cache builtin
+ *
+ *   cache [--ttl S] [--dep FILE...] [--env VAR] -- command [args]
+ *
+ * Entries live in $XDG_CACHE_HOME/mini-shell (or ~/.cache/mini-shell), one
+ * file per key, named by the hash of the key. The key covers argv, the
+ * working directory, a few locale/search-path variables plus any --env
+ * names, and the size/mtime of every --dep file and of the input file.
+ *
+ * Entry layout: CacheHeader, the key bytes (checked on lookup, so a hash
+ * collision is only a miss), then the command's stdout verbatim.
+ */
+
+#define CACHE_MAGIC "MSHCACH1"
+#define CACHE_MAX_ENV 16
+
+typedef struct {
+    char magic[8];
+    int32_t status;
+    uint32_t key_len;
+} CacheHeader;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} CacheKey;
+
+/* Variables that change what most commands print */
+static const char *cache_env_default[] = {
+    "PATH", "LANG", "LC_ALL", "LC_COLLATE", "TZ", NULL
+};
+
+static unsigned long g_cache_hits = 0;
+static unsigned long g_cache_misses = 0;
+static unsigned long long g_cache_bytes_replayed = 0;
+
+static int key_add(CacheKey *key, const char *s, size_t n) {
+    if (key->len + n + 1 > key->cap) {
+        size_t cap = key->cap ? key->cap : 256;
+        while (key->len + n + 1 > cap) cap *= 2;
+        char *grown = (char*)realloc(key->data, cap);
+        if (!grown) return -1;
+        key->data = grown;
+        key->cap = cap;
+    }
+    memcpy(key->data + key->len, s, n);
+    key->data[key->len + n] = '\0';
+    key->len += n + 1;
+    return 0;
+}
+
+static int key_add_str(CacheKey *key, const char *s) {
+    return key_add(key, s, strlen(s));
+}
+
+/**
+ * Add a file's identity (path, size, mtime) to the key
+ */
+static int key_add_file(CacheKey *key, const char *path) {
+    struct stat st;
+    char stamp[64];
+
+    if (stat(path, &st) != 0) {
+        snprintf(stamp, sizeof(stamp), "missing");
+    } else {
+        snprintf(stamp, sizeof(stamp), "%lld:%lld.%09ld",
+                 (long long)st.st_size, (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    }
+    return key_add_str(key, path) | key_add_str(key, stamp);
+}
+
+static int key_add_env(CacheKey *key, const char *name) {
+    const char *value = getenv(name);
+
+    if (key_add_str(key, name) != 0) return -1;
+    return value ? key_add_str(key, value) : key_add(key, "\x01", 1);
+}
+
+/**
+ * FNV-1a, used only to name the entry file
+ */
+static uint64_t key_hash(const CacheKey *key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < key->len; i++) {
+        h ^= (unsigned char)key->data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Find (and create) the store directory, also used for the rc snapshot
+ */
+int cache_dir(char *buf, size_t size) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (base && *base) {
+        snprintf(buf, size, "%s", base);
+    } else if (home && *home) {
+        snprintf(buf, size, "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    mkdir(buf, 0700);
+
+    size_t len = strlen(buf);
+    snprintf(buf + len, size - len, "/mini-shell");
+    if (mkdir(buf, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Replay a stored entry; returns 0 and the stored status on a valid hit
+ */
+static int cache_replay(const char *path, const CacheKey *key, long ttl, int *status) {
+    CacheHeader header;
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    int rc = -1;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 ||
+        (ttl >= 0 && time(NULL) - st.st_mtime > ttl) ||
+        pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.key_len != key->len) {
+        close(fd);
+        return -1;
+    }
+
+    char *stored = (char*)malloc(key->len ? key->len : 1);
+    if (stored && pread(fd, stored, key->len, sizeof(header)) == (ssize_t)key->len &&
+        memcmp(stored, key->data, key->len) == 0) {
+        off_t data = (off_t)(sizeof(header) + key->len);
+        size_t len = (size_t)(st.st_size - data);
+
+        if (out_sendfile(fd, data, len) == 0) {
+            g_cache_bytes_replayed += len;
+            *status = header.status;
+            rc = 0;
+        }
+    }
+
+    free(stored);
+    close(fd);
+    return rc;
+}
+
+/**
+ * Run the command with stdout streamed both to the caller and into a new
+ * entry, then publish the entry
+ */
+static int cache_store(Command *cmd, int first, const char *path, const CacheKey *key) {
+    char tmp[PATH_MAX + 32];
+    CacheHeader header;
+    Command inner;
+    int via_zygote;
+    int p[2];
+    int status;
+    int fd;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tmp)) {
+        print_error("cache: cache path too long");
+        return -1;
+    }
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        print_error("cache: failed to create cache entry");
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.key_len = (uint32_t)key->len;
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        write(fd, key->data, key->len) != (ssize_t)key->len) {
+        close(fd);
+        unlink(tmp);
+        print_error("cache: failed to write cache entry");
+        return -1;
+    }
+
+    if (pipe2(p, O_CLOEXEC) != 0) {
+        close(fd);
+        unlink(tmp);
+        print_error("Failed to create pipe");
+        return -1;
+    }
+
+    /* The command keeps its own redirections; its stdout is the pipe */
+    init_subcommand(&inner, cmd, first);
+    inner.background = 0;
+
+    pid_t pid = spawn_command(&inner, p[1], &via_zygote, 0);
+    close(p[1]);
+    if (pid < 0) {
+        close(p[0]);
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    /* A miss shows the output as it comes and appends it after the key */
+    int targets[2] = { out_get_fd(), fd };
+    int copied = fanout(p[0], targets, 2);
+    close(p[0]);
+    status = wait_command(&inner, pid, via_zygote);
+
+    /* Interrupted, failed to start or not fully stored: nothing worth keeping */
+    if (copied != 0 || status < 0 || status >= 128) {
+        close(fd);
+        unlink(tmp);
+        return status;
+    }
+
+    header.status = status;
+    if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+    close(fd);
+    return status;
+}
+
+/**
+ * cache [--ttl S] [--dep FILE...] [--env VAR] -- command [args]
+ */
+int builtin_cache(Command *cmd) {
+    char **args = cmd->tokens;
+    const char *extra_env[CACHE_MAX_ENV];
+    int extra_env_count = 0;
+    int dep_start = 0, dep_end = 0;
+    long ttl = -1;
+    int i = 1;
+
+    while (args[i] && strcmp(args[i], "--") != 0) {
+        if (strcmp(args[i], "--ttl") == 0 && args[i + 1]) {
+            char *end;
+            ttl = strtol(args[i + 1], &end, 10);
+            if (*end != '\0' || ttl < 0) break;
+            i += 2;
+        } else if (strcmp(args[i], "--dep") == 0) {
+            dep_start = ++i;
+            while (args[i] && strncmp(args[i], "--", 2) != 0) i++;
+            dep_end = i;
+        } else if (strcmp(args[i], "--env") == 0 && args[i + 1] &&
+                   extra_env_count < CACHE_MAX_ENV) {
+            extra_env[extra_env_count++] = args[i + 1];
+            i += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (!args[i] || strcmp(args[i], "--") != 0 || !args[i + 1]) {
+        print_error("Usage: cache [--ttl S] [--dep file...] [--env VAR] -- command [args]");
+        return -1;
+    }
+    char **argv = args + i + 1;
+
+    /* Build the key */
+    CacheKey key = {NULL, 0, 0};
+    int failed = key_add_str(&key, "argv");
+    for (char **a = argv; *a; a++) failed |= key_add_str(&key, *a);
+    failed |= key_add_str(&key, "cwd");
+    failed |= key_add_str(&key, g_cwd ? g_cwd : "");
+    failed |= key_add_str(&key, "env");
+    for (int e = 0; cache_env_default[e]; e++) failed |= key_add_env(&key, cache_env_default[e]);
+    for (int e = 0; e < extra_env_count; e++) failed |= key_add_env(&key, extra_env[e]);
+    failed |= key_add_str(&key, "deps");
+    for (int d = dep_start; d < dep_end; d++) failed |= key_add_file(&key, args[d]);
+    if (cmd->input_file) failed |= key_add_file(&key, cmd->input_file);
+
+    char dir[PATH_MAX];
+    if (failed || cache_dir(dir, sizeof(dir)) != 0) {
+        free(key.data);
+        print_error("cache: no usable cache directory");
+        return -1;
+    }
+
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%016llx", dir, (unsigned long long)key_hash(&key));
+
+    int status;
+    if (cache_replay(path, &key, ttl, &status) == 0) {
+        g_cache_hits++;
+    } else {
+        g_cache_misses++;
+        status = cache_store(cmd, (int)(argv - args), path, &key);
+    }
+
+    free(key.data);
+    return status;
+}
+
+/**
+ * Report cache counters (stats builtin)
+ */
+void cache_print_stats(void) {
+    out_printf("cache: %lu hits, %lu misses, %llu bytes replayed\n",
+               g_cache_hits, g_cache_misses, g_cache_bytes_replayed);
+}
+
+#else
+
+int builtin_cache(Command *cmd) {
+    print_error("cache is not supported on Windows");
+    return -1;
+}
+
+void cache_print_stats(void) {
+    out_puts("cache: not supported on Windows\n");
+}
+
+#endif
@@ -0,0 +1,567 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DIRENT_BUF_SIZE 32768
+
+/* Entry layout returned by the getdents64 system call */
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Sorted index of command names (PATH executables plus builtins) */
+typedef struct {
+    char **names;
+    int count;
+    int capacity;
+} CommandIndex;
+
+/* A watched PATH directory */
+typedef struct {
+    char *path;
+    int wd;
+} PathDir;
+
+static CommandIndex g_index;
+static PathDir *g_path_dirs = NULL;
+static int g_path_dir_count = 0;
+static int g_inotify_fd = -1;
+static int g_index_ready = 0;
+
+/**
+ * Find the first index entry not less than name
+ */
+static int index_lower_bound(const char *name) {
+    int lo = 0;
+    int hi = g_index.count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(g_index.names[mid], name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Append a name without keeping order (used while bulk loading)
+ */
+static int index_append(const char *name) {
+    if (g_index.count >= g_index.capacity) {
+        int capacity = g_index.capacity ? g_index.capacity * 2 : 1024;
+        char **names = (char**)realloc(g_index.names, sizeof(char*) * capacity);
+        if (!names) {
+            return -1;
+        }
+        g_index.names = names;
+        g_index.capacity = capacity;
+    }
+
+    g_index.names[g_index.count] = strdup(name);
+    if (!g_index.names[g_index.count]) {
+        return -1;
+    }
+    g_index.count++;
+    return 0;
+}
+
+/**
+ * Insert a name keeping the index sorted and unique
+ */
+static void index_insert(const char *name) {
+    int at = index_lower_bound(name);
+
+    if (at < g_index.count && strcmp(g_index.names[at], name) == 0) {
+        return;
+    }
+    if (index_append(name) != 0) {
+        return;
+    }
+
+    char *added = g_index.names[g_index.count - 1];
+    memmove(&g_index.names[at + 1], &g_index.names[at],
+            sizeof(char*) * (g_index.count - 1 - at));
+    g_index.names[at] = added;
+}
+
+static void index_remove(const char *name) {
+    int at = index_lower_bound(name);
+
+    if (at < g_index.count && strcmp(g_index.names[at], name) == 0) {
+        free(g_index.names[at]);
+        memmove(&g_index.names[at], &g_index.names[at + 1],
+                sizeof(char*) * (g_index.count - at - 1));
+        g_index.count--;
+    }
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Check whether a directory entry is an executable file
+ */
+static int is_executable_entry(int dirfd, const char *name, unsigned char type) {
+    if (type == DT_DIR) {
+        return 0;
+    }
+    if (faccessat(dirfd, name, X_OK, 0) != 0) {
+        return 0;
+    }
+    if (type == DT_REG) {
+        return 1;
+    }
+
+    /* Symlinks and unknown types: make sure it is not a directory */
+    struct stat st;
+    return fstatat(dirfd, name, &st, 0) == 0 && !S_ISDIR(st.st_mode);
+}
+
+/**
+ * Read a directory with getdents64, calling fn for every entry
+ */
+static int scan_directory(int dirfd, void (*fn)(int, const char*, unsigned char, void*),
+                          void *ctx) {
+    char *buf = (char*)malloc(DIRENT_BUF_SIZE);
+    long n;
+
+    if (!buf) {
+        return -1;
+    }
+
+    while ((n = syscall(SYS_getdents64, dirfd, buf, DIRENT_BUF_SIZE)) > 0) {
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *d = (struct linux_dirent64*)(buf + off);
+            off += d->d_reclen;
+
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) {
+                continue;
+            }
+            fn(dirfd, d->d_name, d->d_type, ctx);
+        }
+    }
+
+    free(buf);
+    return n < 0 ? -1 : 0;
+}
+
+static void add_if_executable(int dirfd, const char *name, unsigned char type, void *ctx) {
+    (void)ctx;
+    if (is_executable_entry(dirfd, name, type)) {
+        index_append(name);
+    }
+}
+
+/**
+ * Check whether any PATH directory still provides a command
+ */
+static int command_in_path(const char *name) {
+    for (int i = 0; i < g_path_dir_count; i++) {
+        int dirfd = open(g_path_dirs[i].path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        int found;
+
+        if (dirfd < 0) {
+            continue;
+        }
+        found = is_executable_entry(dirfd, name, DT_UNKNOWN);
+        close(dirfd);
+        if (found) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_builtin_name(const char *name) {
+    const char **builtins = get_builtin_names();
+    for (int i = 0; builtins[i] != NULL; i++) {
+        if (strcmp(builtins[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void release_index(void) {
+    for (int i = 0; i < g_index.count; i++) {
+        free(g_index.names[i]);
+    }
+    g_index.count = 0;
+
+    for (int i = 0; i < g_path_dir_count; i++) {
+        free(g_path_dirs[i].path);
+    }
+    free(g_path_dirs);
+    g_path_dirs = NULL;
+    g_path_dir_count = 0;
+
+    if (g_inotify_fd >= 0) {
+        close(g_inotify_fd);
+        g_inotify_fd = -1;
+    }
+    g_index_ready = 0;
+}
+
+/**
+ * Rebuild the command index from $PATH and watch every directory
+ */
+static void build_index(void) {
+    const char **builtins = get_builtin_names();
+    char *path_env = getenv("PATH");
+    char *path_copy;
+    char *saveptr;
+    char *dir;
+    int dir_capacity = 0;
+
+    release_index();
+
+    g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    for (int i = 0; builtins[i] != NULL; i++) {
+        index_append(builtins[i]);
+    }
+
+    path_copy = strdup(path_env ? path_env : "");
+    if (!path_copy) {
+        return;
+    }
+
+    for (dir = strtok_r(path_copy, ":", &saveptr); dir != NULL;
+         dir = strtok_r(NULL, ":", &saveptr)) {
+        int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0) {
+            continue;
+        }
+
+        if (g_path_dir_count >= dir_capacity) {
+            dir_capacity = dir_capacity ? dir_capacity * 2 : 16;
+            PathDir *dirs = (PathDir*)realloc(g_path_dirs, sizeof(PathDir) * dir_capacity);
+            if (!dirs) {
+                close(dirfd);
+                break;
+            }
+            g_path_dirs = dirs;
+        }
+
+        PathDir *pd = &g_path_dirs[g_path_dir_count++];
+        pd->path = strdup(dir);
+        pd->wd = -1;
+        if (g_inotify_fd >= 0) {
+            pd->wd = inotify_add_watch(g_inotify_fd, dir,
+                                       IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF |
+                                       IN_MOVE_SELF | IN_ONLYDIR);
+        }
+
+        scan_directory(dirfd, add_if_executable, NULL);
+        close(dirfd);
+    }
+    free(path_copy);
+
+    /* Sort and drop duplicate names from different directories */
+    if (g_index.count > 0) {
+        qsort(g_index.names, g_index.count, sizeof(char*), compare_names);
+        int unique = 1;
+        for (int i = 1; i < g_index.count; i++) {
+            if (strcmp(g_index.names[i], g_index.names[unique - 1]) == 0) {
+                free(g_index.names[i]);
+            } else {
+                g_index.names[unique++] = g_index.names[i];
+            }
+        }
+        g_index.count = unique;
+    }
+
+    g_index_ready = 1;
+}
+
+static PathDir* find_watched_dir(int wd) {
+    for (int i = 0; i < g_path_dir_count; i++) {
+        if (g_path_dirs[i].wd == wd) {
+            return &g_path_dirs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Apply pending inotify events to the index
+ */
+static void drain_index_events(void) {
+    char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    int rebuild = 0;
+
+    if (g_inotify_fd < 0) {
+        return;
+    }
+
+    while ((n = read(g_inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event*)p;
+            PathDir *pd = find_watched_dir(ev->wd);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                rebuild = 1;
+                continue;
+            }
+            if (!pd || ev->len == 0 || (ev->mask & IN_ISDIR)) {
+                continue;
+            }
+
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO | IN_ATTRIB)) {
+                int dirfd = open(pd->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (dirfd >= 0) {
+                    if (is_executable_entry(dirfd, ev->name, DT_UNKNOWN)) {
+                        index_insert(ev->name);
+                    } else if (!is_builtin_name(ev->name) && !command_in_path(ev->name)) {
+                        index_remove(ev->name);
+                    }
+                    close(dirfd);
+                }
+            } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                if (!is_builtin_name(ev->name) && !command_in_path(ev->name)) {
+                    index_remove(ev->name);
+                }
+            }
+        }
+    }
+
+    if (rebuild) {
+        build_index();
+    }
+}
+
+/**
+ * Build the command index (called once at interactive startup)
+ */
+void completion_init(void) {
+    build_index();
+}
+
+/**
+ * Rebuild the index after $PATH changed
+ */
+void completion_path_changed(void) {
+    if (g_index_ready) {
+        build_index();
+    }
+}
+
+void completion_cleanup(void) {
+    release_index();
+    free(g_index.names);
+    g_index.names = NULL;
+    g_index.capacity = 0;
+}
+
+static int add_completion(CompletionList *list, const char *text, size_t len,
+                          const char *suffix) {
+    if (list->count >= list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 32;
+        char **items = (char**)realloc(list->items, sizeof(char*) * capacity);
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    size_t slen = strlen(suffix);
+    char *item = (char*)malloc(len + slen + 1);
+    if (!item) {
+        return -1;
+    }
+    memcpy(item, text, len);
+    memcpy(item + len, suffix, slen + 1);
+    list->items[list->count++] = item;
+    return 0;
+}
+
+/* State for collecting file name matches during a directory scan */
+typedef struct {
+    CompletionList *list;
+    const char *dir_prefix;     /* directory part as typed by the user */
+    size_t dir_prefix_len;
+    const char *base;           /* partial file name to match */
+    size_t base_len;
+} FileMatch;
+
+static void add_file_match(int dirfd, const char *name, unsigned char type, void *ctx) {
+    FileMatch *fm = (FileMatch*)ctx;
+    char text[MAX_PATH_SIZE * 2];
+    int is_dir = (type == DT_DIR);
+
+    if (strncmp(name, fm->base, fm->base_len) != 0) {
+        return;
+    }
+    /* Hidden files only when explicitly asked for */
+    if (name[0] == '.' && fm->base[0] != '.') {
+        return;
+    }
+
+    if (type == DT_LNK || type == DT_UNKNOWN) {
+        struct stat st;
+        is_dir = fstatat(dirfd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    int n = snprintf(text, sizeof(text), "%.*s%s",
+                     (int)fm->dir_prefix_len, fm->dir_prefix, name);
+    if (n > 0 && (size_t)n < sizeof(text)) {
+        add_completion(fm->list, text, (size_t)n, is_dir ? "/" : "");
+    }
+}
+
+/**
+ * Complete a file name relative to the directory being typed
+ */
+static void complete_filename(const char *word, size_t len, CompletionList *list) {
+    char dir_path[MAX_PATH_SIZE * 2];
+    const char *slash = NULL;
+    FileMatch fm;
+
+    for (size_t i = 0; i < len; i++) {
+        if (word[i] == '/') slash = word + i;
+    }
+
+    fm.list = list;
+    fm.dir_prefix = word;
+    fm.dir_prefix_len = slash ? (size_t)(slash - word + 1) : 0;
+    fm.base = word + fm.dir_prefix_len;
+    fm.base_len = len - fm.dir_prefix_len;
+
+    if (!slash) {
+        strcpy(dir_path, ".");
+    } else if (word[0] == '~' && (word + 1 == slash)) {
+        const char *home = getenv("HOME");
+        snprintf(dir_path, sizeof(dir_path), "%s/", home ? home : "");
+    } else if (word[0] == '~' && word[1] == '/') {
+        const char *home = getenv("HOME");
+        snprintf(dir_path, sizeof(dir_path), "%s%.*s", home ? home : "",
+                 (int)(fm.dir_prefix_len - 1), word + 1);
+    } else {
+        snprintf(dir_path, sizeof(dir_path), "%.*s", (int)fm.dir_prefix_len, word);
+    }
+
+    int dirfd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        return;
+    }
+
+    /* The base name is NUL-terminated separately for prefix matching */
+    char base[MAX_PATH_SIZE];
+    snprintf(base, sizeof(base), "%.*s", (int)fm.base_len, fm.base);
+    fm.base = base;
+    fm.base_len = strlen(base);
+
+    scan_directory(dirfd, add_file_match, &fm);
+    close(dirfd);
+
+    qsort(list->items, list->count, sizeof(char*), compare_names);
+}
+
+/**
+ * Complete a command name from the index
+ */
+static void complete_command(const char *word, size_t len, CompletionList *list) {
+    char prefix[MAX_PATH_SIZE];
+
+    if (!g_index_ready) {
+        build_index();
+    }
+    drain_index_events();
+
+    snprintf(prefix, sizeof(prefix), "%.*s", (int)len, word);
+    for (int i = index_lower_bound(prefix); i < g_index.count; i++) {
+        if (strncmp(g_index.names[i], prefix, len) != 0) {
+            break;
+        }
+        add_completion(list, g_index.names[i], strlen(g_index.names[i]), " ");
+    }
+}
+
+/**
+ * Collect completions for the word ending at pos
+ * Commands are completed in command position, file names elsewhere
+ */
+int complete_word(const char *line, size_t pos, size_t *word_start, CompletionList *list) {
+    size_t start = pos;
+    int command_position = 1;
+
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+
+    while (start > 0 && line[start - 1] != ' ' && line[start - 1] != '\t') {
+        start--;
+    }
+    for (size_t i = 0; i < start; i++) {
+        if (line[i] != ' ' && line[i] != '\t') {
+            command_position = 0;
+            break;
+        }
+    }
+
+    *word_start = start;
+    if (command_position && !memchr(line + start, '/', pos - start)) {
+        complete_command(line + start, pos - start, list);
+    } else {
+        complete_filename(line + start, pos - start, list);
+    }
+    return list->count;
+}
+
+void free_completions(CompletionList *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+#else
+
+/* Windows: the console line reader has no completion hook */
+void completion_init(void) {
+}
+
+void completion_path_changed(void) {
+}
+
+void completion_cleanup(void) {
+}
+
+int complete_word(const char *line, size_t pos, size_t *word_start, CompletionList *list) {
+    *word_start = pos;
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    return 0;
+}
+
+void free_completions(CompletionList *list) {
+    list->count = 0;
+}
+
+#endif
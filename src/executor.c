@@ -1,3 +1,7 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
 #include "../include/shell.h"
 
 #ifdef _WIN32
@@ -182,6 +186,14 @@ int execute_command(Command *cmd) {
     }
 }
 
+/**
+ * Execute a command with redirection support
+ * On Windows, redirection is handled in execute_command
+ */
+int execute_with_redirection(Command *cmd) {
+    return execute_command(cmd);
+}
+
 #else
 
 /* POSIX version */
@@ -191,126 +203,451 @@ int execute_command(Command *cmd) {
  * Execute a command with redirection support
  */
 int execute_with_redirection(Command *cmd) {
-    int input_fd = -1;
-    int output_fd = -1;
+    /* Files, copies and closes, see redirect.c */
+    if (redirect_apply(cmd) != 0) {
+        _exit(EXIT_FAILURE);
+    }
 
-    /* Handle input redirection */
-    if (cmd->input_file) {
-        input_fd = open(cmd->input_file, O_RDONLY);
-        if (input_fd < 0) {
-            print_error("Failed to open input file");
+    /* Execute the command */
+    execvp(cmd->tokens[0], cmd->tokens);
+
+    /* If execvp returns, there was an error */
+    fprintf(stderr, "%smini-shell: %s: command not found%s\n",
+            COLOR_RED, cmd->tokens[0], COLOR_RESET);
+    _exit(EXIT_FAILURE);
+}
+
+/**
+ * Start a command through the spawn zygote
+ * Redirection files are opened here and handed over as descriptors;
+ * out_fd, when set, replaces the output file. The zygote takes only
+ * standard input, output and error, so anything else needs a fork.
+ * Returns the pid, -1 to fall back to fork, or -2 after reporting an error
+ */
+static pid_t spawn_via_zygote(Command *cmd, int out_fd, const SpawnAttr *attr) {
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int opened[MAX_REDIRECTS + 2];
+    int count = 0;
+    pid_t pid;
+
+    /* Descriptors left open by exec are inherited only through fork */
+    if (redirect_user_fds()) {
+        return -1;
+    }
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const Redirect *r = &cmd->redirects[i];
+        if (r->fd > STDERR_FILENO || r->source > STDERR_FILENO || r->type == REDIR_CLOSE) {
             return -1;
         }
-        dup2(input_fd, STDIN_FILENO);
-        close(input_fd);
     }
 
-    /* Handle output redirection */
-    if (cmd->output_file) {
-        int flags = O_WRONLY | O_CREAT;
-        if (cmd->append_output) {
-            flags |= O_APPEND;
-        } else {
-            flags |= O_TRUNC;
+    if (cmd->input_file) {
+        fds[0] = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+        if (fds[0] < 0) {
+            print_error("Failed to open input file");
+            return -2;
         }
+        opened[count++] = fds[0];
+    }
+
+    if (out_fd >= 0) {
+        fds[1] = out_fd;
+    } else if (cmd->output_file) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        flags |= cmd->append_output ? O_APPEND : O_TRUNC;
 
-        output_fd = open(cmd->output_file, flags, 0644);
-        if (output_fd < 0) {
+        fds[1] = open(cmd->output_file, flags, 0644);
+        if (fds[1] < 0) {
             print_error("Failed to open output file");
-            return -1;
+            while (count > 0) close(opened[--count]);
+            return -2;
         }
-        dup2(output_fd, STDOUT_FILENO);
-        close(output_fd);
+        opened[count++] = fds[1];
     }
 
-    /* Execute the command */
-    execvp(cmd->tokens[0], cmd->tokens);
+    /* 2> err, 2>&1 and the like, in order */
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const Redirect *r = &cmd->redirects[i];
 
-    /* If execvp returns, there was an error */
-    print_error("Failed to execute command");
-    exit(EXIT_FAILURE);
+        if (r->type == REDIR_DUP) {
+            fds[r->fd] = fds[r->source];
+            continue;
+        }
+
+        int flags = O_CLOEXEC;
+        flags |= r->type == REDIR_READ ? O_RDONLY :
+                 r->type == REDIR_RDWR ? O_RDWR | O_CREAT :
+                 O_WRONLY | O_CREAT | (r->type == REDIR_APPEND ? O_APPEND : O_TRUNC);
+
+        fds[r->fd] = open(r->file, flags, 0644);
+        if (fds[r->fd] < 0) {
+            print_error(r->type == REDIR_READ ? "Failed to open input file" : "Failed to open output file");
+            while (count > 0) close(opened[--count]);
+            return -2;
+        }
+        opened[count++] = fds[r->fd];
+    }
+
+    pid = zygote_spawn(cmd->tokens, fds, g_cwd, attr);
+
+    while (count > 0) close(opened[--count]);
+
+    return pid < 0 ? -1 : pid;
 }
 
+/* Read end of a pipe the foreground copier holds open until it is done */
+static int g_fanout_done = -1;
+
 /**
- * Execute a single command
+ * Copy a command's output pipe to all of its targets, then close them
+ * The copying runs in a process of its own, so a stopped job cannot hold
+ * up the shell; without detach, wait_command() waits for it to finish
  */
-int execute_command(Command *cmd) {
-    pid_t pid;
-    int status;
+static void fan_out_output(int in_fd, int *fds, int count, int detach) {
+    int done[2] = {-1, -1};
 
-    if (!cmd || cmd->token_count == 0) {
-        return -1;
+    if (!detach && pipe2(done, O_CLOEXEC) != 0) {
+        done[0] = done[1] = -1;
+    }
+
+    /* Double fork: the copier is never a child the shell must reap */
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        if (done[0] >= 0) {
+            close(done[0]);
+        }
+        if (fork() == 0) {
+            fanout(in_fd, fds, count);
+        }
+        _exit(0);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    } else if (!detach) {
+        fanout(in_fd, fds, count);
+    }
+
+    if (done[1] >= 0) {
+        close(done[1]);
+        if (pid > 0) {
+            g_fanout_done = done[0];
+        } else {
+            close(done[0]);
+        }
+    }
+    close(in_fd);
+    for (int i = 0; i < count; i++) {
+        close(fds[i]);
+    }
+}
+
+/**
+ * Start an external command with its redirections and spawn attributes
+ * out_fd, when not -1, becomes the command's stdout instead of its > target.
+ * *via_zygote tells wait_command() how to collect the child. The output
+ * fan-out of several > targets runs in a process of its own, which
+ * wait_command() waits for unless detach_fanout is set.
+ * Returns the pid, or -1 after reporting an error
+ */
+pid_t spawn_command(Command *cmd, int out_fd, int *via_zygote, int detach_fanout) {
+    int fan_fds[MAX_TEE_FILES + 1];
+    int fan_count = 0;
+    int fan_pipe[2] = {-1, -1};
+    SpawnAttr attr;
+    pid_t pid = -1;
+
+    *via_zygote = 0;
+
+    /* Buffered output must not be duplicated into the child */
+    out_flush();
+    fflush(stdout);
+
+    /* Several output targets: the command writes into a pipe we fan out */
+    if (cmd->tee_count > 0 && out_fd < 0) {
+        fan_count = open_output_targets(cmd, fan_fds);
+        if (fan_count < 0) {
+            return -1;
+        }
+        if (pipe2(fan_pipe, O_CLOEXEC) != 0) {
+            print_error("Failed to create pipe");
+            for (int i = 0; i < fan_count; i++) close(fan_fds[i]);
+            return -1;
+        }
+    }
+
+    spawn_attr_current(&attr);
+    spawn_attr_job(&attr, cmd->background);
+    attr.new_pgrp = (uint8_t)jobs_interactive();
+    attr.foreground = (uint8_t)!cmd->background;
+    if (fan_pipe[1] >= 0) {
+        out_fd = fan_pipe[1];
+    }
+
+    /* Let the zygote fork when one is running */
+    if (zygote_active()) {
+        pid = spawn_via_zygote(cmd, out_fd, &attr);
+        *via_zygote = pid > 0;
     }
 
     /* Fork a child process */
-    pid = fork();
+    if (pid == -1) {
+        pid = fork();
+    }
 
     if (pid < 0) {
-        print_error("Failed to fork process");
+        if (pid == -1) {
+            print_error("Failed to fork process");
+        }
+        if (fan_pipe[0] >= 0) {
+            close(fan_pipe[0]);
+            close(fan_pipe[1]);
+            for (int i = 0; i < fan_count; i++) close(fan_fds[i]);
+        }
         return -1;
     }
 
     if (pid == 0) {
         /* Child process */
 
-        /* Reset signal handlers for child */
+        sigset_t none;
+
+        /* Reset signal handlers and mask for child */
         signal(SIGINT, SIG_DFL);
         signal(SIGQUIT, SIG_DFL);
         signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+
+        if (spawn_attr_apply(&attr) != 0) {
+            fprintf(stderr, "mini-shell: %s: failed to apply spawn attributes\n", cmd->tokens[0]);
+        }
+
+        /* Output goes to the given descriptor instead of the file */
+        if (out_fd >= 0) {
+            if (out_fd != STDOUT_FILENO) {
+                dup2(out_fd, STDOUT_FILENO);
+            }
+            cmd->output_file = NULL;
+        }
 
         /* Execute with redirection if needed */
-        if (cmd->input_file || cmd->output_file) {
+        if (cmd->input_file || cmd->output_file || cmd->redirect_count > 0) {
             execute_with_redirection(cmd);
         } else {
             execvp(cmd->tokens[0], cmd->tokens);
 
-            /* If execvp returns, there was an error */
+            /* If execvp returns, there was an error; _exit() leaves the
+               shell's buffered stdin and its file offset alone */
             fprintf(stderr, "%smini-shell: %s: command not found%s\n",
                     COLOR_RED, cmd->tokens[0], COLOR_RESET);
-            exit(EXIT_FAILURE);
+            _exit(EXIT_FAILURE);
         }
-    } else {
-        /* Parent process */
-        if (cmd->background) {
-            /* Background process */
-            printf("[Process %d running in background]\n", pid);
-            return 0;
-        } else {
-            /* Foreground process - wait for child */
-            do {
-                waitpid(pid, &status, WUNTRACED);
-            } while (!WIFEXITED(status) && !WIFSIGNALED(status));
-
-            if (WIFEXITED(status)) {
-                return WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                return 128 + WTERMSIG(status);
+    }
+
+    /* Parent process: a foreground job gets the terminal */
+    if (attr.new_pgrp) {
+        if (!*via_zygote) {
+            setpgid(pid, pid);
+        }
+        if (!cmd->background) {
+            jobs_foreground(pid);
+        }
+    }
+    if (fan_pipe[0] >= 0) {
+        close(fan_pipe[1]);
+        fan_out_output(fan_pipe[0], fan_fds, fan_count, detach_fanout);
+    }
+    return pid;
+}
+
+/**
+ * Wait for a foreground command and return its exit status
+ */
+int wait_command(Command *cmd, pid_t pid, int via_zygote) {
+    int status = job_wait(pid, via_zygote, cmd);
+
+    if (g_fanout_done >= 0) {
+        /* Once the command is gone its output is complete; a stopped one
+           leaves its copier running */
+        if (kill(pid, 0) != 0) {
+            char c;
+            while (read(g_fanout_done, &c, 1) < 0 && errno == EINTR) {
+                continue;
             }
         }
+        close(g_fanout_done);
+        g_fanout_done = -1;
+    }
+    return status;
+}
+
+/**
+ * Enter a command started with & in the job table and announce it
+ */
+static void announce_background(Command *cmd, pid_t pid, int via_zygote) {
+    int id = jobs_add(pid, via_zygote, cmd, 0);
+
+    if (id > 0) {
+        printf("[%d] %d\n", id, pid);
+    } else {
+        printf("[Process %d running in background]\n", pid);
+    }
+}
+
+/**
+ * Set up inner to run the tokens of cmd from index first on
+ * inner shares cmd's strings and input; its output goes to the builtin output
+ */
+void init_subcommand(Command *inner, const Command *cmd, int first) {
+    *inner = *cmd;
+    inner->token_count = 0;
+    for (int i = first; i < cmd->token_count; i++) {
+        inner->tokens[inner->token_count++] = cmd->tokens[i];
+    }
+    inner->tokens[inner->token_count] = NULL;
+    inner->output_file = NULL;
+    inner->tee_count = 0;
+}
+
+/**
+ * Run the tokens of cmd from index first on as an external command,
+ * in the background when cmd has a trailing &
+ */
+int run_subcommand(Command *cmd, int first) {
+    Command inner;
+    int via_zygote;
+    pid_t pid;
+
+    init_subcommand(&inner, cmd, first);
+    if (inner.token_count == 0) {
+        return -1;
+    }
+
+    if (inner.background) {
+        pid = spawn_command(&inner, out_get_fd(), &via_zygote, 1);
+        if (pid < 0) {
+            return -1;
+        }
+        announce_background(cmd, pid, via_zygote);
+        return 0;
+    }
+
+    pid = spawn_command(&inner, out_get_fd(), &via_zygote, 0);
+    return pid < 0 ? -1 : wait_command(cmd, pid, via_zygote);
+}
+
+/**
+ * Execute a single command
+ */
+int execute_command(Command *cmd) {
+    int via_zygote;
+    pid_t pid;
+
+    if (!cmd || cmd->token_count == 0) {
+        return -1;
     }
 
-    return 0;
+    pid = spawn_command(cmd, -1, &via_zygote, cmd->background);
+    if (pid < 0) {
+        return -1;
+    }
+
+    if (cmd->background) {
+        /* Background process */
+        announce_background(cmd, pid, via_zygote);
+        return 0;
+    }
+    return wait_command(cmd, pid, via_zygote);
 }
 
 #endif
 
 /**
- * Execute a command with redirection support (wrapper function for Windows)
+ * Run a parsed command and free it
  */
-int execute_with_redirection(Command *cmd) {
-    /* On Windows, redirection is handled in execute_command */
-    #ifdef _WIN32
-    return execute_command(cmd);
-    #else
-    /* This is implemented above for POSIX */
-    return -1;
-    #endif
+static int execute_parsed(Command *cmd, int *exit_requested) {
+    int status;
+
+    /* Skip if no tokens */
+    if (cmd->token_count == 0) {
+        free_command(cmd);
+        return g_last_exit_status;
+    }
+
+    /* NAME=value words on their own set shell variables */
+    int assignments = 0;
+    while (assignments < cmd->token_count && is_assignment(cmd->tokens[assignments])) {
+        assignments++;
+    }
+
+    if (assignments == cmd->token_count) {
+        status = 0;
+        for (int i = 0; i < cmd->token_count; i++) {
+            if (assign_word(cmd->tokens[i]) != 0) {
+                print_error("Failed to set variable");
+                status = 1;
+            }
+        }
+    } else if (is_function(cmd->tokens[0])) {
+        status = call_function(cmd, exit_requested);
+    } else if (is_builtin(cmd->tokens[0])) {
+        status = execute_builtin(cmd);
+        *exit_requested = strcmp(cmd->tokens[0], "exit") == 0;
+    } else {
+        status = execute_command(cmd);
+    }
+    out_flush();
+
+    free_command(cmd);
+    return status;
+}
+
+/**
+ * Parse and run one simple command
+ * Sets *exit_requested when it was the exit built-in
+ */
+int execute_simple(char *input, int *exit_requested) {
+    Command *cmd;
+    char *line = trim_whitespace(input);
+    size_t len = strlen(line);
+
+    /* (( expression )) succeeds when the expression is not 0 */
+    if (len >= 4 && strncmp(line, "((", 2) == 0 && strcmp(line + len - 2, "))") == 0) {
+        int64_t value;
+        arena_reset();
+        return arith_eval(line + 2, len - 4, &value) == 0 && value != 0 ? 0 : 1;
+    }
+
+    cmd = parse_command(input);
+    if (!cmd) {
+        print_error("Failed to parse command");
+        return -1;
+    }
+    return execute_parsed(cmd, exit_requested);
+}
+
+/**
+ * Execute a command already split into words, e.g. by a loop or function
+ * body; the words are expanded and the caller keeps them
+ */
+int execute_words(char **words, int count, int *exit_requested) {
+    Command *cmd = build_command(words, count);
+
+    if (!cmd) {
+        print_error("Failed to parse command");
+        return -1;
+    }
+    return execute_parsed(cmd, exit_requested);
 }
 
 /**
  * Execute piped commands (for future implementation)
  */
 int execute_piped_commands(Command *cmd) {
+    (void)cmd;
     /* TODO: Implement pipe support */
     print_error("Pipe support not yet implemented");
     return -1;
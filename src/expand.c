@@ -0,0 +1,710 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <ctype.h>
+
+/*
+ * Parameter expansion
+ *
+ *   $NAME ${NAME} ${NAME[i]} ${NAME[@]}   value, array element, all elements;
+ *                                         i is an arithmetic expression
+ *   ${#NAME} ${#NAME[@]}                  length, number of elements
+ *   ${NAME:-word}                         word when NAME is unset or empty
+ *   ${NAME:off} ${NAME:off:len}           substring; negative as (-N)
+ *   ${NAME#pat} ${NAME##pat}              remove shortest/longest prefix
+ *   ${NAME%pat} ${NAME%%pat}              remove shortest/longest suffix
+ *   ${NAME/pat/rep} ${NAME//pat/rep}      replace first/every match;
+ *                                         /#pat and /%pat anchor it
+ *   $((expression))                       arithmetic, see arith.c
+ *   $1 ${10} $# $@ $*                     positional parameters of a function
+ *   $? $$                                 last status, shell pid
+ *
+ * Patterns are globs (*, ?, [...]). Each is compiled once into a small cache
+ * keyed by its text, so a loop running the same expansion compiles it once.
+ * Literal patterns, and those whose only wildcard is a * at the start or
+ * the end (as in ${f%.*} or ${f#*.}), are matched with memcmp() and
+ * memmem() instead of the glob matcher.
+ *
+ * Results are built in the per-line arena; nothing here calls malloc once the
+ * arena and pattern cache are warm.
+ */
+
+#define PATTERN_CACHE_SIZE 64
+
+/* How a compiled pattern is matched */
+enum {
+    PAT_LITERAL,            /* lit */
+    PAT_STAR_LITERAL,       /* *lit */
+    PAT_LITERAL_STAR,       /* lit* */
+    PAT_GLOB                /* anything else */
+};
+
+typedef struct {
+    char *text;             /* the pattern as written; NULL: free slot */
+    size_t text_len;
+    int kind;
+    char *lit;              /* literal part with escapes removed */
+    size_t lit_len;
+} Pattern;
+
+static Pattern g_patterns[PATTERN_CACHE_SIZE];
+static unsigned long g_pattern_hits = 0;
+static unsigned long g_pattern_compiles = 0;
+
+/* A string being built in the arena */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Builder;
+
+static int expand_into(Builder *b, const char *word, size_t n);
+
+static int put(Builder *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 64;
+        while (cap < b->len + n + 1) cap *= 2;
+        char *grown = (char*)arena_alloc(cap);
+        if (!grown) {
+            return -1;
+        }
+        if (b->len) memcpy(grown, b->data, b->len);
+        b->data = grown;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+static int put_str(Builder *b, const char *s) {
+    return s ? put(b, s, strlen(s)) : 0;
+}
+
+#ifdef _WIN32
+static void* memmem(const void *haystack, size_t n, const void *needle, size_t m) {
+    const char *h = (const char*)haystack;
+
+    if (m == 0) return (void*)h;
+    for (size_t i = 0; i + m <= n; i++) {
+        if (h[i] == *(const char*)needle && memcmp(h + i, needle, m) == 0) {
+            return (void*)(h + i);
+        }
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * Offset of the first/last occurrence of lit in s, -1 if none
+ */
+static long find_first(const char *s, size_t n, const char *lit, size_t m) {
+    const char *hit = (const char*)memmem(s, n, lit, m);
+    return hit ? (long)(hit - s) : -1;
+}
+
+static long find_last(const char *s, size_t n, const char *lit, size_t m) {
+    long last = -1;
+    size_t from = 0;
+    const char *hit;
+
+    if (m == 0) {
+        return (long)n;
+    }
+    while (from + m <= n && (hit = (const char*)memmem(s + from, n - from, lit, m))) {
+        last = (long)(hit - s);
+        from = (size_t)last + 1;
+    }
+    return last;
+}
+
+/**
+ * Match one pattern element at p[*pi] against c; advances *pi past it
+ */
+static int match_one(const char *p, size_t pn, size_t *pi, char c) {
+    size_t i = *pi;
+
+    if (p[i] == '?') {
+        *pi = i + 1;
+        return 1;
+    }
+    if (p[i] == '\\' && i + 1 < pn) {
+        *pi = i + 2;
+        return p[i + 1] == c;
+    }
+    if (p[i] == '[') {
+        size_t j = i + 1;
+        int negate = j < pn && (p[j] == '!' || p[j] == '^');
+        int found = 0;
+
+        if (negate) j++;
+        /* A ] right after [ or [! is a member */
+        for (size_t first = j; j < pn && (p[j] != ']' || j == first); j++) {
+            if (j + 2 < pn && p[j + 1] == '-' && p[j + 2] != ']') {
+                if ((unsigned char)c >= (unsigned char)p[j] &&
+                    (unsigned char)c <= (unsigned char)p[j + 2]) found = 1;
+                j += 2;
+            } else if (p[j] == c) {
+                found = 1;
+            }
+        }
+        if (j < pn) {
+            *pi = j + 1;
+            return found != negate;
+        }
+        /* No closing ]: a literal [ */
+    }
+    *pi = i + 1;
+    return p[i] == c;
+}
+
+/**
+ * Check if the whole of s[0..sn) matches the glob p[0..pn)
+ */
+static int glob_match(const char *p, size_t pn, const char *s, size_t sn) {
+    size_t pi = 0;
+    size_t si = 0;
+    size_t star_p = (size_t)-1;
+    size_t star_s = 0;
+
+    while (si < sn) {
+        size_t next = pi;
+
+        if (pi < pn && p[pi] == '*') {
+            star_p = ++pi;
+            star_s = si;
+            continue;
+        }
+        if (pi < pn && match_one(p, pn, &next, s[si])) {
+            pi = next;
+            si++;
+            continue;
+        }
+        /* Let the last * take one more character */
+        if (star_p == (size_t)-1) {
+            return 0;
+        }
+        pi = star_p;
+        si = ++star_s;
+    }
+    while (pi < pn && p[pi] == '*') pi++;
+    return pi == pn;
+}
+
+static unsigned int pattern_hash(const char *text, size_t len) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return h % PATTERN_CACHE_SIZE;
+}
+
+/**
+ * Compiled form of a pattern, from the cache when it was seen before
+ */
+static Pattern* get_pattern(const char *text, size_t len) {
+    Pattern *pat = &g_patterns[pattern_hash(text, len)];
+    int stars = 0;
+    int other = 0;
+    size_t lit_len = 0;
+    char *lit;
+
+    if (pat->text && pat->text_len == len && memcmp(pat->text, text, len) == 0) {
+        g_pattern_hits++;
+        return pat;
+    }
+
+    lit = (char*)malloc(len + 1);
+    char *copy = (char*)malloc(len + 1);
+    if (!lit || !copy) {
+        free(lit);
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\\' && i + 1 < len) {
+            lit[lit_len++] = text[++i];
+        } else if (text[i] == '*') {
+            stars++;
+        } else if (text[i] == '?' || text[i] == '[') {
+            other++;
+        } else {
+            lit[lit_len++] = text[i];
+        }
+    }
+    lit[lit_len] = '\0';
+
+    free(pat->text);
+    free(pat->lit);
+    pat->text = copy;
+    pat->text_len = len;
+    pat->lit = lit;
+    pat->lit_len = lit_len;
+
+    if (other > 0 || stars > 1) {
+        pat->kind = PAT_GLOB;
+    } else if (stars == 0) {
+        pat->kind = PAT_LITERAL;
+    } else if (text[0] == '*') {
+        pat->kind = PAT_STAR_LITERAL;
+    } else if (text[len - 1] == '*' && (len < 2 || text[len - 2] != '\\')) {
+        pat->kind = PAT_LITERAL_STAR;
+    } else {
+        pat->kind = PAT_GLOB;
+    }
+    g_pattern_compiles++;
+    return pat;
+}
+
+static int starts_with(const char *s, size_t n, const Pattern *pat) {
+    return n >= pat->lit_len && memcmp(s, pat->lit, pat->lit_len) == 0;
+}
+
+static int ends_with(const char *s, size_t n, const Pattern *pat) {
+    return n >= pat->lit_len && memcmp(s + n - pat->lit_len, pat->lit, pat->lit_len) == 0;
+}
+
+/**
+ * Length of the shortest or longest prefix of s matching pat, -1 if none
+ */
+static long match_prefix(const Pattern *pat, const char *s, size_t n, int longest) {
+    long pos;
+
+    switch (pat->kind) {
+        case PAT_LITERAL:
+            return starts_with(s, n, pat) ? (long)pat->lit_len : -1;
+        case PAT_LITERAL_STAR:
+            return starts_with(s, n, pat) ? (long)(longest ? n : pat->lit_len) : -1;
+        case PAT_STAR_LITERAL:
+            pos = longest ? find_last(s, n, pat->lit, pat->lit_len)
+                          : find_first(s, n, pat->lit, pat->lit_len);
+            return pos < 0 ? -1 : pos + (long)pat->lit_len;
+    }
+
+    for (size_t i = 0; i <= n; i++) {
+        size_t k = longest ? n - i : i;
+        if (glob_match(pat->text, pat->text_len, s, k)) return (long)k;
+    }
+    return -1;
+}
+
+/**
+ * Length of the shortest or longest suffix of s matching pat, -1 if none
+ */
+static long match_suffix(const Pattern *pat, const char *s, size_t n, int longest) {
+    long pos;
+
+    switch (pat->kind) {
+        case PAT_LITERAL:
+            return ends_with(s, n, pat) ? (long)pat->lit_len : -1;
+        case PAT_STAR_LITERAL:
+            return ends_with(s, n, pat) ? (long)(longest ? n : pat->lit_len) : -1;
+        case PAT_LITERAL_STAR:
+            pos = longest ? find_first(s, n, pat->lit, pat->lit_len)
+                          : find_last(s, n, pat->lit, pat->lit_len);
+            return pos < 0 ? -1 : (long)n - pos;
+    }
+
+    for (size_t i = 0; i <= n; i++) {
+        size_t k = longest ? n - i : i;
+        if (glob_match(pat->text, pat->text_len, s + n - k, k)) return (long)k;
+    }
+    return -1;
+}
+
+/**
+ * Find the longest match of pat starting at or after from
+ * Returns its start and sets *end, -1 if none; empty matches do not count
+ */
+static long find_match(const Pattern *pat, const char *s, size_t n, size_t from, size_t *end) {
+    if (pat->kind == PAT_LITERAL) {
+        long pos;
+        if (pat->lit_len == 0) return -1;
+        pos = find_first(s + from, n - from, pat->lit, pat->lit_len);
+        if (pos < 0) return -1;
+        *end = from + (size_t)pos + pat->lit_len;
+        return (long)from + pos;
+    }
+
+    for (size_t i = from; i < n; i++) {
+        for (size_t e = n; e > i; e--) {
+            if (glob_match(pat->text, pat->text_len, s + i, e - i)) {
+                *end = e;
+                return (long)i;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * Skip to the end of a ${...} starting at s[i] == '$'; returns the index of }
+ */
+static size_t skip_braced(const char *s, size_t n, size_t i) {
+    int depth = 0;
+
+    for (; i < n; i++) {
+        if (s[i] == '\\') {
+            i++;
+        } else if (s[i] == '$' && i + 1 < n && s[i + 1] == '{') {
+            depth++;
+            i++;
+        } else if (s[i] == '}' && --depth == 0) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/**
+ * Index of the ) closing the ( at s[i], n if none
+ */
+static size_t match_paren(const char *s, size_t n, size_t i) {
+    int depth = 0;
+
+    for (; i < n; i++) {
+        if (s[i] == '(') {
+            depth++;
+        } else if (s[i] == ')' && --depth == 0) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/**
+ * Index of the first stop character of s outside nested ${...}, n if none
+ */
+static size_t scan_to(const char *s, size_t n, char stop) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\\') {
+            i++;
+        } else if (s[i] == '$' && i + 1 < n && s[i + 1] == '{') {
+            i = skip_braced(s, n, i);
+        } else if (s[i] == stop) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/**
+ * Expand s[0..n) into a string of its own in the arena
+ */
+static const char* expand_part(const char *s, size_t n, size_t *len) {
+    Builder b = { NULL, 0, 0 };
+
+    if (!memchr(s, '$', n)) {
+        *len = n;
+        return arena_copy(s, n);
+    }
+    if (expand_into(&b, s, n) != 0) {
+        return NULL;
+    }
+    *len = b.len;
+    return b.data ? b.data : arena_copy("", 0);
+}
+
+/**
+ * Parse an offset of ${NAME:off:len}: N or (N), N may be negative
+ */
+static int parse_offset(const char *s, size_t n, long *value) {
+    char buf[32];
+    char *end;
+
+    if (n >= 2 && s[0] == '(' && s[n - 1] == ')') {
+        s++;
+        n -= 2;
+    }
+    if (n == 0 || n >= sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    *value = strtol(buf, &end, 10);
+    return *end == '\0' ? 0 : -1;
+}
+
+/**
+ * Append all elements of an array, separated by spaces
+ */
+static int put_all_items(Builder *b, const char *name, size_t len) {
+    size_t count = var_item_count(name, len);
+
+    for (size_t i = 0; i < count; i++) {
+        if ((i > 0 && put(b, " ", 1) != 0) || put_str(b, var_get_item(name, len, i)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Expand the body of ${...} (without the braces) into b
+ */
+static int expand_braced(Builder *b, const char *body, size_t blen) {
+    const char *value = NULL;
+    size_t name_len = 0;
+    size_t i;
+    char num[32];
+
+    /* ${#NAME} and ${#NAME[@]} */
+    if (blen > 1 && body[0] == '#') {
+        size_t n = blen - 1;
+        size_t count;
+
+        if (n > 3 && memcmp(body + blen - 3, "[@]", 3) == 0) {
+            count = var_item_count(body + 1, n - 3);
+        } else {
+            const char *v = var_lookup(body + 1, n);
+            count = v ? strlen(v) : 0;
+        }
+        snprintf(num, sizeof(num), "%lu", (unsigned long)count);
+        return put_str(b, num);
+    }
+
+    /* The name, or one of the special parameters */
+    if (blen > 0 && (body[0] == '?' || body[0] == '$')) {
+        snprintf(num, sizeof(num), "%d", body[0] == '?' ? g_last_exit_status : (int)getpid());
+        value = num;
+        i = 1;
+    } else if (blen > 0 && (body[0] == '#' || body[0] == '@' || body[0] == '*')) {
+        value = var_lookup(body, 1);
+        i = 1;
+    } else if (blen > 0 && isdigit((unsigned char)body[0])) {
+        while (name_len < blen && isdigit((unsigned char)body[name_len])) name_len++;
+        value = var_lookup(body, name_len);
+        i = name_len;
+    } else {
+        while (name_len < blen && (isalnum((unsigned char)body[name_len]) || body[name_len] == '_')) {
+            name_len++;
+        }
+        if (!valid_var_name(body, name_len)) {
+            return put(b, "", 0);
+        }
+        i = name_len;
+
+        if (i < blen && body[i] == '[') {
+            size_t close = i + scan_to(body + i, blen - i, ']');
+            if (close == blen) {
+                return put(b, "", 0);
+            }
+            if (close == i + 2 && (body[i + 1] == '@' || body[i + 1] == '*')) {
+                if (close + 1 == blen) {
+                    return put_all_items(b, body, name_len);
+                }
+                value = var_lookup(body, name_len);
+            } else {
+                int64_t index;
+                value = arith_eval(body + i + 1, close - i - 1, &index) == 0 && index >= 0 ?
+                        var_get_item(body, name_len, (size_t)index) : NULL;
+            }
+            i = close + 1;
+        } else {
+            value = var_lookup(body, name_len);
+        }
+    }
+
+    const char *s = value ? value : "";
+    size_t n = strlen(s);
+    const char *rest = body + i;
+    size_t rlen = blen - i;
+
+    if (rlen == 0) {
+        return put(b, s, n);
+    }
+
+    /* ${NAME:-word} */
+    if (rlen >= 2 && rest[0] == ':' && rest[1] == '-') {
+        if (n > 0) return put(b, s, n);
+        return expand_into(b, rest + 2, rlen - 2);
+    }
+
+    /* ${NAME:off} and ${NAME:off:len} */
+    if (rest[0] == ':') {
+        size_t colon = 1 + scan_to(rest + 1, rlen - 1, ':');
+        long off;
+        long count = (long)n;
+
+        if (parse_offset(rest + 1, colon - 1, &off) != 0 ||
+            (colon < rlen && parse_offset(rest + colon + 1, rlen - colon - 1, &count) != 0)) {
+            print_error("Bad substitution");
+            return put(b, "", 0);
+        }
+        if (off < 0) off = off + (long)n < 0 ? 0 : off + (long)n;
+        if (off > (long)n) off = (long)n;
+        if (count < 0) count = (long)n + count - off;
+        if (count < 0) count = 0;
+        if (off + count > (long)n) count = (long)n - off;
+        return put(b, s + off, (size_t)count);
+    }
+
+    /* Remove a prefix or suffix */
+    if (rest[0] == '#' || rest[0] == '%') {
+        int longest = rlen > 1 && rest[1] == rest[0];
+        size_t skip = longest ? 2 : 1;
+        size_t plen;
+        const char *ptext = expand_part(rest + skip, rlen - skip, &plen);
+        Pattern *pat = ptext ? get_pattern(ptext, plen) : NULL;
+        long cut;
+
+        if (!pat) {
+            return -1;
+        }
+        if (rest[0] == '#') {
+            cut = match_prefix(pat, s, n, longest);
+            return cut < 0 ? put(b, s, n) : put(b, s + cut, n - (size_t)cut);
+        }
+        cut = match_suffix(pat, s, n, longest);
+        return put(b, s, cut < 0 ? n : n - (size_t)cut);
+    }
+
+    /* Replace matches */
+    if (rest[0] == '/') {
+        int all = rlen > 1 && rest[1] == '/';
+        int anchor = rlen > 1 && (rest[1] == '#' || rest[1] == '%') ? rest[1] : 0;
+        size_t start = all || anchor ? 2 : 1;
+        size_t slash = start + scan_to(rest + start, rlen - start, '/');
+        size_t plen;
+        size_t rep_len = 0;
+        const char *ptext = expand_part(rest + start, slash - start, &plen);
+        const char *rep = slash < rlen ? expand_part(rest + slash + 1, rlen - slash - 1, &rep_len) : "";
+        Pattern *pat = ptext && rep ? get_pattern(ptext, plen) : NULL;
+        size_t from = 0;
+        size_t end;
+        long pos;
+
+        if (!pat) {
+            return -1;
+        }
+        if (anchor) {
+            long cut = anchor == '#' ? match_prefix(pat, s, n, 1) : match_suffix(pat, s, n, 1);
+            if (cut < 0) return put(b, s, n);
+            if (anchor == '#') {
+                return put(b, rep, rep_len) || put(b, s + cut, n - (size_t)cut);
+            }
+            return put(b, s, n - (size_t)cut) || put(b, rep, rep_len);
+        }
+
+        while (from < n && (pos = find_match(pat, s, n, from, &end)) >= 0) {
+            if (put(b, s + from, (size_t)pos - from) != 0 || put(b, rep, rep_len) != 0) {
+                return -1;
+            }
+            from = end;
+            if (!all) break;
+        }
+        return put(b, s + from, n - from);
+    }
+
+    print_error("Bad substitution");
+    return put(b, "", 0);
+}
+
+/**
+ * Expand word[0..n) into b
+ */
+static int expand_into(Builder *b, const char *word, size_t n) {
+    size_t i = 0;
+    char num[32];
+
+    while (i < n) {
+        const char *dollar = (const char*)memchr(word + i, '$', n - i);
+        size_t next = dollar ? (size_t)(dollar - word) : n;
+
+        if (put(b, word + i, next - i) != 0) {
+            return -1;
+        }
+        i = next;
+        if (i >= n) {
+            break;
+        }
+
+        if (i + 1 < n && word[i + 1] == '{') {
+            size_t close = skip_braced(word, n, i);
+            if (close < n) {
+                if (expand_braced(b, word + i + 2, close - i - 2) != 0) {
+                    return -1;
+                }
+                i = close + 1;
+                continue;
+            }
+        } else if (i + 2 < n && word[i + 1] == '(' && word[i + 2] == '(') {
+            /* $((expression)): the inner ( must close right before the outer one */
+            size_t close = match_paren(word, n, i + 2);
+            if (close + 1 < n && word[close + 1] == ')') {
+                int64_t value;
+                if (arith_eval(word + i + 3, close - i - 3, &value) == 0) {
+                    snprintf(num, sizeof(num), "%lld", (long long)value);
+                    if (put_str(b, num) != 0) {
+                        return -1;
+                    }
+                } else if (put(b, "", 0) != 0) {
+                    return -1;
+                }
+                i = close + 2;
+                continue;
+            }
+        } else if (i + 1 < n && (word[i + 1] == '?' || word[i + 1] == '$')) {
+            snprintf(num, sizeof(num), "%d", word[i + 1] == '?' ? g_last_exit_status : (int)getpid());
+            if (put_str(b, num) != 0) {
+                return -1;
+            }
+            i += 2;
+            continue;
+        } else if (i + 1 < n && (isdigit((unsigned char)word[i + 1]) ||
+                   word[i + 1] == '#' || word[i + 1] == '@' || word[i + 1] == '*')) {
+            /* $1 ... $9, $#, $@ and $* */
+            if (put_str(b, var_lookup(word + i + 1, 1)) != 0) {
+                return -1;
+            }
+            i += 2;
+            continue;
+        } else if (i + 1 < n && (isalpha((unsigned char)word[i + 1]) || word[i + 1] == '_')) {
+            size_t end = i + 1;
+            while (end < n && (isalnum((unsigned char)word[end]) || word[end] == '_')) end++;
+            if (put_str(b, var_lookup(word + i + 1, end - i - 1)) != 0) {
+                return -1;
+            }
+            i = end;
+            continue;
+        }
+
+        /* A lone $ stays as it is */
+        if (put(b, "$", 1) != 0) {
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+/**
+ * Expand the variables in a word
+ * Returns the result in the per-line arena, or NULL when the word has
+ * nothing to expand
+ */
+char* expand_word(const char *word) {
+    Builder b = { NULL, 0, 0 };
+
+    if (!strchr(word, '$')) {
+        return NULL;
+    }
+    if (expand_into(&b, word, strlen(word)) != 0) {
+        print_error("Memory allocation failed");
+        return NULL;
+    }
+    return b.data ? b.data : arena_copy("", 0);
+}
+
+/**
+ * Print pattern cache statistics
+ */
+void expand_print_stats(void) {
+    out_printf("patterns: %lu compiled, %lu cache hits\n", g_pattern_compiles, g_pattern_hits);
+}
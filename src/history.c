@@ -1,3 +1,7 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
 #include "../include/shell.h"
 
 /**
@@ -69,20 +73,20 @@ void print_history(History *hist) {
     }
 
     if (hist->count == 0) {
-        printf("%sNo commands in history%s\n", COLOR_YELLOW, COLOR_RESET);
+        out_printf("%sNo commands in history%s\n", COLOR_YELLOW, COLOR_RESET);
         return;
     }
 
-    printf("%s", COLOR_CYAN);
-    printf("\n===========================================================\n");
-    printf("                    Command History                        \n");
-    printf("===========================================================\n");
-    printf("%s", COLOR_RESET);
+    out_puts(COLOR_CYAN);
+    out_puts("\n===========================================================\n");
+    out_puts("                    Command History                        \n");
+    out_puts("===========================================================\n");
+    out_puts(COLOR_RESET);
 
     for (int i = 0; i < hist->count; i++) {
-        printf("%s%4d%s  %s\n", COLOR_GREEN, i + 1, COLOR_RESET, hist->commands[i]);
+        out_printf("%s%4d%s  %s\n", COLOR_GREEN, i + 1, COLOR_RESET, hist->commands[i]);
     }
-    printf("\n");
+    out_write("\n", 1);
 }
 
 /**
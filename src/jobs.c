@@ -0,0 +1,606 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#endif
+
+/*
+ * Job control
+ *
+ * On a terminal every external command runs in a process group of its own,
+ * and the foreground job owns the terminal while it runs, so Ctrl-C and
+ * Ctrl-Z reach the whole job instead of the shell. Background and stopped
+ * jobs are kept in a table for jobs, fg and bg.
+ *
+ * Signal handlers only write to a self-pipe (utils.c). The line editor
+ * polls that pipe and the zygote's socket together with the terminal and
+ * calls jobs_update() to collect state changes; they are reported before
+ * the next prompt.
+ *
+ * A coprocess (coproc NAME cmd) is a background job whose standard input
+ * and output are pipes to the shell. Its entry keeps the shell's ends, in
+ * descriptors 3-9 so that redirections can name them: NAME[0] reads what it
+ * writes and NAME[1] writes to it, e.g. echo 1+1 >&${NAME[1]} followed by
+ * read -u ${NAME[0]} sum. Both stay open until the job is reported done or
+ * the shell exits; they are close-on-exec, so other commands never hold its
+ * input open and it sees EOF when the shell lets go.
+ */
+
+static int g_interactive = 0;
+
+int jobs_interactive(void) {
+    return g_interactive;
+}
+
+#ifndef _WIN32
+
+#define MAX_JOBS 64
+#define COPROC_GRACE_MS 100     /* for a coprocess to exit at shell exit */
+
+enum {
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+};
+
+typedef struct {
+    int id;                 /* 0: free slot */
+    pid_t pgid;             /* also the pid of its only process */
+    int via_zygote;
+    int state;
+    int status;             /* wait status once done */
+    int changed;            /* state change not reported yet */
+    char *command;
+    char *coproc;           /* NAME of a coprocess, NULL for other jobs */
+    int fds[2];             /* its NAME[0] and NAME[1] */
+} Job;
+
+static Job g_jobs[MAX_JOBS];
+static pid_t g_shell_pgid;
+static struct termios g_shell_tmodes;
+
+/**
+ * Put the shell in its own process group in the terminal's foreground
+ */
+void jobs_init(void) {
+    zygote_set_notify(jobs_notify);
+
+    if (!isatty(STDIN_FILENO)) {
+        return;
+    }
+
+    /* Started in the background: wait until we are brought forward */
+    while (tcgetpgrp(STDIN_FILENO) != (g_shell_pgid = getpgrp())) {
+        kill(-g_shell_pgid, SIGTTIN);
+    }
+
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    if (getpid() != g_shell_pgid && setpgid(0, 0) == 0) {
+        g_shell_pgid = getpid();
+    }
+    tcsetpgrp(STDIN_FILENO, g_shell_pgid);
+    tcgetattr(STDIN_FILENO, &g_shell_tmodes);
+    g_interactive = 1;
+}
+
+/**
+ * Close the shell's ends of a coprocess's pipes and unset NAME and NAME_PID
+ */
+static void release_coproc(Job *job) {
+    char pid_name[300];
+
+    redirect_free_slot(job->fds[0]);
+    redirect_free_slot(job->fds[1]);
+    job->fds[0] = job->fds[1] = -1;
+
+    snprintf(pid_name, sizeof(pid_name), "%s_PID", job->coproc);
+    var_unset(job->coproc);
+    var_unset(pid_name);
+    free(job->coproc);
+    job->coproc = NULL;
+}
+
+/**
+ * Give a coprocess its EOF at shell exit and collect it, killing it if it
+ * is still running after COPROC_GRACE_MS. Its exit shows in the job state:
+ * the zygote reaps its own children and only sends a notice
+ */
+static void reap_coproc(Job *job) {
+    struct timespec tick = { 0, 1000000 };
+
+    release_coproc(job);
+    if (job->state == JOB_STOPPED) {
+        kill(job->pgid, SIGCONT);
+    }
+    for (int ms = 0; ms < COPROC_GRACE_MS && job->state != JOB_DONE; ms++) {
+        nanosleep(&tick, NULL);
+        jobs_update();
+    }
+    if (job->state == JOB_DONE) {
+        return;
+    }
+
+    kill(job->pgid, SIGKILL);
+    if (!job->via_zygote) {
+        waitpid(job->pgid, NULL, 0);
+        return;
+    }
+    for (int ms = 0; ms < COPROC_GRACE_MS && job->state != JOB_DONE; ms++) {
+        nanosleep(&tick, NULL);
+        zygote_poll_notices();
+    }
+}
+
+/**
+ * Hang up stopped jobs and collect coprocesses when the shell exits, so
+ * they do not linger
+ */
+void jobs_cleanup(void) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (g_jobs[i].id && g_jobs[i].coproc) {
+            reap_coproc(&g_jobs[i]);
+        }
+        if (g_jobs[i].id && g_jobs[i].state == JOB_STOPPED) {
+            kill(-g_jobs[i].pgid, SIGHUP);
+            kill(-g_jobs[i].pgid, SIGCONT);
+        }
+        free(g_jobs[i].command);
+        g_jobs[i].command = NULL;
+        g_jobs[i].id = 0;
+    }
+}
+
+/**
+ * Hand the terminal to a foreground job
+ */
+void jobs_foreground(pid_t pgid) {
+    if (g_interactive) {
+        tcsetpgrp(STDIN_FILENO, pgid);
+    }
+}
+
+/**
+ * Take the terminal back, with the modes the shell had
+ */
+void jobs_reclaim_terminal(void) {
+    if (g_interactive) {
+        tcsetpgrp(STDIN_FILENO, g_shell_pgid);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &g_shell_tmodes);
+    }
+}
+
+static Job* find_job(pid_t pgid) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (g_jobs[i].id && g_jobs[i].pgid == pgid) {
+            return &g_jobs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * The job fg and bg act on: %N or N, else the most recent one
+ */
+static Job* select_job(const char *spec) {
+    Job *latest = NULL;
+
+    if (spec) {
+        int id = atoi(spec[0] == '%' ? spec + 1 : spec);
+        for (int i = 0; i < MAX_JOBS; i++) {
+            if (g_jobs[i].id == id && g_jobs[i].state != JOB_DONE) {
+                return &g_jobs[i];
+            }
+        }
+        return NULL;
+    }
+
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (g_jobs[i].id && g_jobs[i].state != JOB_DONE &&
+            (!latest || g_jobs[i].id > latest->id)) {
+            latest = &g_jobs[i];
+        }
+    }
+    return latest;
+}
+
+/**
+ * Command line of a job as shown by jobs
+ */
+static char* command_text(const Command *cmd) {
+    size_t len = 1;
+    char *text;
+
+    for (int i = 0; i < cmd->token_count; i++) {
+        len += strlen(cmd->tokens[i]) + 1;
+    }
+    text = (char*)malloc(len);
+    if (!text) {
+        return NULL;
+    }
+
+    text[0] = '\0';
+    for (int i = 0; i < cmd->token_count; i++) {
+        if (i > 0) strcat(text, " ");
+        strcat(text, cmd->tokens[i]);
+    }
+    return text;
+}
+
+/**
+ * Enter a job in the table; returns its number, -1 when the table is full
+ */
+int jobs_add(pid_t pgid, int via_zygote, const Command *cmd, int stopped) {
+    int id = 1;
+    Job *slot = NULL;
+
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (g_jobs[i].id >= id) id = g_jobs[i].id + 1;
+        if (!g_jobs[i].id && !slot) slot = &g_jobs[i];
+    }
+    if (!slot) {
+        return -1;
+    }
+
+    slot->id = id;
+    slot->pgid = pgid;
+    slot->via_zygote = via_zygote;
+    slot->state = stopped ? JOB_STOPPED : JOB_RUNNING;
+    slot->status = 0;
+    slot->changed = 0;
+    slot->command = cmd ? command_text(cmd) : NULL;
+    slot->coproc = NULL;
+    slot->fds[0] = slot->fds[1] = -1;
+    return id;
+}
+
+static void remove_job(Job *job) {
+    if (job->coproc) {
+        release_coproc(job);
+    }
+    free(job->command);
+    job->command = NULL;
+    job->id = 0;
+}
+
+/**
+ * Record a wait status reported for pid
+ */
+void jobs_notify(pid_t pid, int status) {
+    Job *job = find_job(pid);
+
+    if (!job) {
+        return;
+    }
+    if (WIFSTOPPED(status)) {
+        job->state = JOB_STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        job->state = JOB_RUNNING;
+        return;
+    } else {
+        job->state = JOB_DONE;
+        job->status = status;
+    }
+    job->changed = 1;
+}
+
+/**
+ * Descriptors that signal job events: the self-pipe and the zygote socket
+ */
+int jobs_event_fds(int *fds) {
+    int count = 0;
+
+    if (signal_fd() >= 0) fds[count++] = signal_fd();
+    if (zygote_fd() >= 0) fds[count++] = zygote_fd();
+    return count;
+}
+
+/**
+ * Collect state changes of background jobs without blocking
+ */
+void jobs_update(void) {
+    if (signal_fd() >= 0) {
+        consume_signals();
+    }
+    zygote_poll_notices();
+
+    for (int i = 0; i < MAX_JOBS; i++) {
+        int status;
+
+        if (!g_jobs[i].id || g_jobs[i].via_zygote || g_jobs[i].state == JOB_DONE) {
+            continue;
+        }
+        while (waitpid(g_jobs[i].pgid, &status, WNOHANG | WUNTRACED | WCONTINUED) > 0) {
+            jobs_notify(g_jobs[i].pgid, status);
+        }
+    }
+}
+
+/**
+ * Wait for a foreground job to exit or stop, then take the terminal back
+ * A job that stops is kept in the table; returns the exit status
+ */
+int job_wait(pid_t pid, int via_zygote, const Command *cmd) {
+    Job *job = find_job(pid);
+    int status;
+    int rc = 0;
+
+    if (via_zygote) {
+        rc = zygote_wait(pid, &status);
+    } else {
+        while ((rc = waitpid(pid, &status, WUNTRACED)) < 0 && errno == EINTR) {
+            continue;
+        }
+    }
+    jobs_reclaim_terminal();
+
+    if (rc < 0) {
+        if (job) remove_job(job);
+        return -1;
+    }
+
+    if (WIFSTOPPED(status)) {
+        int id = job ? job->id : jobs_add(pid, via_zygote, cmd, 1);
+        if (job) job->state = JOB_STOPPED;
+        if (id > 0) {
+            job = find_job(pid);
+            printf("\n[%d]+  Stopped                 %s\n", id, job->command ? job->command : "");
+        }
+        return 128 + WSTOPSIG(status);
+    }
+
+    if (job) remove_job(job);
+    if (WIFSIGNALED(status)) {
+        if (WTERMSIG(status) == SIGINT && g_interactive) printf("\n");
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * Print jobs that finished or stopped since the last prompt
+ */
+void jobs_report(void) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job *job = &g_jobs[i];
+
+        if (!job->id || !job->changed) {
+            continue;
+        }
+        job->changed = 0;
+
+        if (job->state == JOB_STOPPED) {
+            printf("[%d]+  Stopped                 %s\n", job->id, job->command ? job->command : "");
+        } else if (job->state == JOB_DONE) {
+            if (WIFEXITED(job->status) && WEXITSTATUS(job->status) != 0) {
+                printf("[%d]   Exit %-18d %s\n", job->id, WEXITSTATUS(job->status),
+                       job->command ? job->command : "");
+            } else {
+                printf("[%d]   Done                    %s\n", job->id,
+                       job->command ? job->command : "");
+            }
+            remove_job(job);
+        }
+    }
+    fflush(stdout);
+}
+
+/**
+ * List background and stopped jobs
+ */
+int builtin_jobs(char **args) {
+    (void)args;
+    jobs_update();
+
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job *job = &g_jobs[i];
+
+        if (!job->id) {
+            continue;
+        }
+        out_printf("[%d]   %-24s%s%s\n", job->id,
+                   job->state == JOB_STOPPED ? "Stopped" :
+                   job->state == JOB_DONE ? "Done" : "Running",
+                   job->command ? job->command : "",
+                   job->state == JOB_RUNNING ? " &" : "");
+        if (job->state == JOB_DONE) {
+            remove_job(job);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Continue a job in the foreground and wait for it
+ */
+int builtin_fg(char **args) {
+    Job *job;
+
+    jobs_update();
+    job = select_job(args[1]);
+    if (!job) {
+        print_error("fg: no such job");
+        return -1;
+    }
+
+    out_printf("%s\n", job->command ? job->command : "");
+    out_flush();
+
+    job->state = JOB_RUNNING;
+    job->changed = 0;
+    jobs_foreground(job->pgid);
+    kill(-job->pgid, SIGCONT);
+    return job_wait(job->pgid, job->via_zygote, NULL);
+}
+
+/**
+ * Continue a stopped job in the background
+ */
+int builtin_bg(char **args) {
+    Job *job;
+
+    jobs_update();
+    job = select_job(args[1]);
+    if (!job) {
+        print_error("bg: no such job");
+        return -1;
+    }
+
+    job->state = JOB_RUNNING;
+    job->changed = 0;
+    kill(-job->pgid, SIGCONT);
+    out_printf("[%d]+ %s &\n", job->id, job->command ? job->command : "");
+    return 0;
+}
+
+/* Exec resets a handler, unlike SIG_IGN, so commands still get SIGPIPE */
+static void ignore_signal(int sig) {
+    (void)sig;
+}
+
+/**
+ * coproc NAME command [args]
+ */
+int builtin_coproc(Command *cmd) {
+    char **args = cmd->tokens;
+    char pid_name[300];
+    char pid_text[16];
+    char **items;
+    int to[2], from[2];
+    int fds[2];
+    int via_zygote;
+    Command inner;
+    pid_t pid;
+    int id;
+
+    if (cmd->token_count < 3 || !valid_var_name(args[1], strlen(args[1])) ||
+        strlen(args[1]) > 255) {
+        print_error("Usage: coproc NAME command [args]");
+        return -1;
+    }
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (g_jobs[i].id && g_jobs[i].coproc && strcmp(g_jobs[i].coproc, args[1]) == 0) {
+            print_error("coproc: a coprocess of that name is already running");
+            return -1;
+        }
+    }
+    if (cmd->redirect_count == MAX_REDIRECTS) {
+        print_error("Too many redirections");
+        return -1;
+    }
+
+    if (pipe2(to, O_CLOEXEC) != 0) {
+        print_error("Failed to create pipe");
+        return -1;
+    }
+    if (pipe2(from, O_CLOEXEC) != 0) {
+        close(to[0]);
+        close(to[1]);
+        print_error("Failed to create pipe");
+        return -1;
+    }
+
+    /* The shell's ends go where redirections can name them */
+    fds[0] = redirect_take_slot(from[0]);
+    fds[1] = fds[0] < 0 ? -1 : redirect_take_slot(to[1]);
+    if (fds[1] < 0) {
+        if (fds[0] >= 0) redirect_free_slot(fds[0]);
+        else close(to[1]);
+        close(to[0]);
+        close(from[1]);
+        print_error("coproc: no free descriptor between 3 and 9");
+        return -1;
+    }
+
+    /* Its stdin is the pipe, before any redirections of its own */
+    init_subcommand(&inner, cmd, 2);
+    inner.input_file = NULL;
+    inner.background = 1;
+    memmove(inner.redirects + 1, inner.redirects, (size_t)inner.redirect_count * sizeof(Redirect));
+    inner.redirects[0].fd = STDIN_FILENO;
+    inner.redirects[0].type = REDIR_DUP;
+    inner.redirects[0].source = to[0];
+    inner.redirects[0].file = NULL;
+    inner.redirect_count++;
+
+    pid = spawn_command(&inner, from[1], &via_zygote, 1);
+    close(to[0]);
+    close(from[1]);
+
+    id = pid < 0 ? -1 : jobs_add(pid, via_zygote, cmd, 0);
+    if (id < 0) {
+        if (pid > 0) {
+            print_error("coproc: too many jobs");
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        redirect_free_slot(fds[0]);
+        redirect_free_slot(fds[1]);
+        return -1;
+    }
+
+    Job *job = find_job(pid);
+    job->coproc = strdup(args[1]);
+    job->fds[0] = fds[0];
+    job->fds[1] = fds[1];
+
+    items = (char**)calloc(2, sizeof(char*));
+    if (items && (items[0] = (char*)malloc(12)) && (items[1] = (char*)malloc(12))) {
+        snprintf(items[0], 12, "%d", fds[0]);
+        snprintf(items[1], 12, "%d", fds[1]);
+        var_set_array(args[1], items, 2);
+    } else if (items) {
+        free(items[0]);
+        free(items);
+    }
+    snprintf(pid_name, sizeof(pid_name), "%s_PID", args[1]);
+    snprintf(pid_text, sizeof(pid_text), "%d", pid);
+    var_set(pid_name, pid_text);
+
+    signal(SIGPIPE, ignore_signal);
+    out_printf("[%d] %d\n", id, pid);
+    return 0;
+}
+
+#else
+
+void jobs_init(void) {
+}
+
+void jobs_cleanup(void) {
+}
+
+void jobs_update(void) {
+}
+
+void jobs_report(void) {
+}
+
+int builtin_jobs(char **args) {
+    print_error("Job control is not supported on Windows");
+    return -1;
+}
+
+int builtin_fg(char **args) {
+    print_error("Job control is not supported on Windows");
+    return -1;
+}
+
+int builtin_bg(char **args) {
+    print_error("Job control is not supported on Windows");
+    return -1;
+}
+
+int builtin_coproc(Command *cmd) {
+    print_error("coproc is not supported on Windows");
+    return -1;
+}
+
+#endif
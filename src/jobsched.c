@@ -0,0 +1,293 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/*
+ * CPU placement and priority of spawned commands
+ *
+ *   taskset [-c] CPUS [command [args]]
+ *       Run command on CPUS, given as a hex mask or with -c as a list such
+ *       as 0-3,6. Without a command, CPUS applies to all later commands
+ *       ("all" lifts it); without arguments the current set is shown.
+ *
+ *   nice [-n N] [command [args]]
+ *       Run command at the shell's niceness plus N (default 10). Without a
+ *       command, N applies to all later commands.
+ *
+ *   jobsched [off | spread [-n N]]
+ *       With spread, the shell is pinned to one of its CPUs and every
+ *       background job to a CPU of its own, taken round-robin from the
+ *       others, at niceness +N (default 10). off unpins the shell.
+ *
+ * The settings go into the spawn attributes and are applied in the child
+ * with sched_setaffinity() and setpriority() before exec.
+ */
+
+#define DEFAULT_NICE 10
+
+#ifndef _WIN32
+
+/**
+ * Parse a CPU list such as 0-3,6 into cpus; 0 on success
+ */
+static int parse_cpu_list(const char *str, uint64_t *cpus) {
+    memset(cpus, 0, SPAWN_CPU_WORDS * sizeof(uint64_t));
+
+    while (*str) {
+        char *end;
+        long first = strtol(str, &end, 10);
+        long last = first;
+
+        if (end == str || first < 0) {
+            return -1;
+        }
+        if (*end == '-') {
+            str = end + 1;
+            last = strtol(str, &end, 10);
+            if (end == str || last < first) {
+                return -1;
+            }
+        }
+        if (last >= SPAWN_MAX_CPUS) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+        }
+
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        str = end;
+    }
+    return 0;
+}
+
+/**
+ * Parse a hex CPU mask such as 0x3 or ff into cpus; 0 on success
+ */
+static int parse_cpu_mask(const char *str, uint64_t *cpus) {
+    size_t len;
+    int bit = 0;
+
+    memset(cpus, 0, SPAWN_CPU_WORDS * sizeof(uint64_t));
+    if (strncmp(str, "0x", 2) == 0 || strncmp(str, "0X", 2) == 0) {
+        str += 2;
+    }
+    len = strlen(str);
+    if (len == 0 || len * 4 > SPAWN_MAX_CPUS) {
+        return -1;
+    }
+
+    /* Least significant digit last */
+    for (size_t i = len; i-- > 0; bit += 4) {
+        char c = str[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) {
+            return -1;
+        }
+        cpus[bit / 64] |= (uint64_t)digit << (bit % 64);
+    }
+    return 0;
+}
+
+static int cpus_empty(const uint64_t *cpus) {
+    for (int i = 0; i < SPAWN_CPU_WORDS; i++) {
+        if (cpus[i]) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Print a CPU set as a list of ranges
+ */
+static void print_cpu_list(const uint64_t *cpus) {
+    const char *sep = "";
+
+    for (int cpu = 0; cpu < SPAWN_MAX_CPUS; cpu++) {
+        int last = cpu;
+
+        if (!(cpus[cpu / 64] >> (cpu % 64) & 1)) continue;
+        while (last + 1 < SPAWN_MAX_CPUS && (cpus[(last + 1) / 64] >> ((last + 1) % 64) & 1)) {
+            last++;
+        }
+        if (last > cpu) {
+            out_printf("%s%d-%d", sep, cpu, last);
+        } else {
+            out_printf("%s%d", sep, cpu);
+        }
+        sep = ",";
+        cpu = last;
+    }
+    out_puts("\n");
+}
+
+/**
+ * taskset [-c] CPUS [command [args]]
+ */
+int builtin_taskset(Command *cmd) {
+    char **args = cmd->tokens;
+    uint64_t cpus[SPAWN_CPU_WORDS];
+    SpawnAttr saved;
+    int list = 0;
+    int i = 1;
+
+    spawn_attr_current(&saved);
+
+    if (!args[i]) {
+        if (saved.cpus_set) {
+            print_cpu_list(saved.cpus);
+        } else {
+            out_puts("all\n");
+        }
+        return 0;
+    }
+
+    if (strcmp(args[i], "-c") == 0) {
+        list = 1;
+        i++;
+    }
+    if (!args[i]) {
+        print_error("Usage: taskset [-c] CPUS [command [args]]");
+        return -1;
+    }
+
+    if (strcmp(args[i], "all") == 0) {
+        spawn_set_cpus(NULL);
+    } else if ((list ? parse_cpu_list(args[i], cpus) : parse_cpu_mask(args[i], cpus)) != 0 ||
+               cpus_empty(cpus)) {
+        print_error("taskset: invalid CPU set");
+        return -1;
+    } else {
+        spawn_set_cpus(cpus);
+    }
+    if (!args[i + 1]) {
+        return 0;
+    }
+
+    /* One command only: put the previous setting back afterwards */
+    int status = run_subcommand(cmd, i + 1);
+    spawn_attr_restore(&saved);
+    return status;
+}
+
+/**
+ * nice [-n N] [command [args]]
+ */
+int builtin_nice(Command *cmd) {
+    char **args = cmd->tokens;
+    int increment = DEFAULT_NICE;
+    SpawnAttr saved;
+    int i = 1;
+
+    spawn_attr_current(&saved);
+
+    if (!args[i]) {
+        int value;
+
+        errno = 0;
+        value = saved.nice_set ? saved.nice : getpriority(PRIO_PROCESS, 0);
+        if (value == -1 && errno != 0) {
+            print_error("nice: failed to get priority");
+            return -1;
+        }
+        out_printf("%d\n", value);
+        return 0;
+    }
+
+    if (strcmp(args[i], "-n") == 0) {
+        char *end;
+
+        if (!args[i + 1]) {
+            print_error("Usage: nice [-n N] [command [args]]");
+            return -1;
+        }
+        increment = (int)strtol(args[i + 1], &end, 10);
+        if (end == args[i + 1] || *end != '\0') {
+            print_error("nice: invalid adjustment");
+            return -1;
+        }
+        i += 2;
+    }
+
+    if (spawn_set_nice(increment) != 0) {
+        print_error("nice: failed to get priority");
+        return -1;
+    }
+    if (!args[i]) {
+        return 0;
+    }
+
+    int status = run_subcommand(cmd, i);
+    spawn_attr_restore(&saved);
+    return status;
+}
+
+#else
+
+int builtin_taskset(Command *cmd) {
+    print_error("taskset is not supported on Windows");
+    return -1;
+}
+
+int builtin_nice(Command *cmd) {
+    print_error("nice is not supported on Windows");
+    return -1;
+}
+
+#endif
+
+/**
+ * jobsched [off | spread [-n N]]
+ */
+int builtin_jobsched(char **args) {
+    int increment;
+
+    if (!args[1]) {
+        if (spawn_get_policy(&increment) == SPAWN_POLICY_SPREAD) {
+            out_printf("spread (nice %+d)\n", increment);
+        } else {
+            out_puts("off\n");
+        }
+        return 0;
+    }
+
+    if (strcmp(args[1], "off") == 0 && !args[2]) {
+        spawn_set_policy(SPAWN_POLICY_OFF, 0);
+        return 0;
+    }
+
+    if (strcmp(args[1], "spread") == 0) {
+        increment = DEFAULT_NICE;
+        if (args[2] && strcmp(args[2], "-n") == 0 && args[3] && !args[4]) {
+            char *end;
+            increment = (int)strtol(args[3], &end, 10);
+            if (end == args[3] || *end != '\0') {
+                print_error("jobsched: invalid adjustment");
+                return -1;
+            }
+        } else if (args[2]) {
+            print_error("Usage: jobsched [off | spread [-n N]]");
+            return -1;
+        }
+
+        if (spawn_set_policy(SPAWN_POLICY_SPREAD, increment) != 0) {
+            print_error("jobsched: not supported on this system");
+            return -1;
+        }
+        return 0;
+    }
+
+    print_error("Usage: jobsched [off | spread [-n N]]");
+    return -1;
+}
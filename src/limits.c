@@ -0,0 +1,298 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Time and resource limits for commands
+ *
+ *   timeout [-s SIG] [-k GRACE] DURATION command [args]
+ *       Run command; when DURATION expires send it SIG (default TERM) and,
+ *       with -k, SIGKILL once GRACE has passed as well. The shell waits on
+ *       the child's pidfd, so no watchdog process is involved. Exits with
+ *       124 when the limit was hit (137 if SIGKILL was needed).
+ *
+ *   ulimit [-S|-H] [-a|-t|-v|-n|-u] [value|unlimited]
+ *       Show or set the limits of commands started afterwards. The limits
+ *       are applied in each child before exec, never to the shell itself.
+ */
+
+#define TIMEOUT_EXPIRED 124
+
+static const struct {
+    char option;
+    int which;
+    const char *desc;
+    const char *unit;
+    uint64_t scale;         /* limit units per unit shown to the user */
+} ulimit_options[] = {
+    {'t', SPAWN_LIMIT_CPU, "cpu time", "seconds", 1},
+    {'v', SPAWN_LIMIT_AS, "virtual memory", "kbytes", 1024},
+    {'n', SPAWN_LIMIT_NOFILE, "open files", NULL, 1},
+    {'u', SPAWN_LIMIT_NPROC, "max user processes", NULL, 1},
+};
+
+#define ULIMIT_OPTION_COUNT (int)(sizeof(ulimit_options) / sizeof(ulimit_options[0]))
+
+/**
+ * Index of a ulimit resource option, -1 if unknown
+ */
+static int find_ulimit_option(char option) {
+    for (int i = 0; i < ULIMIT_OPTION_COUNT; i++) {
+        if (ulimit_options[i].option == option) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifndef _WIN32
+
+static const struct {
+    const char *name;
+    int sig;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"TERM", SIGTERM}, {"ABRT", SIGABRT}, {"USR1", SIGUSR1}, {"USR2", SIGUSR2},
+    {"ALRM", SIGALRM}, {"CONT", SIGCONT}, {"STOP", SIGSTOP},
+    {NULL, 0}
+};
+
+/**
+ * Parse a signal given as a number, NAME or SIGNAME; -1 if unknown
+ */
+static int parse_signal(const char *str) {
+    char *end;
+    long num = strtol(str, &end, 10);
+
+    if (end != str && *end == '\0') {
+        return num > 0 && num < 65 ? (int)num : -1;
+    }
+    if (strncmp(str, "SIG", 3) == 0) {
+        str += 3;
+    }
+    for (int i = 0; signal_names[i].name; i++) {
+        if (strcmp(str, signal_names[i].name) == 0) {
+            return signal_names[i].sig;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Parse a duration such as 10, 2.5 or 1m (s, m, h, d); -1 if invalid
+ */
+static double parse_duration(const char *str) {
+    char *end;
+    double value = strtod(str, &end);
+
+    if (end == str || value < 0) {
+        return -1;
+    }
+    switch (*end) {
+        case '\0':
+        case 's': break;
+        case 'm': value *= 60; break;
+        case 'h': value *= 3600; break;
+        case 'd': value *= 86400; break;
+        default: return -1;
+    }
+    if (*end != '\0' && end[1] != '\0') {
+        return -1;
+    }
+    return value;
+}
+
+/**
+ * Wait up to seconds for the process behind pidfd to exit
+ * Returns 1 when it exited, 0 on timeout, -1 on error
+ */
+static int wait_pidfd(int pidfd, double seconds) {
+    double deadline = now_seconds() + seconds;
+    struct pollfd pfd;
+
+    pfd.fd = pidfd;
+    pfd.events = POLLIN;
+
+    while (1) {
+        double left = deadline - now_seconds();
+        int ms = left > 0 ? (int)(left * 1000) + 1 : 0;
+        int n = poll(&pfd, 1, ms);
+
+        if (n > 0) return 1;
+        if (n == 0 && now_seconds() >= deadline) return 0;
+        if (n < 0 && errno != EINTR) return -1;
+    }
+}
+
+/**
+ * timeout [-s SIG] [-k GRACE] DURATION command [args]
+ */
+int builtin_timeout(Command *cmd) {
+    char **args = cmd->tokens;
+    int sig = SIGTERM;
+    double grace = 0;
+    double duration;
+    int i = 1;
+
+    while (args[i] && args[i][0] == '-' && args[i + 1]) {
+        if (strcmp(args[i], "-s") == 0) {
+            sig = parse_signal(args[i + 1]);
+        } else if (strcmp(args[i], "-k") == 0) {
+            grace = parse_duration(args[i + 1]);
+        } else {
+            break;
+        }
+        i += 2;
+    }
+
+    if (!args[i] || !args[i + 1] || sig < 0 || grace < 0 ||
+        (duration = parse_duration(args[i])) < 0) {
+        print_error("Usage: timeout [-s SIG] [-k GRACE] DURATION command [args]");
+        return -1;
+    }
+
+    Command inner;
+    init_subcommand(&inner, cmd, i + 1);
+    inner.background = 0;
+
+    int via_zygote;
+    pid_t pid = spawn_command(&inner, out_get_fd(), &via_zygote, 0);
+    if (pid < 0) {
+        return -1;
+    }
+
+    /* A job in a process group of its own is signalled as a whole */
+    pid_t target = jobs_interactive() ? -pid : pid;
+
+    int expired = 0;
+    int killed = 0;
+
+    /* A duration of 0 disables the limit */
+    if (duration > 0) {
+        int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+
+        if (pidfd < 0) {
+            print_error("timeout: pidfd_open failed, running without a limit");
+        } else {
+            if (wait_pidfd(pidfd, duration) == 0) {
+                expired = 1;
+                kill(target, sig);
+                if (grace > 0 && wait_pidfd(pidfd, grace) == 0) {
+                    kill(target, SIGKILL);
+                    killed = 1;
+                }
+            }
+            close(pidfd);
+        }
+    }
+
+    int status = wait_command(&inner, pid, via_zygote);
+
+    if (expired) {
+        return killed ? 128 + SIGKILL : TIMEOUT_EXPIRED;
+    }
+    return status;
+}
+
+#else
+
+int builtin_timeout(Command *cmd) {
+    print_error("timeout is not supported on Windows");
+    return -1;
+}
+
+#endif
+
+/**
+ * Print one limit as ulimit shows it
+ */
+static void print_limit(int option, int hard, int with_label) {
+    uint64_t value;
+
+    if (with_label) {
+        char label[64];
+        if (ulimit_options[option].unit) {
+            snprintf(label, sizeof(label), "(%s, -%c)",
+                     ulimit_options[option].unit, ulimit_options[option].option);
+        } else {
+            snprintf(label, sizeof(label), "(-%c)", ulimit_options[option].option);
+        }
+        out_printf("%-20s %-14s ", ulimit_options[option].desc, label);
+    }
+
+    if (spawn_limit_get(ulimit_options[option].which, hard, &value) != 0) {
+        out_puts("unknown\n");
+    } else if (value == SPAWN_LIMIT_UNLIMITED) {
+        out_puts("unlimited\n");
+    } else {
+        out_printf("%llu\n", (unsigned long long)(value / ulimit_options[option].scale));
+    }
+}
+
+/**
+ * ulimit [-S|-H] [-a|-t|-v|-n|-u] [value|unlimited]
+ */
+int builtin_ulimit(char **args) {
+    int soft = 0;
+    int hard = 0;
+    int all = 0;
+    int option = -1;
+    int i = 1;
+
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        for (const char *p = args[i] + 1; *p; p++) {
+            if (*p == 'S') {
+                soft = 1;
+            } else if (*p == 'H') {
+                hard = 1;
+            } else if (*p == 'a') {
+                all = 1;
+            } else if ((option = find_ulimit_option(*p)) < 0) {
+                print_error("Usage: ulimit [-S|-H] [-a|-t|-v|-n|-u] [value|unlimited]");
+                return -1;
+            }
+        }
+    }
+
+    if (all) {
+        for (int j = 0; j < ULIMIT_OPTION_COUNT; j++) {
+            print_limit(j, hard && !soft, 1);
+        }
+        return 0;
+    }
+    if (option < 0) {
+        /* There is no file size limit (-f) here; default to open files */
+        option = find_ulimit_option('n');
+    }
+    if (!args[i]) {
+        print_limit(option, hard && !soft, 0);
+        return 0;
+    }
+
+    uint64_t value;
+    if (strcmp(args[i], "unlimited") == 0) {
+        value = SPAWN_LIMIT_UNLIMITED;
+    } else {
+        char *end;
+        unsigned long long num = strtoull(args[i], &end, 10);
+        if (end == args[i] || *end != '\0' || args[i][0] == '-') {
+            print_error("ulimit: invalid limit");
+            return -1;
+        }
+        value = (uint64_t)num * ulimit_options[option].scale;
+    }
+
+    if (spawn_limit_set(ulimit_options[option].which, soft, hard, value) != 0) {
+        print_error(errno == EPERM ? "ulimit: cannot raise the hard limit"
+                                   : "ulimit: failed to set limit");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,966 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <ctype.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+/* Key codes produced by the input decoder */
+enum {
+    KEY_NONE = 0,
+    KEY_INSERT,         /* run of literal bytes */
+    KEY_ENTER,
+    KEY_TAB,
+    KEY_BACKSPACE,
+    KEY_DELETE,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_HOME,
+    KEY_END,
+    KEY_WORD_LEFT,
+    KEY_WORD_RIGHT,
+    KEY_KILL_WORD_LEFT,     /* Alt-Backspace: alphanumeric word */
+    KEY_KILL_BIGWORD_LEFT,  /* Ctrl-W: whitespace-delimited word */
+    KEY_KILL_WORD_RIGHT,
+    KEY_KILL_EOL,
+    KEY_KILL_BOL,
+    KEY_YANK,
+    KEY_TRANSPOSE,
+    KEY_CLEAR_SCREEN,
+    KEY_INTERRUPT,
+    KEY_EOF,
+    KEY_PASTE_START,
+    KEY_PASTE_END
+};
+
+/* Growable byte buffer used for the line, the kill ring and screen output */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} ByteBuf;
+
+/* Line editor state for the line being read */
+typedef struct {
+    ByteBuf line;           /* text being edited */
+    size_t pos;             /* cursor byte offset into line */
+    char prompt[MAX_PROMPT_SIZE];
+    int prompt_width;       /* columns used by the last prompt line */
+    int cols;               /* terminal width */
+    ByteBuf shown;          /* text currently drawn after the prompt */
+    size_t shown_cursor;    /* cursor column relative to the prompt end */
+    size_t scroll;          /* byte offset of the first visible byte */
+    int history_index;
+    char *saved_line;       /* in-progress line while browsing history */
+    int last_was_kill;
+    int last_was_tab;
+    int pasting;
+} LineEditor;
+
+#define MAX_LISTED_COMPLETIONS 256
+
+static struct termios g_orig_termios;
+static ByteBuf g_kill_ring;
+static ByteBuf g_screen;
+
+/* Pending input bytes that have not been decoded into keys yet */
+static unsigned char g_inbuf[4096];
+static size_t g_inlen = 0;
+
+/**
+ * Make sure a buffer can hold extra bytes
+ */
+static int buf_reserve(ByteBuf *b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) {
+        return 0;
+    }
+
+    size_t cap = b->cap ? b->cap : 128;
+    while (cap < b->len + extra + 1) {
+        cap *= 2;
+    }
+
+    char *data = (char*)realloc(b->data, cap);
+    if (!data) {
+        return -1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+/**
+ * Insert bytes into a buffer at the given offset
+ */
+static int buf_insert(ByteBuf *b, size_t at, const char *s, size_t n) {
+    if (buf_reserve(b, n) != 0) {
+        return -1;
+    }
+    memmove(b->data + at + n, b->data + at, b->len - at);
+    memcpy(b->data + at, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+/**
+ * Remove a byte range from a buffer
+ */
+static void buf_erase(ByteBuf *b, size_t from, size_t to) {
+    memmove(b->data + from, b->data + to, b->len - to);
+    b->len -= to - from;
+    b->data[b->len] = '\0';
+}
+
+/**
+ * Replace the contents of a buffer
+ */
+static int buf_set(ByteBuf *b, const char *s, size_t n) {
+    b->len = 0;
+    return buf_insert(b, 0, s, n);
+}
+
+static void buf_free(ByteBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+/* UTF-8 continuation bytes do not occupy a terminal column */
+static int is_cont(char c) {
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+static size_t next_char(const ByteBuf *b, size_t pos) {
+    if (pos < b->len) pos++;
+    while (pos < b->len && is_cont(b->data[pos])) pos++;
+    return pos;
+}
+
+static size_t prev_char(const ByteBuf *b, size_t pos) {
+    if (pos > 0) pos--;
+    while (pos > 0 && is_cont(b->data[pos])) pos--;
+    return pos;
+}
+
+static void reverse_bytes(char *s, size_t n) {
+    for (size_t i = 0; i < n / 2; i++) {
+        char c = s[i];
+        s[i] = s[n - 1 - i];
+        s[n - 1 - i] = c;
+    }
+}
+
+static size_t count_columns(const char *s, size_t n) {
+    size_t cols = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!is_cont(s[i])) cols++;
+    }
+    return cols;
+}
+
+static int is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || is_cont(c) || ((unsigned char)c & 0x80);
+}
+
+static size_t word_left(const ByteBuf *b, size_t pos) {
+    while (pos > 0 && !is_word_char(b->data[pos - 1])) pos--;
+    while (pos > 0 && is_word_char(b->data[pos - 1])) pos--;
+    return pos;
+}
+
+static size_t word_right(const ByteBuf *b, size_t pos) {
+    while (pos < b->len && !is_word_char(b->data[pos])) pos++;
+    while (pos < b->len && is_word_char(b->data[pos])) pos++;
+    return pos;
+}
+
+static size_t bigword_left(const ByteBuf *b, size_t pos) {
+    while (pos > 0 && isspace((unsigned char)b->data[pos - 1])) pos--;
+    while (pos > 0 && !isspace((unsigned char)b->data[pos - 1])) pos--;
+    return pos;
+}
+
+/**
+ * Count the columns of the last prompt line, skipping ANSI escapes
+ */
+static int prompt_columns(const char *prompt) {
+    const char *line = strrchr(prompt, '\n');
+    int cols = 0;
+
+    line = line ? line + 1 : prompt;
+    while (*line) {
+        if (*line == '\x1b') {
+            /* Skip CSI sequence up to its final byte */
+            line++;
+            if (*line == '[') line++;
+            while (*line && !isalpha((unsigned char)*line)) line++;
+            if (*line) line++;
+            continue;
+        }
+        if (!is_cont(*line)) cols++;
+        line++;
+    }
+    return cols;
+}
+
+static int terminal_columns(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        return ws.ws_col;
+    }
+    return 80;
+}
+
+/**
+ * Write the whole screen buffer with as few write() calls as possible
+ */
+static void screen_flush(void) {
+    size_t done = 0;
+    while (done < g_screen.len) {
+        ssize_t n = write(STDOUT_FILENO, g_screen.data + done, g_screen.len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        done += (size_t)n;
+    }
+    g_screen.len = 0;
+}
+
+static void screen_add(const char *s, size_t n) {
+    if (buf_reserve(&g_screen, n) == 0) {
+        memcpy(g_screen.data + g_screen.len, s, n);
+        g_screen.len += n;
+    }
+}
+
+static void screen_move(long delta) {
+    char seq[32];
+    int n;
+
+    if (delta == 0) return;
+    n = snprintf(seq, sizeof(seq), "\x1b[%ld%c", delta > 0 ? delta : -delta,
+                 delta > 0 ? 'C' : 'D');
+    screen_add(seq, (size_t)n);
+}
+
+/**
+ * Redraw only the cells that differ from what is already on screen
+ */
+static void refresh_line(LineEditor *ed) {
+    size_t width = ed->cols > ed->prompt_width + 1
+                   ? (size_t)(ed->cols - ed->prompt_width - 1) : 1;
+    const ByteBuf *line = &ed->line;
+
+    /* Scroll horizontally so the cursor stays visible */
+    if (ed->pos < ed->scroll) {
+        ed->scroll = ed->pos;
+    }
+    size_t before = count_columns(line->data + ed->scroll, ed->pos - ed->scroll);
+    while (before > width) {
+        ed->scroll = next_char(line, ed->scroll);
+        before--;
+    }
+
+    /* Visible slice of the line */
+    size_t end = ed->scroll;
+    size_t cols = 0;
+    while (end < line->len && cols < width) {
+        end = next_char(line, end);
+        cols++;
+    }
+    const char *vis = line->data + ed->scroll;
+    size_t vis_len = end - ed->scroll;
+
+    /* First column that changed */
+    size_t common = 0;
+    size_t limit = vis_len < ed->shown.len ? vis_len : ed->shown.len;
+    while (common < limit && vis[common] == ed->shown.data[common]) common++;
+    while (common > 0 && is_cont(vis[common])) common--;
+
+    size_t common_cols = count_columns(vis, common);
+    size_t vis_cols = count_columns(vis, vis_len);
+    size_t shown_cols = count_columns(ed->shown.data, ed->shown.len);
+    size_t cursor_cols = count_columns(vis, ed->pos - ed->scroll);
+
+    if (common < vis_len || common < ed->shown.len) {
+        screen_move((long)common_cols - (long)ed->shown_cursor);
+        screen_add(vis + common, vis_len - common);
+        if (vis_cols < shown_cols) {
+            screen_add("\x1b[K", 3);
+        }
+        screen_move((long)cursor_cols - (long)vis_cols);
+        buf_set(&ed->shown, vis, vis_len);
+    } else {
+        screen_move((long)cursor_cols - (long)ed->shown_cursor);
+    }
+    ed->shown_cursor = cursor_cols;
+
+    screen_flush();
+}
+
+/**
+ * Redraw prompt and line from scratch (after clear screen or a listing)
+ */
+static void redraw_all(LineEditor *ed) {
+    screen_add(ed->prompt, strlen(ed->prompt));
+    ed->shown.len = 0;
+    ed->shown_cursor = 0;
+    refresh_line(ed);
+}
+
+/**
+ * Rebuild the prompt after async segments arrived; redraw if it changed
+ */
+static void refresh_prompt(LineEditor *ed) {
+    char prompt[MAX_PROMPT_SIZE];
+    char seq[32];
+    int lines = 0;
+
+    prompt_consume_update();
+    build_prompt(prompt, sizeof(prompt));
+    if (strcmp(prompt, ed->prompt) == 0) {
+        return;
+    }
+
+    /* Go back to the first prompt line and clear everything below */
+    for (const char *p = ed->prompt; *p; p++) {
+        if (*p == '\n') lines++;
+    }
+    screen_add("\r", 1);
+    if (lines > 0) {
+        int n = snprintf(seq, sizeof(seq), "\x1b[%dA", lines);
+        screen_add(seq, (size_t)n);
+    }
+    screen_add("\x1b[J", 3);
+
+    memcpy(ed->prompt, prompt, sizeof(prompt));
+    ed->prompt_width = prompt_columns(ed->prompt);
+    redraw_all(ed);
+}
+
+static int enable_raw_mode(void) {
+    struct termios raw;
+
+    if (tcgetattr(STDIN_FILENO, &g_orig_termios) != 0) {
+        return -1;
+    }
+
+    raw = g_orig_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    return tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+}
+
+static void disable_raw_mode(void) {
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &g_orig_termios);
+}
+
+/**
+ * Read more input bytes; waits briefly when only a partial escape is pending
+ * Job events (signals, zygote notices) are handled while waiting
+ * Returns 2 when an async prompt segment arrived instead of input
+ */
+static int fill_input(int timeout_ms, int watch_prompt) {
+    struct pollfd pfd[4];
+    int job_fds[2];
+    nfds_t nfds = 1;
+    int prompt_slot = -1;
+    ssize_t n;
+
+    if (g_inlen >= sizeof(g_inbuf)) {
+        return 0;
+    }
+
+    pfd[0].fd = STDIN_FILENO;
+    pfd[0].events = POLLIN;
+    if (watch_prompt && prompt_update_fd() >= 0) {
+        prompt_slot = (int)nfds;
+        pfd[nfds].fd = prompt_update_fd();
+        pfd[nfds].events = POLLIN;
+        pfd[nfds].revents = 0;
+        nfds++;
+    }
+    for (int i = 0, count = jobs_event_fds(job_fds); i < count; i++) {
+        pfd[nfds].fd = job_fds[i];
+        pfd[nfds].events = POLLIN;
+        pfd[nfds].revents = 0;
+        nfds++;
+    }
+
+    while (1) {
+        int ready = poll(pfd, nfds, timeout_ms);
+
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) {
+            return 0;
+        }
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            break;
+        }
+        if (prompt_slot >= 0 && pfd[prompt_slot].revents) {
+            return 2;
+        }
+        /* Only job events: collect them and keep waiting */
+        jobs_update();
+    }
+
+    do {
+        n = read(STDIN_FILENO, g_inbuf + g_inlen, sizeof(g_inbuf) - g_inlen);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        return -1;
+    }
+    g_inlen += (size_t)n;
+    return 1;
+}
+
+static void consume_input(size_t n) {
+    memmove(g_inbuf, g_inbuf + n, g_inlen - n);
+    g_inlen -= n;
+}
+
+/**
+ * Decode an escape sequence at the start of the input buffer
+ * Returns bytes used, 0 if more input is needed
+ */
+static size_t decode_escape(int *key) {
+    const unsigned char *s = g_inbuf;
+
+    if (g_inlen < 2) return 0;
+
+    /* Alt-<key> */
+    if (s[1] != '[' && s[1] != 'O') {
+        switch (s[1]) {
+            case 'b': *key = KEY_WORD_LEFT; break;
+            case 'f': *key = KEY_WORD_RIGHT; break;
+            case 'd': *key = KEY_KILL_WORD_RIGHT; break;
+            case 127:
+            case 8: *key = KEY_KILL_WORD_LEFT; break;
+            default: *key = KEY_NONE; break;
+        }
+        return 2;
+    }
+
+    if (g_inlen < 3) return 0;
+
+    if (s[1] == 'O') {
+        switch (s[2]) {
+            case 'A': *key = KEY_UP; break;
+            case 'B': *key = KEY_DOWN; break;
+            case 'C': *key = KEY_RIGHT; break;
+            case 'D': *key = KEY_LEFT; break;
+            case 'H': *key = KEY_HOME; break;
+            case 'F': *key = KEY_END; break;
+            default: *key = KEY_NONE; break;
+        }
+        return 3;
+    }
+
+    /* CSI: parameters then a final byte in 0x40..0x7e */
+    size_t i = 2;
+    while (i < g_inlen && (s[i] < 0x40 || s[i] > 0x7e)) i++;
+    if (i >= g_inlen) return 0;
+
+    int p1 = atoi((const char*)s + 2);
+    const char *semi = memchr(s + 2, ';', i - 2);
+    int mod = semi ? atoi(semi + 1) : 1;
+    int ctrl_or_alt = (mod == 3 || mod == 5);
+
+    switch (s[i]) {
+        case 'A': *key = KEY_UP; break;
+        case 'B': *key = KEY_DOWN; break;
+        case 'C': *key = ctrl_or_alt ? KEY_WORD_RIGHT : KEY_RIGHT; break;
+        case 'D': *key = ctrl_or_alt ? KEY_WORD_LEFT : KEY_LEFT; break;
+        case 'H': *key = KEY_HOME; break;
+        case 'F': *key = KEY_END; break;
+        case '~':
+            switch (p1) {
+                case 1: case 7: *key = KEY_HOME; break;
+                case 4: case 8: *key = KEY_END; break;
+                case 3: *key = KEY_DELETE; break;
+                case 200: *key = KEY_PASTE_START; break;
+                case 201: *key = KEY_PASTE_END; break;
+                default: *key = KEY_NONE; break;
+            }
+            break;
+        default: *key = KEY_NONE; break;
+    }
+    return i + 1;
+}
+
+/**
+ * Decode the next key from the input buffer
+ * Literal text is returned as one KEY_INSERT run so pastes stay cheap
+ */
+static size_t decode_key(const LineEditor *ed, int *key, size_t *run) {
+    unsigned char c = g_inbuf[0];
+
+    if (c == '\x1b') {
+        return decode_escape(key);
+    }
+
+    if (ed->pasting || c >= 32 || c == '\t') {
+        size_t n = 0;
+        while (n < g_inlen && g_inbuf[n] != '\x1b' &&
+               (ed->pasting || g_inbuf[n] >= 32) && g_inbuf[n] != 127) {
+            n++;
+        }
+        if (n > 0) {
+            *key = KEY_INSERT;
+            *run = n;
+            return n;
+        }
+    }
+
+    switch (c) {
+        case 1: *key = KEY_HOME; break;             /* Ctrl-A */
+        case 2: *key = KEY_LEFT; break;             /* Ctrl-B */
+        case 3: *key = KEY_INTERRUPT; break;        /* Ctrl-C */
+        case 4: *key = KEY_EOF; break;              /* Ctrl-D */
+        case 5: *key = KEY_END; break;              /* Ctrl-E */
+        case 6: *key = KEY_RIGHT; break;            /* Ctrl-F */
+        case 8:
+        case 127: *key = KEY_BACKSPACE; break;
+        case '\t': *key = KEY_TAB; break;
+        case 11: *key = KEY_KILL_EOL; break;        /* Ctrl-K */
+        case 12: *key = KEY_CLEAR_SCREEN; break;    /* Ctrl-L */
+        case '\r':
+        case '\n': *key = KEY_ENTER; break;
+        case 14: *key = KEY_DOWN; break;            /* Ctrl-N */
+        case 16: *key = KEY_UP; break;              /* Ctrl-P */
+        case 20: *key = KEY_TRANSPOSE; break;       /* Ctrl-T */
+        case 21: *key = KEY_KILL_BOL; break;        /* Ctrl-U */
+        case 23: *key = KEY_KILL_BIGWORD_LEFT; break; /* Ctrl-W */
+        case 25: *key = KEY_YANK; break;            /* Ctrl-Y */
+        default: *key = KEY_NONE; break;
+    }
+    return 1;
+}
+
+/**
+ * Remove text into the kill ring; consecutive kills accumulate
+ */
+static void kill_range(LineEditor *ed, size_t from, size_t to, int backward) {
+    if (from >= to) return;
+
+    if (!ed->last_was_kill) {
+        g_kill_ring.len = 0;
+    }
+    if (backward) {
+        buf_insert(&g_kill_ring, 0, ed->line.data + from, to - from);
+    } else {
+        buf_insert(&g_kill_ring, g_kill_ring.len, ed->line.data + from, to - from);
+    }
+
+    buf_erase(&ed->line, from, to);
+    ed->pos = from;
+}
+
+/**
+ * Load a history entry (or the saved in-progress line) into the editor
+ */
+static void history_move(LineEditor *ed, int delta) {
+    int count = g_history ? g_history->count : 0;
+    int index = ed->history_index + delta;
+    const char *text;
+
+    if (index < 0 || index > count) {
+        return;
+    }
+
+    if (ed->history_index == count) {
+        free(ed->saved_line);
+        ed->saved_line = strdup(ed->line.data ? ed->line.data : "");
+    }
+
+    ed->history_index = index;
+    text = (index == count) ? ed->saved_line : get_history_command(g_history, index);
+    if (!text) text = "";
+
+    buf_set(&ed->line, text, strlen(text));
+    ed->pos = ed->line.len;
+}
+
+/**
+ * Print completion candidates in columns below the line, then redraw
+ */
+static void list_completions(LineEditor *ed, const CompletionList *list) {
+    char msg[64];
+    size_t widest = 0;
+    int per_row;
+
+    screen_move((long)count_columns(ed->shown.data, ed->shown.len) - (long)ed->shown_cursor);
+    screen_add("\r\n", 2);
+
+    if (list->count > MAX_LISTED_COMPLETIONS) {
+        int n = snprintf(msg, sizeof(msg), "(%d possibilities)\r\n", list->count);
+        screen_add(msg, (size_t)n);
+        redraw_all(ed);
+        return;
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        size_t w = count_columns(list->items[i], strlen(list->items[i]));
+        if (w > widest) widest = w;
+    }
+    widest += 2;
+    per_row = (int)((size_t)ed->cols / widest);
+    if (per_row < 1) per_row = 1;
+
+    for (int i = 0; i < list->count; i++) {
+        const char *item = list->items[i];
+        size_t len = strlen(item);
+
+        /* Trailing space is an insertion hint, not part of the name */
+        if (len > 0 && item[len - 1] == ' ') len--;
+        screen_add(item, len);
+
+        if ((i + 1) % per_row == 0 || i == list->count - 1) {
+            screen_add("\r\n", 2);
+        } else {
+            for (size_t pad = count_columns(item, len); pad < widest; pad++) {
+                screen_add(" ", 1);
+            }
+        }
+    }
+    redraw_all(ed);
+}
+
+/**
+ * Complete the word under the cursor
+ * A unique match is inserted, otherwise the common prefix; a second Tab lists
+ */
+static void complete_line(LineEditor *ed, int repeated) {
+    CompletionList list;
+    size_t start;
+    size_t common;
+
+    if (complete_word(ed->line.data, ed->pos, &start, &list) == 0) {
+        screen_add("\a", 1);
+        free_completions(&list);
+        return;
+    }
+
+    /* Longest common prefix of all candidates */
+    common = strlen(list.items[0]);
+    for (int i = 1; i < list.count; i++) {
+        size_t j = 0;
+        while (j < common && list.items[i][j] == list.items[0][j]) j++;
+        common = j;
+    }
+    while (common > 0 && is_cont(list.items[0][common])) common--;
+
+    if (common > ed->pos - start) {
+        buf_erase(&ed->line, start, ed->pos);
+        buf_insert(&ed->line, start, list.items[0], common);
+        ed->pos = start + common;
+    } else if (list.count > 1) {
+        if (repeated) {
+            list_completions(ed, &list);
+        } else {
+            screen_add("\a", 1);
+        }
+    }
+
+    free_completions(&list);
+}
+
+/**
+ * Apply one decoded key; returns 1 when the line is finished
+ */
+static int handle_key(LineEditor *ed, int key, const unsigned char *text, size_t run) {
+    int was_kill = ed->last_was_kill;
+    int was_tab = ed->last_was_tab;
+    size_t p;
+
+    ed->last_was_kill = 0;
+    ed->last_was_tab = 0;
+
+    switch (key) {
+        case KEY_INSERT: {
+            /* Pasted newlines and tabs become plain spaces */
+            size_t start = ed->pos;
+            buf_insert(&ed->line, ed->pos, (const char*)text, run);
+            for (size_t i = start; i < start + run; i++) {
+                if (ed->line.data[i] == '\n' || ed->line.data[i] == '\r' ||
+                    ed->line.data[i] == '\t') {
+                    ed->line.data[i] = ' ';
+                }
+            }
+            ed->pos += run;
+            break;
+        }
+        case KEY_TAB:
+            complete_line(ed, was_tab);
+            ed->last_was_tab = 1;
+            break;
+        case KEY_BACKSPACE:
+            if (ed->pos > 0) {
+                p = prev_char(&ed->line, ed->pos);
+                buf_erase(&ed->line, p, ed->pos);
+                ed->pos = p;
+            }
+            break;
+        case KEY_DELETE:
+            if (ed->pos < ed->line.len) {
+                buf_erase(&ed->line, ed->pos, next_char(&ed->line, ed->pos));
+            }
+            break;
+        case KEY_LEFT:
+            ed->pos = prev_char(&ed->line, ed->pos);
+            break;
+        case KEY_RIGHT:
+            ed->pos = next_char(&ed->line, ed->pos);
+            break;
+        case KEY_HOME:
+            ed->pos = 0;
+            break;
+        case KEY_END:
+            ed->pos = ed->line.len;
+            break;
+        case KEY_WORD_LEFT:
+            ed->pos = word_left(&ed->line, ed->pos);
+            break;
+        case KEY_WORD_RIGHT:
+            ed->pos = word_right(&ed->line, ed->pos);
+            break;
+        case KEY_UP:
+            history_move(ed, -1);
+            break;
+        case KEY_DOWN:
+            history_move(ed, 1);
+            break;
+        case KEY_KILL_WORD_LEFT:
+            ed->last_was_kill = was_kill;
+            kill_range(ed, word_left(&ed->line, ed->pos), ed->pos, 1);
+            ed->last_was_kill = 1;
+            break;
+        case KEY_KILL_BIGWORD_LEFT:
+            ed->last_was_kill = was_kill;
+            kill_range(ed, bigword_left(&ed->line, ed->pos), ed->pos, 1);
+            ed->last_was_kill = 1;
+            break;
+        case KEY_KILL_WORD_RIGHT:
+            ed->last_was_kill = was_kill;
+            kill_range(ed, ed->pos, word_right(&ed->line, ed->pos), 0);
+            ed->last_was_kill = 1;
+            break;
+        case KEY_KILL_EOL:
+            ed->last_was_kill = was_kill;
+            kill_range(ed, ed->pos, ed->line.len, 0);
+            ed->last_was_kill = 1;
+            break;
+        case KEY_KILL_BOL:
+            ed->last_was_kill = was_kill;
+            kill_range(ed, 0, ed->pos, 1);
+            ed->last_was_kill = 1;
+            break;
+        case KEY_YANK:
+            if (g_kill_ring.len > 0) {
+                buf_insert(&ed->line, ed->pos, g_kill_ring.data, g_kill_ring.len);
+                ed->pos += g_kill_ring.len;
+            }
+            break;
+        case KEY_TRANSPOSE:
+            if (ed->pos > 0) {
+                /* Swap whole characters: the one under the cursor (the last
+                   at the end of the line) and the one before it */
+                size_t mid = ed->pos == ed->line.len ? prev_char(&ed->line, ed->pos) : ed->pos;
+                size_t start = prev_char(&ed->line, mid);
+                size_t end = next_char(&ed->line, mid);
+
+                if (start < mid) {
+                    reverse_bytes(ed->line.data + start, mid - start);
+                    reverse_bytes(ed->line.data + mid, end - mid);
+                    reverse_bytes(ed->line.data + start, end - start);
+                    ed->pos = end;
+                }
+            }
+            break;
+        case KEY_CLEAR_SCREEN:
+            screen_add("\x1b[H\x1b[2J", 7);
+            redraw_all(ed);
+            break;
+        case KEY_PASTE_START:
+            ed->pasting = 1;
+            break;
+        case KEY_PASTE_END:
+            ed->pasting = 0;
+            break;
+        case KEY_ENTER:
+            return 1;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/**
+ * Read a line from a non-interactive stream (no length limit)
+ */
+static char* read_plain_line(const char *prompt) {
+    ByteBuf b = {NULL, 0, 0};
+    char chunk[MAX_INPUT_SIZE];
+
+    fputs(prompt, stdout);
+    fflush(stdout);
+
+    while (fgets(chunk, sizeof(chunk), stdin)) {
+        size_t n = strlen(chunk);
+        if (buf_insert(&b, b.len, chunk, n) != 0) {
+            break;
+        }
+        if (n > 0 && chunk[n - 1] == '\n') {
+            b.data[--b.len] = '\0';
+            return b.data;
+        }
+    }
+
+    if (b.len > 0) {
+        return b.data;
+    }
+    buf_free(&b);
+    return NULL;
+}
+
+/**
+ * Read a command line with interactive editing
+ * Returns a malloc'd line, "" when the line was cancelled, NULL on EOF
+ */
+char* read_command_line(const char *prompt) {
+    LineEditor ed;
+    const char *term = getenv("TERM");
+    char *result = NULL;
+    int done = 0;
+
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) ||
+        (term && strcmp(term, "dumb") == 0)) {
+        return read_plain_line(prompt);
+    }
+
+    fflush(stdout);
+    if (enable_raw_mode() != 0) {
+        return read_plain_line(prompt);
+    }
+
+    memset(&ed, 0, sizeof(ed));
+    snprintf(ed.prompt, sizeof(ed.prompt), "%s", prompt);
+    ed.prompt_width = prompt_columns(prompt);
+    ed.cols = terminal_columns();
+    ed.history_index = g_history ? g_history->count : 0;
+    buf_reserve(&ed.line, 0);
+    buf_reserve(&ed.shown, 0);
+    ed.line.data[0] = '\0';
+
+    /* Bracketed paste keeps pasted text from triggering key bindings */
+    screen_add("\x1b[?2004h", 8);
+    redraw_all(&ed);
+
+    while (!done) {
+        if (g_inlen == 0) {
+            int rc = fill_input(-1, 1);
+            if (rc < 0) {
+                break;
+            }
+            if (rc == 2) {
+                refresh_prompt(&ed);
+                continue;
+            }
+        }
+
+        /* Apply every complete key already buffered, then redraw once */
+        while (g_inlen > 0 && !done) {
+            int key = KEY_NONE;
+            size_t run = 0;
+            size_t used = decode_key(&ed, &key, &run);
+
+            if (used == 0) {
+                /* Partial escape sequence: wait a little for the rest */
+                if (fill_input(50, 0) <= 0) {
+                    key = KEY_NONE;
+                    used = 1;
+                } else {
+                    continue;
+                }
+            }
+
+            if (key == KEY_INTERRUPT) {
+                consume_input(used);
+                ed.pos = ed.line.len;
+                refresh_line(&ed);
+                screen_add("^C\r\n", 4);
+                result = strdup("");
+                done = 1;
+                break;
+            }
+            if (key == KEY_EOF && ed.line.len == 0) {
+                consume_input(used);
+                done = 1;
+                break;
+            }
+            if (key == KEY_EOF) {
+                key = KEY_DELETE;
+            }
+
+            if (handle_key(&ed, key, g_inbuf, run)) {
+                consume_input(used);
+                ed.pos = ed.line.len;
+                refresh_line(&ed);
+                screen_add("\r\n", 2);
+                result = strdup(ed.line.data);
+                done = 1;
+                break;
+            }
+            consume_input(used);
+        }
+
+        if (!done) {
+            refresh_line(&ed);
+        }
+    }
+
+    screen_add("\x1b[?2004l", 8);
+    screen_flush();
+    disable_raw_mode();
+
+    buf_free(&ed.line);
+    buf_free(&ed.shown);
+    free(ed.saved_line);
+
+    return result;
+}
+
+#else
+
+/**
+ * Read a command line (Windows console handles editing itself)
+ */
+char* read_command_line(const char *prompt) {
+    char input[MAX_INPUT_SIZE];
+
+    fputs(prompt, stdout);
+    fflush(stdout);
+
+    if (!fgets(input, sizeof(input), stdin)) {
+        return NULL;
+    }
+    input[strcspn(input, "\n")] = 0;
+    return strdup(input);
+}
+
+#endif
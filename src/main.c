@@ -3,6 +3,7 @@
 /* Global variables */
 History *g_history = NULL;
 int g_last_exit_status = 0;
+char *g_cwd = NULL;
 #ifdef _WIN32
 volatile int g_interrupted = 0;
 #else
@@ -10,8 +11,25 @@ volatile sig_atomic_t g_interrupted = 0;
 #endif
 
 int main(int argc, char **argv) {
-    char input[MAX_INPUT_SIZE];
-    Command *cmd = NULL;
+    char prompt[MAX_PROMPT_SIZE];
+    char *input = NULL;
+    int exit_requested = 0;
+    double started;
+
+    /* Keep descriptors 3-9 for redirections before anything else opens one */
+    redirect_init();
+
+    /* Command server mode: no banner, no terminal */
+    if (argc == 3 && strcmp(argv[1], "--server") == 0) {
+        return run_server(argv[2]);
+    }
+
+    /* Spawn zygote: fork it now, while the shell is still small */
+    if ((argc == 2 && strcmp(argv[1], "--zygote") == 0) || getenv("MINISHELL_ZYGOTE")) {
+        if (zygote_start() != 0) {
+            print_error("Failed to start spawn zygote");
+        }
+    }
 
     /* Initialize shell */
     printf("%s", COLOR_CYAN);
@@ -29,34 +47,41 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    /* Setup signal handlers */
+    /* Setup signal handlers and take control of the terminal */
     setup_signal_handlers();
+    jobs_init();
+
+    /* Definitions and settings from ~/.minishellrc */
+    rc_load();
+
+    /* Cache the working directory and start async prompt segments */
+    prompt_init();
+
+    /* Index PATH executables for tab completion */
+    if (isatty(STDIN_FILENO)) {
+        completion_init();
+    }
 
     /* Main shell loop */
     while (1) {
-        /* Print prompt */
-        print_prompt();
+        /* Report background jobs that finished or stopped */
+        jobs_update();
+        jobs_report();
+
+        /* Build prompt */
+        build_prompt(prompt, sizeof(prompt));
 
         /* Reset interrupt flag */
         g_interrupted = 0;
 
-        /* Read input */
-        if (!fgets(input, MAX_INPUT_SIZE, stdin)) {
-            if (feof(stdin)) {
-                printf("\n");
-                break;
-            }
-            if (g_interrupted) {
-                printf("\n");
-                continue;
-            }
-            print_error("Error reading input");
-            continue;
+        /* Read input (line editor on a terminal, plain reads otherwise) */
+        free(input);
+        input = read_command_line(prompt);
+        if (!input) {
+            printf("\n");
+            break;
         }
 
-        /* Remove newline */
-        input[strcspn(input, "\n")] = 0;
-
         /* Skip empty lines */
         if (is_empty_line(input)) {
             continue;
@@ -65,37 +90,22 @@ int main(int argc, char **argv) {
         /* Add to history */
         add_to_history(g_history, input);
 
-        /* Parse command */
-        cmd = parse_command(input);
-        if (!cmd) {
-            print_error("Failed to parse command");
-            continue;
-        }
+        /* Parse and execute */
+        started = now_seconds();
+        g_last_exit_status = execute_line(input, &exit_requested);
+        prompt_command_finished(g_last_exit_status, now_seconds() - started);
 
-        /* Skip if no tokens */
-        if (cmd->token_count == 0) {
-            free_command(cmd);
-            continue;
-        }
-
-        /* Execute command */
-        if (is_builtin(cmd->tokens[0])) {
-            g_last_exit_status = execute_builtin(cmd);
-
-            /* Handle exit command */
-            if (strcmp(cmd->tokens[0], "exit") == 0) {
-                free_command(cmd);
-                break;
-            }
-        } else {
-            g_last_exit_status = execute_command(cmd);
+        if (exit_requested) {
+            break;
         }
-
-        /* Free command */
-        free_command(cmd);
     }
 
     /* Cleanup */
+    free(input);
+    jobs_cleanup();
+    completion_cleanup();
+    prompt_cleanup();
+    zygote_stop();
     free_history(g_history);
 
     printf("%s", COLOR_GREEN);
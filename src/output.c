@@ -0,0 +1,215 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <stdarg.h>
+
+#ifndef _WIN32
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#endif
+
+/*
+ * Shell-wide output writer for builtins.
+ * Small writes are copied into one large buffer; when a write does not fit,
+ * the buffered bytes and the new data go out together in a single writev()
+ * without copying. The buffer is flushed at command boundaries, before every
+ * fork and when it fills up.
+ */
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+static char g_out_buf[OUTPUT_BUFFER_SIZE];
+static size_t g_out_len = 0;
+static int g_out_fd = 1;
+
+#ifndef _WIN32
+
+/**
+ * Write two buffers completely, retrying short writes
+ */
+static int write_pair(const char *a, size_t alen, const char *b, size_t blen) {
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    if (alen > 0) {
+        iov[iovcnt].iov_base = (void*)a;
+        iov[iovcnt].iov_len = alen;
+        iovcnt++;
+    }
+    if (blen > 0) {
+        iov[iovcnt].iov_base = (void*)b;
+        iov[iovcnt].iov_len = blen;
+        iovcnt++;
+    }
+
+    struct iovec *v = iov;
+    while (iovcnt > 0) {
+        ssize_t n = writev(g_out_fd, v, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        /* Skip what was written, possibly in the middle of a vector */
+        while (iovcnt > 0 && (size_t)n >= v->iov_len) {
+            n -= (ssize_t)v->iov_len;
+            v++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            v->iov_base = (char*)v->iov_base + n;
+            v->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+#else
+
+static int write_pair(const char *a, size_t alen, const char *b, size_t blen) {
+    if (alen > 0 && _write(g_out_fd, a, (unsigned int)alen) < 0) {
+        return -1;
+    }
+    if (blen > 0 && _write(g_out_fd, b, (unsigned int)blen) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+#endif
+
+/**
+ * Queue bytes for output
+ */
+int out_write(const char *data, size_t len) {
+    if (g_out_len + len <= OUTPUT_BUFFER_SIZE) {
+        memcpy(g_out_buf + g_out_len, data, len);
+        g_out_len += len;
+        return 0;
+    }
+
+    /* Does not fit: send buffer and data together */
+    int rc = write_pair(g_out_buf, g_out_len, data, len);
+    g_out_len = 0;
+    return rc;
+}
+
+int out_puts(const char *str) {
+    return out_write(str, strlen(str));
+}
+
+/**
+ * Formatted output, rendered straight into the buffer when it fits
+ */
+int out_printf(const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(g_out_buf + g_out_len, OUTPUT_BUFFER_SIZE - g_out_len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        return -1;
+    }
+    if ((size_t)n < OUTPUT_BUFFER_SIZE - g_out_len) {
+        g_out_len += (size_t)n;
+        return 0;
+    }
+
+    /* Too long for the space left: format into a temporary */
+    char *tmp = (char*)malloc((size_t)n + 1);
+    if (!tmp) {
+        return -1;
+    }
+    va_start(ap, fmt);
+    vsnprintf(tmp, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+
+    int rc = out_write(tmp, (size_t)n);
+    free(tmp);
+    return rc;
+}
+
+/**
+ * Write out everything buffered so far
+ */
+int out_flush(void) {
+    int rc = 0;
+
+    if (g_out_len > 0) {
+        rc = write_pair(g_out_buf, g_out_len, NULL, 0);
+        g_out_len = 0;
+    }
+    return rc;
+}
+
+/**
+ * Point builtin output at another descriptor; returns the previous one
+ */
+int out_set_fd(int fd) {
+    int prev = g_out_fd;
+
+    out_flush();
+    g_out_fd = fd;
+    return prev;
+}
+
+/**
+ * Descriptor builtin output currently goes to
+ */
+int out_get_fd(void) {
+    return g_out_fd;
+}
+
+#ifndef _WIN32
+
+/**
+ * Copy len bytes of in_fd starting at offset to the output descriptor,
+ * zero-copy with sendfile() when the kernel supports this pair of files
+ */
+int out_sendfile(int in_fd, off_t offset, size_t len) {
+    char buf[8192];
+
+    out_flush();
+
+    while (len > 0) {
+        ssize_t n = sendfile(g_out_fd, in_fd, &offset, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS)) break;
+        if (n <= 0) return -1;
+        len -= (size_t)n;
+    }
+
+    /* sendfile() refused this output: plain copy */
+    while (len > 0) {
+        ssize_t n = pread(in_fd, buf, len < sizeof(buf) ? len : sizeof(buf), offset);
+        if (n <= 0) return -1;
+        if (write_pair(buf, (size_t)n, NULL, 0) != 0) return -1;
+        offset += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+#else
+
+int out_sendfile(int in_fd, off_t offset, size_t len) {
+    char buf[8192];
+
+    out_flush();
+    if (_lseek(in_fd, offset, SEEK_SET) < 0) {
+        return -1;
+    }
+
+    while (len > 0) {
+        int n = _read(in_fd, buf, (unsigned int)(len < sizeof(buf) ? len : sizeof(buf)));
+        if (n <= 0) return -1;
+        if (write_pair(buf, (size_t)n, NULL, 0) != 0) return -1;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+#endif
@@ -1,16 +1,55 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
 #include "../include/shell.h"
+#include <ctype.h>
+
+/* Aliases expanded in a row at most */
+#define ALIAS_DEPTH 16
+
+/**
+ * Find the next word of a line; blanks inside ${...} and $(...) do not end it
+ * Terminates the word, advances *cursor past it and returns it, or NULL
+ */
+static char* next_word(char **cursor) {
+    char *p = *cursor;
+    char *word;
+    int depth = 0;
+
+    while (*p == ' ' || *p == '\t' || *p == '\n') p++;
+    if (*p == '\0') {
+        *cursor = p;
+        return NULL;
+    }
+
+    word = p;
+    for (; *p && (depth > 0 || (*p != ' ' && *p != '\t' && *p != '\n')); p++) {
+        if (p[0] == '$' && (p[1] == '{' || p[1] == '(')) {
+            depth++;
+            p++;
+        } else if (*p == '(' && depth > 0) {
+            depth++;
+        } else if ((*p == '}' || *p == ')') && depth > 0) {
+            depth--;
+        }
+    }
+    if (*p) {
+        *p++ = '\0';
+    }
+    *cursor = p;
+    return word;
+}
 
 /**
  * Tokenize input string into array of tokens
  */
 int tokenize(char *input, char **tokens) {
     int count = 0;
+    char *cursor = input;
     char *token;
 
-    #ifdef _WIN32
-    /* Windows: use strtok */
-    token = strtok(input, " \t\n");
-    while (token != NULL && count < MAX_NUM_TOKENS) {
+    while ((token = next_word(&cursor)) != NULL && count < MAX_NUM_TOKENS) {
         tokens[count] = strdup(token);
         if (!tokens[count]) {
             /* Free previously allocated tokens on error */
@@ -20,38 +59,174 @@ int tokenize(char *input, char **tokens) {
             return -1;
         }
         count++;
-        token = strtok(NULL, " \t\n");
     }
-    #else
-    /* POSIX: use strtok_r (thread-safe) */
-    char *saveptr;
-    token = strtok_r(input, " \t\n", &saveptr);
-    while (token != NULL && count < MAX_NUM_TOKENS) {
-        tokens[count] = strdup(token);
-        if (!tokens[count]) {
-            /* Free previously allocated tokens on error */
-            for (int i = 0; i < count; i++) {
-                free(tokens[i]);
-            }
+
+    return count;
+}
+
+/**
+ * Copy of a file name token with its variables expanded
+ */
+static char* expand_copy(const char *token) {
+    char *expanded = expand_word(token);
+    return strdup(expanded ? expanded : token);
+}
+
+/**
+ * Add an output target: the first becomes output_file, the others get a copy
+ */
+static void add_output(Command *cmd, const char *word, int append) {
+    if (!cmd->output_file) {
+        cmd->output_file = expand_copy(word);
+        cmd->append_output = append;
+    } else if (cmd->tee_count < MAX_TEE_FILES) {
+        cmd->tee_files[cmd->tee_count] = expand_copy(word);
+        cmd->tee_append[cmd->tee_count] = append;
+        cmd->tee_count++;
+    }
+}
+
+/**
+ * Record the redirection at all[*i], if it is one; see redirect.c
+ * Its target may follow in the same word (2>err) or be the next one
+ * Returns 1 for a redirection, 0 for another word, -1 on a syntax error
+ */
+static int parse_redirect(Command *cmd, char **all, int count, int *i) {
+    const char *p = all[*i];
+    const char *target;
+    int fd = -1;
+    int both = 0;
+    int type;
+
+    if (isdigit((unsigned char)p[0]) && (p[1] == '<' || p[1] == '>')) {
+        fd = *p++ - '0';
+    } else if (p[0] == '&' && p[1] == '>') {
+        both = 1;
+        p++;
+    }
+
+    if (strncmp(p, ">>", 2) == 0) {
+        type = REDIR_APPEND;
+        p += 2;
+    } else if (strncmp(p, "<>", 2) == 0) {
+        type = REDIR_RDWR;
+        p += 2;
+    } else if (!both && (strncmp(p, ">&", 2) == 0 || strncmp(p, "<&", 2) == 0)) {
+        type = REDIR_DUP;
+        if (fd < 0) fd = p[0] == '<' ? STDIN_FILENO : STDOUT_FILENO;
+        p += 2;
+    } else if (*p == '>' || *p == '<') {
+        type = *p == '>' ? REDIR_WRITE : REDIR_READ;
+        p++;
+    } else {
+        return 0;
+    }
+    if (fd < 0) {
+        fd = type == REDIR_READ || type == REDIR_RDWR ? STDIN_FILENO : STDOUT_FILENO;
+    }
+
+    if (*p) {
+        target = p;
+    } else if (*i + 1 < count) {
+        target = all[++*i];
+    } else {
+        print_error("Syntax error: redirection without a target");
+        return -1;
+    }
+
+    /* Plain < and > keep their own fields */
+    if (fd == STDOUT_FILENO && (type == REDIR_WRITE || type == REDIR_APPEND)) {
+        add_output(cmd, target, type == REDIR_APPEND);
+        if (!both) {
+            return 1;
+        }
+        fd = STDERR_FILENO;
+        type = REDIR_DUP;
+        target = "1";
+    } else if (fd == STDIN_FILENO && type == REDIR_READ) {
+        free(cmd->input_file);
+        cmd->input_file = expand_copy(target);
+        return 1;
+    }
+
+    if (cmd->redirect_count == MAX_REDIRECTS) {
+        print_error("Too many redirections");
+        return -1;
+    }
+    Redirect *r = &cmd->redirects[cmd->redirect_count];
+    r->fd = fd;
+    r->type = type;
+    r->source = -1;
+    r->file = NULL;
+
+    if (type == REDIR_DUP) {
+        /* >&${NAME[1]} names a descriptor held in a variable */
+        if (target[0] == '$') {
+            const char *expanded = expand_word(target);
+            target = expanded ? expanded : target;
+        }
+        if (strcmp(target, "-") == 0) {
+            r->type = REDIR_CLOSE;
+        } else if (isdigit((unsigned char)target[0]) && target[1] == '\0') {
+            r->source = target[0] - '0';
+        } else {
+            print_error("Syntax error: expected a descriptor 0-9 or - after >& or <&");
             return -1;
         }
-        count++;
-        token = strtok_r(NULL, " \t\n", &saveptr);
+    } else if (!(r->file = expand_copy(target))) {
+        return -1;
     }
-    #endif
+    cmd->redirect_count++;
+    return 1;
+}
+
+/**
+ * Replace an alias in the first word by the words of its value; out has
+ * room for MAX_NUM_TOKENS words. A chain of aliases is followed, but none
+ * is used twice
+ */
+int expand_aliases(char **words, int count, char **out) {
+    const char *seen[ALIAS_DEPTH];
+    int depth = 0;
+
+    memcpy(out, words, (size_t)count * sizeof(char*));
+    while (count > 0 && depth < ALIAS_DEPTH) {
+        int alias_count;
+        char **alias = alias_words(out[0], &alias_count);
+        int used = 0;
+
+        for (int i = 0; i < depth; i++) {
+            used |= strcmp(seen[i], out[0]) == 0;
+        }
+        if (!alias || used || count - 1 + alias_count > MAX_NUM_TOKENS - 1) {
+            break;
+        }
 
+        seen[depth++] = out[0];
+        memmove(out + alias_count, out + 1, (size_t)(count - 1) * sizeof(char*));
+        memcpy(out, alias, (size_t)alias_count * sizeof(char*));
+        count += alias_count - 1;
+    }
     return count;
 }
 
 /**
- * Parse command string and create Command structure
+ * Create a Command from the words of a command line
+ * Aliases, variables and redirections are handled here; the words
+ * themselves are left to the caller, so a parsed line can run many times
  */
-Command* parse_command(char *input) {
+Command* build_command(char **words, int count) {
+    char *all[MAX_NUM_TOKENS];
+    char **args;
+    int arg_count;
     Command *cmd = (Command*)malloc(sizeof(Command));
     if (!cmd) {
         return NULL;
     }
 
+    /* Expansions of the previous command are no longer needed */
+    arena_reset();
+
     /* Initialize command structure */
     memset(cmd, 0, sizeof(Command));
     cmd->input_file = NULL;
@@ -60,68 +235,50 @@ Command* parse_command(char *input) {
     cmd->background = 0;
     cmd->pipe_count = 0;
 
-    /* Make a copy of input for processing */
-    char *input_copy = strdup(input);
-    if (!input_copy) {
-        free(cmd);
-        return NULL;
-    }
+    count = expand_aliases(words, count, all);
 
     /* Check for background process */
-    int len = strlen(input_copy);
-    if (len > 0 && input_copy[len - 1] == '&') {
-        cmd->background = 1;
-        input_copy[len - 1] = '\0';
-    }
-
-    /* Tokenize input */
-    char *tokens[MAX_NUM_TOKENS];
-    int token_count = tokenize(input_copy, tokens);
-
-    free(input_copy);
-
-    if (token_count < 0) {
-        free(cmd);
-        return NULL;
+    if (count > 0) {
+        size_t len = strlen(all[count - 1]);
+        if (len > 0 && all[count - 1][len - 1] == '&') {
+            cmd->background = 1;
+            if (len == 1) {
+                count--;
+            } else if (!(all[count - 1] = arena_copy(all[count - 1], len - 1))) {
+                free(cmd);
+                return NULL;
+            }
+        }
     }
 
     /* Parse tokens for redirection and pipes */
     int cmd_token_idx = 0;
-    for (int i = 0; i < token_count; i++) {
-        if (strcmp(tokens[i], ">") == 0) {
-            /* Output redirection */
-            if (i + 1 < token_count) {
-                cmd->output_file = strdup(tokens[i + 1]);
-                cmd->append_output = 0;
-                free(tokens[i]);
-                free(tokens[i + 1]);
-                i++;
-            }
-        } else if (strcmp(tokens[i], ">>") == 0) {
-            /* Append output redirection */
-            if (i + 1 < token_count) {
-                cmd->output_file = strdup(tokens[i + 1]);
-                cmd->append_output = 1;
-                free(tokens[i]);
-                free(tokens[i + 1]);
-                i++;
-            }
-        } else if (strcmp(tokens[i], "<") == 0) {
-            /* Input redirection */
-            if (i + 1 < token_count) {
-                cmd->input_file = strdup(tokens[i + 1]);
-                free(tokens[i]);
-                free(tokens[i + 1]);
-                i++;
-            }
-        } else if (strcmp(tokens[i], "|") == 0) {
+    for (int i = 0; i < count; i++) {
+        int redirect = parse_redirect(cmd, all, count, &i);
+
+        if (redirect < 0) {
+            cmd->token_count = cmd_token_idx;
+            free_command(cmd);
+            return NULL;
+        } else if (redirect > 0) {
+            /* Recorded in cmd */
+        } else if (strcmp(all[i], "|") == 0) {
             /* Pipe - for future implementation */
             cmd->pipe_count++;
-            free(tokens[i]);
+        } else if (strcmp(all[i], "$@") == 0 || strcmp(all[i], "${@}") == 0) {
+            /* One word per positional parameter */
+            arg_count = var_args(&args);
+            for (int j = 0; j < arg_count && cmd_token_idx < MAX_NUM_TOKENS - 1; j++) {
+                cmd->tokens[cmd_token_idx++] = strdup(args[j]);
+            }
         } else {
-            /* Regular command token */
-            if (cmd_token_idx < MAX_NUM_TOKENS) {
-                cmd->tokens[cmd_token_idx] = tokens[i];
+            /* Regular command token; one that expands to nothing is dropped */
+            char *expanded = expand_word(all[i]);
+            if (expanded && *expanded == '\0') {
+                continue;
+            }
+            if (cmd_token_idx < MAX_NUM_TOKENS - 1) {
+                cmd->tokens[cmd_token_idx] = strdup(expanded ? expanded : all[i]);
                 cmd_token_idx++;
             }
         }
@@ -133,6 +290,35 @@ Command* parse_command(char *input) {
     return cmd;
 }
 
+/**
+ * Parse command string and create Command structure
+ */
+Command* parse_command(char *input) {
+    char *tokens[MAX_NUM_TOKENS];
+    Command *cmd;
+
+    /* Make a copy of input for processing */
+    char *input_copy = strdup(input);
+    if (!input_copy) {
+        return NULL;
+    }
+
+    /* Tokenize input */
+    int token_count = tokenize(input_copy, tokens);
+
+    free(input_copy);
+
+    if (token_count < 0) {
+        return NULL;
+    }
+
+    cmd = build_command(tokens, token_count);
+    for (int i = 0; i < token_count; i++) {
+        free(tokens[i]);
+    }
+    return cmd;
+}
+
 /**
  * Free command structure
  */
@@ -153,6 +339,12 @@ void free_command(Command *cmd) {
     if (cmd->output_file) {
         free(cmd->output_file);
     }
+    for (int i = 0; i < cmd->tee_count; i++) {
+        free(cmd->tee_files[i]);
+    }
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        free(cmd->redirects[i].file);
+    }
 
     free(cmd);
 }
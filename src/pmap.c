@@ -0,0 +1,440 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/*
+ * Sharded parallel map
+ *
+ *   pmap -j N [--ordered] command [args] < file [> out]
+ *
+ * The input file is memory-mapped and cut at line boundaries into N chunks.
+ * Each chunk is fed to its own copy of the command through a pipe with
+ * vmsplice(), so the file's pages are handed to the pipe rather than copied.
+ * Each copy writes into a private memfd; a chunk's output is appended to the
+ * target as a whole once that copy exits. With --ordered, chunks are emitted
+ * in input order and the first chunk writes straight into the target.
+ * The copies share a process group, so Ctrl-C stops them as one job, and
+ * only their own pids are waited for.
+ */
+
+#define PMAP_MAX_JOBS 256
+#define PMAP_PIPE_SIZE (1024 * 1024)
+
+typedef struct {
+    const char *data;       /* unsent part of the chunk */
+    size_t left;
+    int in_fd;              /* write end of the command's stdin pipe */
+    int out_fd;             /* memfd holding the command's output */
+    pid_t pid;
+    int status;
+} PmapChunk;
+
+/**
+ * Start argv reading from in_fd and writing to out_fd (also used by xargs)
+ * With a group, an interactive shell runs all copies in one process group,
+ * the job Ctrl-C and Ctrl-Z act on; the first copy starts it
+ */
+pid_t spawn_argv(char **argv, int in_fd, int out_fd, ArgvGroup *group) {
+    SpawnAttr attr;
+    pid_t pgid = 0;
+    pid_t pid;
+
+    spawn_attr_current(&attr);
+    if (group && jobs_interactive()) {
+        pgid = group->pgid;
+        attr.new_pgrp = (uint8_t)(pgid == 0);
+        attr.foreground = (uint8_t)group->foreground;
+    }
+    pid = fork();
+
+    if (pid == 0) {
+        sigset_t none;
+
+        if (pgid > 0) {
+            setpgid(0, pgid);
+        }
+        dup2(in_fd, STDIN_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+
+        if (spawn_attr_apply(&attr) != 0) {
+            fprintf(stderr, "mini-shell: %s: failed to apply spawn attributes\n", argv[0]);
+        }
+
+        execvp(argv[0], argv);
+
+        fprintf(stderr, "%smini-shell: %s: command not found%s\n",
+                COLOR_RED, argv[0], COLOR_RESET);
+        _exit(EXIT_FAILURE);
+    }
+
+    if (pid > 0 && group) {
+        /* Also from this side, so the group exists before the next copy */
+        if (attr.new_pgrp) {
+            setpgid(pid, pid);
+            group->pgid = pid;
+            if (group->foreground) {
+                jobs_foreground(pid);
+            }
+        } else if (pgid > 0) {
+            setpgid(pid, pgid);
+        }
+        group->running++;
+    }
+    return pid;
+}
+
+/**
+ * A builtin cannot be suspended: Ctrl-Z on the group interrupts it like
+ * Ctrl-C. Only stops are collected here, exits stay for wait_argv()
+ */
+static void argv_interrupt_stopped(ArgvGroup *group, const pid_t *pids, int count) {
+    for (int j = 0; j < count; j++) {
+        siginfo_t info;
+
+        if (pids[j] <= 0) {
+            continue;
+        }
+        info.si_pid = 0;
+        if (waitid(P_PID, (id_t)pids[j], &info, WSTOPPED | WNOHANG) == 0 && info.si_pid > 0) {
+            pid_t target = group->pgid > 0 ? -group->pgid : pids[j];
+            g_interrupted = 1;
+            kill(target, SIGINT);
+            kill(target, SIGCONT);
+        }
+    }
+}
+
+/**
+ * Sleep until a signal arrives, or the fds in pfd are ready
+ * Background jobs of the shell are looked after on the way
+ */
+static int argv_poll(ArgvGroup *group, const pid_t *pids, int count, struct pollfd *pfd, int n) {
+    pfd[n].fd = signal_fd();
+    pfd[n].events = POLLIN;
+    pfd[n].revents = 0;
+    if (poll(pfd, (nfds_t)n + 1, pfd[n].fd >= 0 ? -1 : 10) < 0 && errno != EINTR) {
+        return -1;
+    }
+    if (pfd[n].revents) {
+        argv_interrupt_stopped(group, pids, count);
+        jobs_update();
+
+        /* Ctrl-C reached the shell instead of a group left behind */
+        if (g_interrupted && !group->foreground && group->pgid > 0) {
+            kill(-group->pgid, SIGINT);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Wait until one of pids exits, without taking the shell's other children
+ * Returns its index with the wait status stored, or -1 on error. The shell
+ * takes the terminal back once the last copy of the group is gone
+ */
+int wait_argv(ArgvGroup *group, const pid_t *pids, int count, int *status) {
+    while (1) {
+        struct pollfd pfd;
+        int live = 0;
+
+        argv_interrupt_stopped(group, pids, count);
+        for (int j = 0; j < count; j++) {
+            pid_t rc;
+
+            if (pids[j] <= 0) {
+                continue;
+            }
+            while ((rc = waitpid(pids[j], status, WNOHANG)) < 0 && errno == EINTR) {
+                continue;
+            }
+            if (rc == 0) {
+                live++;
+                continue;
+            }
+
+            /* Exited, or already collected elsewhere with its status lost */
+            if (rc < 0) {
+                *status = 0;
+            }
+            if (--group->running <= 0) {
+                group->running = 0;
+                if (group->pgid > 0 && group->foreground) {
+                    jobs_reclaim_terminal();
+                }
+                group->pgid = 0;
+            }
+            return j;
+        }
+        if (live == 0) {
+            errno = ECHILD;
+            return -1;
+        }
+        if (argv_poll(group, pids, count, &pfd, 0) != 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Push the next piece of a chunk into its pipe without blocking
+ * Returns 1 while data is left, 0 once the chunk is fully sent
+ */
+static int pmap_feed(PmapChunk *chunk) {
+    struct iovec iov;
+    ssize_t n;
+
+    iov.iov_base = (void*)chunk->data;
+    iov.iov_len = chunk->left;
+
+    n = vmsplice(chunk->in_fd, &iov, 1, SPLICE_F_NONBLOCK);
+    if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        /* Not a pipe we can splice into: copy instead */
+        n = write(chunk->in_fd, chunk->data, chunk->left);
+    }
+
+    if (n > 0) {
+        chunk->data += n;
+        chunk->left -= (size_t)n;
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        /* The command stopped reading (e.g. EPIPE from head) */
+        chunk->left = 0;
+    }
+    return chunk->left > 0;
+}
+
+/**
+ * Append a finished chunk's output to the target
+ */
+static void pmap_emit(PmapChunk *chunk) {
+    struct stat st;
+
+    if (chunk->out_fd < 0) {
+        return;
+    }
+    if (fstat(chunk->out_fd, &st) == 0 && st.st_size > 0) {
+        out_sendfile(chunk->out_fd, 0, (size_t)st.st_size);
+    }
+    close(chunk->out_fd);
+    chunk->out_fd = -1;
+}
+
+static int wait_status(int status) {
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * pmap -j N [--ordered] command [args] < file
+ */
+int builtin_pmap(Command *cmd) {
+    char **args = cmd->tokens;
+    PmapChunk chunks[PMAP_MAX_JOBS];
+    pid_t pids[PMAP_MAX_JOBS];
+    struct pollfd pfd[PMAP_MAX_JOBS + 1];
+    ArgvGroup group = {0, 1, 0};
+    struct sigaction ign, old_pipe;
+    struct stat st;
+    int jobs = 0;
+    int ordered = 0;
+    int count = 0;
+    int result = 0;
+    int fd;
+    int i = 1;
+
+    while (args[i] && args[i][0] == '-') {
+        if (strcmp(args[i], "-j") == 0 && args[i + 1]) {
+            jobs = atoi(args[i + 1]);
+            i += 2;
+        } else if (strcmp(args[i], "--ordered") == 0) {
+            ordered = 1;
+            i++;
+        } else {
+            break;
+        }
+    }
+
+    if (jobs < 1 || jobs > PMAP_MAX_JOBS || !args[i]) {
+        print_error("Usage: pmap -j N [--ordered] command [args] < file");
+        return -1;
+    }
+    if (!cmd->input_file) {
+        print_error("pmap: input must come from a file (< file)");
+        return -1;
+    }
+
+    char **argv = args + i;
+
+    fd = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        print_error("Failed to open input file");
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        print_error("pmap: input must be a regular file");
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t)st.st_size;
+    char *map = (char*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        print_error("pmap: failed to map input file");
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    /* A command that exits early must not kill the shell */
+    memset(&ign, 0, sizeof(ign));
+    ign.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ign, &old_pipe);
+
+    out_flush();
+    fflush(stdout);
+
+    /* Cut at line boundaries and start one copy per chunk */
+    size_t start = 0;
+    for (int j = 0; j < jobs && start < size; j++) {
+        size_t end = size;
+        if (j < jobs - 1) {
+            end = start + (size - start) / (size_t)(jobs - j);
+            const char *nl = end < size ? (const char*)memchr(map + end, '\n', size - end) : NULL;
+            end = nl ? (size_t)(nl - map) + 1 : size;
+        }
+
+        PmapChunk *c = &chunks[count];
+        int p[2];
+
+        c->data = map + start;
+        c->left = end - start;
+        c->status = 0;
+        c->out_fd = -1;
+        c->in_fd = -1;
+        start = end;
+
+        /* Nothing precedes the first chunk of an ordered run */
+        if (!ordered || count > 0) {
+            c->out_fd = memfd_create("pmap", MFD_CLOEXEC);
+            if (c->out_fd < 0) {
+                print_error("pmap: failed to create output buffer");
+                result = -1;
+                break;
+            }
+        }
+
+        if (pipe2(p, O_CLOEXEC) != 0) {
+            if (c->out_fd >= 0) close(c->out_fd);
+            print_error("Failed to create pipe");
+            result = -1;
+            break;
+        }
+        fcntl(p[1], F_SETPIPE_SZ, PMAP_PIPE_SIZE);
+        fcntl(p[1], F_SETFL, O_NONBLOCK);
+
+        c->pid = spawn_argv(argv, p[0], c->out_fd >= 0 ? c->out_fd : out_get_fd(), &group);
+        close(p[0]);
+        if (c->pid < 0) {
+            close(p[1]);
+            if (c->out_fd >= 0) close(c->out_fd);
+            print_error("Failed to fork process");
+            result = -1;
+            break;
+        }
+        c->in_fd = p[1];
+        pids[count++] = c->pid;
+    }
+
+    /* Feed every chunk until all are sent */
+    int feeding = result == 0 ? count : 0;
+    while (feeding > 0 && !g_interrupted) {
+        int n = 0;
+        for (int j = 0; j < count; j++) {
+            if (chunks[j].in_fd >= 0) {
+                pfd[n].fd = chunks[j].in_fd;
+                pfd[n].events = POLLOUT;
+                n++;
+            }
+        }
+
+        /* A stopped copy reads nothing; see to it between writes */
+        if (argv_poll(&group, pids, count, pfd, n) != 0) {
+            break;
+        }
+
+        for (int j = 0; j < count; j++) {
+            if (chunks[j].in_fd >= 0 && !pmap_feed(&chunks[j])) {
+                close(chunks[j].in_fd);
+                chunks[j].in_fd = -1;
+                feeding--;
+            }
+        }
+    }
+    for (int j = 0; j < count; j++) {
+        if (chunks[j].in_fd >= 0) {
+            close(chunks[j].in_fd);
+            chunks[j].in_fd = -1;
+        }
+    }
+
+    /* Collect outputs: input order, or whichever copy finishes first */
+    for (int done = 0; done < count; done++) {
+        int status;
+        int j;
+
+        if (ordered) {
+            if (wait_argv(&group, &pids[done], 1, &status) < 0) break;
+            j = done;
+        } else {
+            j = wait_argv(&group, pids, count, &status);
+            if (j < 0) break;
+        }
+        pids[j] = -1;
+
+        chunks[j].status = wait_status(status);
+        pmap_emit(&chunks[j]);
+    }
+
+    /* The first failing chunk decides the status */
+    for (int j = 0; j < count; j++) {
+        if (chunks[j].out_fd >= 0) close(chunks[j].out_fd);
+        if (result == 0 && chunks[j].status != 0) result = chunks[j].status;
+    }
+
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    munmap(map, size);
+    return result;
+}
+
+#else
+
+int builtin_pmap(Command *cmd) {
+    print_error("pmap is not supported on Windows");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,529 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <time.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * Prompt templates are plain text with {segment} placeholders:
+ *   {cwd} {user} {host} {time}      cheap, rendered inline
+ *   {status} {duration}             from the previous command
+ *   {git}                           expensive, computed by a worker thread
+ *   {red} {green} ... {reset}       colors
+ * Optional segments carry their own leading space and render empty when
+ * there is nothing to show.
+ */
+#define DEFAULT_PROMPT_TEMPLATE \
+    "{cyan}[{magenta}mini-shell{cyan}] {blue}{cwd}{yellow}{git}{magenta}{duration}{reset}\n" \
+    "{green}$ {reset}"
+
+#define GIT_SEGMENT_SIZE 128
+#define GIT_STATUS_BUDGET_MS 200
+#define DURATION_THRESHOLD 1.0
+
+/* Home-relative form of the cached working directory */
+static char *g_display_cwd = NULL;
+
+/* Previous command results */
+static int g_prompt_status = 0;
+static double g_prompt_duration = 0.0;
+
+/* Bumped after every command so async segments get recomputed */
+static unsigned int g_generation = 0;
+
+#ifndef _WIN32
+
+/* Shared state between the main thread and the segment worker */
+static pthread_t g_worker;
+static int g_worker_started = 0;
+static pthread_mutex_t g_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_async_cond = PTHREAD_COND_INITIALIZER;
+static int g_notify_pipe[2] = {-1, -1};
+
+static char *g_request_cwd = NULL;
+static unsigned int g_request_gen = 0;
+static int g_request_pending = 0;
+static int g_worker_stop = 0;
+
+static char *g_result_cwd = NULL;
+static unsigned int g_result_gen = 0;
+static char g_result_git[GIT_SEGMENT_SIZE] = "";
+
+#endif
+
+/**
+ * Monotonic clock in seconds
+ */
+double now_seconds(void) {
+    #ifdef _WIN32
+    return GetTickCount64() / 1000.0;
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+    #endif
+}
+
+/**
+ * Refresh the cached working directory (after startup and cd)
+ */
+void update_cwd_cache(void) {
+    char *cwd = getcwd(NULL, 0);
+    #ifdef _WIN32
+    char *home = getenv("USERPROFILE");
+    #else
+    char *home = getenv("HOME");
+    #endif
+
+    free(g_cwd);
+    free(g_display_cwd);
+    g_cwd = cwd;
+    g_display_cwd = NULL;
+
+    if (!cwd) {
+        g_display_cwd = strdup("???");
+        return;
+    }
+
+    /* Replace home directory with ~ */
+    size_t home_len = home ? strlen(home) : 0;
+    if (home_len > 0 && strncmp(cwd, home, home_len) == 0 &&
+        (cwd[home_len] == '\0' || cwd[home_len] == '/')) {
+        g_display_cwd = (char*)malloc(strlen(cwd) - home_len + 2);
+        if (g_display_cwd) {
+            sprintf(g_display_cwd, "~%s", cwd + home_len);
+        }
+    } else {
+        g_display_cwd = strdup(cwd);
+    }
+}
+
+/**
+ * Record the exit status and run time of the last command
+ */
+void prompt_command_finished(int status, double seconds) {
+    g_prompt_status = status;
+    g_prompt_duration = seconds;
+    g_generation++;
+}
+
+#ifndef _WIN32
+
+/**
+ * Locate the git directory for cwd by walking up the tree
+ */
+static int find_git_dir(const char *cwd, char *gitdir, size_t size) {
+    char dir[PATH_MAX];
+    struct stat st;
+
+    snprintf(dir, sizeof(dir), "%s", cwd);
+    while (1) {
+        if (snprintf(gitdir, size, "%s/.git", strcmp(dir, "/") == 0 ? "" : dir) >= (int)size) {
+            return -1;
+        }
+
+        if (stat(gitdir, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                return 0;
+            }
+
+            /* Worktrees and submodules: ".git" file with "gitdir: <path>" */
+            FILE *f = fopen(gitdir, "re");
+            char line[PATH_MAX];
+            if (f && fgets(line, sizeof(line), f) && strncmp(line, "gitdir: ", 8) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                int n = line[8] == '/' ? snprintf(gitdir, size, "%s", line + 8)
+                                       : snprintf(gitdir, size, "%s/%s", dir, line + 8);
+                fclose(f);
+                return n < (int)size ? 0 : -1;
+            }
+            if (f) fclose(f);
+        }
+
+        char *slash = strrchr(dir, '/');
+        if (!slash || strcmp(dir, "/") == 0) {
+            return -1;
+        }
+        if (slash == dir) {
+            dir[1] = '\0';
+        } else {
+            *slash = '\0';
+        }
+    }
+}
+
+/**
+ * Run "git status" with a strict time budget; 1 dirty, 0 clean, -1 unknown
+ */
+static int git_dirty(const char *cwd) {
+    char *argv[] = {"git", "-C", (char*)cwd, "status", "--porcelain",
+                    "--untracked-files=no", "--ignore-submodules", NULL};
+    posix_spawn_file_actions_t actions;
+    int out[2];
+    pid_t pid;
+    int dirty = 0;
+    char buf[256];
+    double deadline = now_seconds() + GIT_STATUS_BUDGET_MS / 1000.0;
+
+    if (pipe2(out, O_CLOEXEC) != 0) {
+        return -1;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    int rc = posix_spawnp(&pid, "git", &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out[1]);
+
+    if (rc != 0) {
+        /* No git binary: show the branch without a dirty mark */
+        close(out[0]);
+        return 0;
+    }
+
+    while (1) {
+        struct pollfd pfd = {out[0], POLLIN, 0};
+        int remaining = (int)((deadline - now_seconds()) * 1000);
+
+        if (remaining <= 0 || poll(&pfd, 1, remaining) <= 0) {
+            /* Over budget: give up on this segment */
+            kill(pid, SIGKILL);
+            dirty = -1;
+            break;
+        }
+
+        ssize_t n = read(out[0], buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        dirty = 1;
+    }
+
+    close(out[0]);
+    waitpid(pid, NULL, 0);
+    return dirty;
+}
+
+/**
+ * Compute the git segment: " (branch*)" or empty outside a repository
+ */
+static void compute_git_segment(const char *cwd, char *out, size_t size) {
+    char gitdir[PATH_MAX];
+    char head_path[PATH_MAX + 8];
+    char head[256];
+    char branch[GIT_SEGMENT_SIZE - 4];     /* room for " (", "*" and ")" */
+    FILE *f;
+
+    out[0] = '\0';
+    if (find_git_dir(cwd, gitdir, sizeof(gitdir)) != 0) {
+        return;
+    }
+
+    snprintf(head_path, sizeof(head_path), "%s/HEAD", gitdir);
+    f = fopen(head_path, "re");
+    if (!f) {
+        return;
+    }
+    if (!fgets(head, sizeof(head), f)) {
+        fclose(f);
+        return;
+    }
+    fclose(f);
+    head[strcspn(head, "\n")] = '\0';
+
+    if (strncmp(head, "ref: refs/heads/", 16) == 0) {
+        snprintf(branch, sizeof(branch), "%.*s", (int)sizeof(branch) - 1, head + 16);
+    } else {
+        /* Detached HEAD: short commit id */
+        snprintf(branch, sizeof(branch), "%.7s", head);
+    }
+
+    int dirty = git_dirty(cwd);
+    snprintf(out, size, " (%s%s)", branch, dirty > 0 ? "*" : dirty < 0 ? "?" : "");
+}
+
+/**
+ * Worker thread: computes expensive segments off the main thread
+ */
+static void* segment_worker(void *arg) {
+    char git[GIT_SEGMENT_SIZE];
+    (void)arg;
+
+    pthread_mutex_lock(&g_async_lock);
+    while (1) {
+        while (!g_request_pending && !g_worker_stop) {
+            pthread_cond_wait(&g_async_cond, &g_async_lock);
+        }
+        if (g_worker_stop) {
+            break;
+        }
+
+        char *cwd = strdup(g_request_cwd);
+        unsigned int gen = g_request_gen;
+        g_request_pending = 0;
+        pthread_mutex_unlock(&g_async_lock);
+
+        if (cwd) {
+            compute_git_segment(cwd, git, sizeof(git));
+        }
+
+        pthread_mutex_lock(&g_async_lock);
+        if (cwd) {
+            free(g_result_cwd);
+            g_result_cwd = cwd;
+            g_result_gen = gen;
+            snprintf(g_result_git, sizeof(g_result_git), "%s", git);
+        }
+
+        /* Wake up the line editor so it can redraw the prompt */
+        if (write(g_notify_pipe[1], "", 1) < 0) {
+            /* Pipe full: an update is already pending */
+        }
+    }
+    pthread_mutex_unlock(&g_async_lock);
+    return NULL;
+}
+
+/**
+ * Fetch the git segment without ever blocking the main thread
+ * Stale results for the same directory are shown until fresh ones arrive
+ */
+static void render_git_segment(char *out, size_t size) {
+    out[0] = '\0';
+
+    if (!g_worker_started || !g_cwd) {
+        return;
+    }
+    if (pthread_mutex_trylock(&g_async_lock) != 0) {
+        return;
+    }
+
+    int same_dir = g_result_cwd && strcmp(g_result_cwd, g_cwd) == 0;
+    if (same_dir) {
+        snprintf(out, size, "%s", g_result_git);
+    }
+
+    int fresh = same_dir && g_result_gen == g_generation;
+    int requested = g_request_cwd && strcmp(g_request_cwd, g_cwd) == 0 &&
+                    g_request_gen == g_generation;
+    if (!fresh && !requested) {
+        free(g_request_cwd);
+        g_request_cwd = strdup(g_cwd);
+        g_request_gen = g_generation;
+        g_request_pending = g_request_cwd != NULL;
+        pthread_cond_signal(&g_async_cond);
+    }
+
+    pthread_mutex_unlock(&g_async_lock);
+}
+
+#else
+
+static void render_git_segment(char *out, size_t size) {
+    out[0] = '\0';
+}
+
+#endif
+
+/**
+ * Start the prompt machinery: cached cwd and the segment worker
+ */
+void prompt_init(void) {
+    update_cwd_cache();
+
+    #ifndef _WIN32
+    if (pipe2(g_notify_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        return;
+    }
+
+    /* The worker must never take signals meant for the shell */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    g_worker_started = pthread_create(&g_worker, NULL, segment_worker, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    #endif
+}
+
+void prompt_cleanup(void) {
+    #ifndef _WIN32
+    if (g_worker_started) {
+        pthread_mutex_lock(&g_async_lock);
+        g_worker_stop = 1;
+        pthread_cond_signal(&g_async_cond);
+        pthread_mutex_unlock(&g_async_lock);
+        pthread_join(g_worker, NULL);
+        g_worker_started = 0;
+    }
+    if (g_notify_pipe[0] >= 0) {
+        close(g_notify_pipe[0]);
+        close(g_notify_pipe[1]);
+        g_notify_pipe[0] = g_notify_pipe[1] = -1;
+    }
+    free(g_request_cwd);
+    free(g_result_cwd);
+    g_request_cwd = g_result_cwd = NULL;
+    #endif
+
+    free(g_cwd);
+    free(g_display_cwd);
+    g_cwd = g_display_cwd = NULL;
+}
+
+/**
+ * File descriptor that becomes readable when async segments change
+ */
+int prompt_update_fd(void) {
+    #ifdef _WIN32
+    return -1;
+    #else
+    return g_notify_pipe[0];
+    #endif
+}
+
+/**
+ * Drain pending segment notifications
+ */
+void prompt_consume_update(void) {
+    #ifndef _WIN32
+    char buf[64];
+    while (g_notify_pipe[0] >= 0 && read(g_notify_pipe[0], buf, sizeof(buf)) > 0) {
+        continue;
+    }
+    #endif
+}
+
+/**
+ * Append text to the prompt buffer, truncating at the end
+ */
+static void append(char *buf, size_t size, size_t *len, const char *text) {
+    size_t n = strlen(text);
+    if (*len + n >= size) {
+        n = size - *len - 1;
+    }
+    memcpy(buf + *len, text, n);
+    *len += n;
+    buf[*len] = '\0';
+}
+
+/**
+ * Render one {segment}; unknown names are left as typed
+ */
+static void render_segment(const char *name, size_t name_len, char *out, size_t size) {
+    static const struct { const char *name; const char *code; } colors[] = {
+        {"reset", COLOR_RESET}, {"red", COLOR_RED}, {"green", COLOR_GREEN},
+        {"yellow", COLOR_YELLOW}, {"blue", COLOR_BLUE}, {"magenta", COLOR_MAGENTA},
+        {"cyan", COLOR_CYAN}, {NULL, NULL}
+    };
+
+    out[0] = '\0';
+
+    for (int i = 0; colors[i].name; i++) {
+        if (strlen(colors[i].name) == name_len &&
+            strncmp(name, colors[i].name, name_len) == 0) {
+            snprintf(out, size, "%s", colors[i].code);
+            return;
+        }
+    }
+
+    if (name_len == 3 && strncmp(name, "cwd", 3) == 0) {
+        snprintf(out, size, "%s", g_display_cwd ? g_display_cwd : "???");
+    } else if (name_len == 3 && strncmp(name, "git", 3) == 0) {
+        render_git_segment(out, size);
+    } else if (name_len == 6 && strncmp(name, "status", 6) == 0) {
+        if (g_prompt_status != 0) {
+            snprintf(out, size, " [%d]", g_prompt_status);
+        }
+    } else if (name_len == 8 && strncmp(name, "duration", 8) == 0) {
+        if (g_prompt_duration >= DURATION_THRESHOLD) {
+            snprintf(out, size, " took %.1fs", g_prompt_duration);
+        }
+    } else if (name_len == 4 && strncmp(name, "time", 4) == 0) {
+        time_t now = time(NULL);
+        struct tm *tm = localtime(&now);
+        if (tm) {
+            strftime(out, size, "%H:%M:%S", tm);
+        }
+    } else if (name_len == 4 && strncmp(name, "user", 4) == 0) {
+        #ifdef _WIN32
+        const char *user = getenv("USERNAME");
+        #else
+        const char *user = getenv("USER");
+        #endif
+        snprintf(out, size, "%s", user ? user : "");
+    } else if (name_len == 4 && strncmp(name, "host", 4) == 0) {
+        #ifdef _WIN32
+        const char *host = getenv("COMPUTERNAME");
+        snprintf(out, size, "%s", host ? host : "");
+        #else
+        if (gethostname(out, size) != 0) {
+            out[0] = '\0';
+        }
+        out[size - 1] = '\0';
+        #endif
+    } else {
+        snprintf(out, size, "{%.*s}", (int)name_len, name);
+    }
+}
+
+/**
+ * Build the command prompt from $MINISHELL_PROMPT (or the default template)
+ */
+int build_prompt(char *buf, size_t size) {
+    const char *tmpl = getenv("MINISHELL_PROMPT");
+    char segment[MAX_PROMPT_SIZE];
+    char literal[2] = {0, 0};
+    size_t len = 0;
+
+    if (!tmpl || !*tmpl) {
+        tmpl = DEFAULT_PROMPT_TEMPLATE;
+    }
+
+    buf[0] = '\0';
+    for (const char *p = tmpl; *p && len + 1 < size; p++) {
+        if (*p == '{') {
+            const char *end = strchr(p + 1, '}');
+            if (end) {
+                render_segment(p + 1, (size_t)(end - p - 1), segment, sizeof(segment));
+                append(buf, size, &len, segment);
+                p = end;
+                continue;
+            }
+        }
+
+        /* Allow "\n" in templates set from the environment */
+        if (*p == '\\' && p[1] == 'n') {
+            literal[0] = '\n';
+            p++;
+        } else {
+            literal[0] = *p;
+        }
+        append(buf, size, &len, literal);
+    }
+
+    return (int)len;
+}
+
+/**
+ * Print command prompt
+ */
+void print_prompt(void) {
+    char prompt[MAX_PROMPT_SIZE];
+
+    build_prompt(prompt, sizeof(prompt));
+    fputs(prompt, stdout);
+    fflush(stdout);
+}
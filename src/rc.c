@@ -0,0 +1,459 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <limits.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * Startup file
+ *
+ * ~/.minishellrc is run when the shell starts. When all of its lines are
+ * definitions (NAME=value words, export NAME=value, alias NAME=value,
+ * NAME() { ...; } on one line, blank lines and comments), the parsed
+ * definitions are also written to a snapshot in the
+ * cache directory along with the size, mtime and hash of the file. The next
+ * start maps the snapshot and, if the file still matches, replays the
+ * definitions from it instead of splitting and tokenizing the file again.
+ *
+ * Values are stored as written and expanded as they are replayed, so a
+ * definition such as PATH=$HOME/bin:$PATH follows the environment the shell
+ * starts in. Aliases and functions are kept as written and defined again
+ * from their text. A file with any other command is a script, and is run
+ * line by line on every start.
+ *
+ * Snapshot layout: RcHeader, the rc path, then one RcRecord per definition
+ * followed by its word; everything is padded to 8 bytes.
+ */
+
+#define RC_FILE ".minishellrc"
+#define RC_SNAPSHOT "rc.snapshot"
+#define RC_MAGIC "MSHRC001"
+#define RC_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+/* Kinds of definitions */
+enum {
+    RC_SET,                 /* NAME=value */
+    RC_EXPORT,              /* export NAME=value */
+    RC_ALIAS,               /* alias NAME=value */
+    RC_FUNCTION             /* NAME() { ...; } */
+};
+
+typedef struct {
+    char magic[8];
+    uint64_t size;          /* of the rc file */
+    int64_t mtime;
+    int64_t mtime_nsec;
+    uint64_t hash;
+    uint32_t path_len;
+    uint32_t count;         /* records */
+} RcHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t len;           /* of the word with its NUL */
+} RcRecord;
+
+typedef struct {
+    int type;
+    char *word;
+} Definition;
+
+typedef struct {
+    Definition *items;
+    int count;
+    int cap;
+} Definitions;
+
+static uint64_t rc_hash(const char *data, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int rc_path(char *buf, size_t size) {
+    #ifdef _WIN32
+    const char *home = getenv("USERPROFILE");
+    #else
+    const char *home = getenv("HOME");
+    #endif
+
+    if (!home || !*home) {
+        return -1;
+    }
+    snprintf(buf, size, "%s/%s", home, RC_FILE);
+    return 0;
+}
+
+static char* read_file(const char *path, size_t size) {
+    char *data = (char*)malloc(size + 1);
+    FILE *fp = fopen(path, "rb");
+    size_t n = 0;
+
+    if (data && fp) {
+        n = fread(data, 1, size, fp);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    if (!data || n != size) {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+/**
+ * Run one definition
+ */
+static void apply(int type, const char *word) {
+    char *expanded;
+
+    if (type == RC_ALIAS) {
+        char *args[] = { "alias", (char*)word, NULL };
+        builtin_alias(args);
+        return;
+    }
+    if (type == RC_FUNCTION) {
+        char *copy = strdup(word);
+        int exit_requested = 0;
+        if (copy) {
+            execute_line(copy, &exit_requested);
+        }
+        free(copy);
+        return;
+    }
+
+    arena_reset();
+    expanded = expand_word(word);
+    if (!expanded && !(expanded = arena_copy(word, strlen(word)))) {
+        print_error("Memory allocation failed");
+        return;
+    }
+
+    if (type == RC_EXPORT) {
+        char *args[] = { "export", expanded, NULL };
+        builtin_export(args);
+    } else if (assign_word(expanded) != 0) {
+        print_error("Failed to set variable");
+    }
+}
+
+static int add_definition(Definitions *defs, int type, char *word) {
+    if (defs->count == defs->cap) {
+        int cap = defs->cap ? defs->cap * 2 : 32;
+        Definition *grown = (Definition*)realloc(defs->items, (size_t)cap * sizeof(Definition));
+        if (!grown) {
+            return -1;
+        }
+        defs->items = grown;
+        defs->cap = cap;
+    }
+    defs->items[defs->count].type = type;
+    defs->items[defs->count].word = word;
+    defs->count++;
+    return 0;
+}
+
+static void free_definitions(Definitions *defs) {
+    for (int i = 0; i < defs->count; i++) {
+        free(defs->items[i].word);
+    }
+    free(defs->items);
+}
+
+/**
+ * Parse one line as definitions; returns -1 if it is a command
+ */
+static int parse_line(char *line, Definitions *defs) {
+    char *tokens[MAX_NUM_TOKENS];
+    int count;
+    int rc = 0;
+
+    line = trim_whitespace(line);
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+
+    /* Their text is defined as it is, see apply() */
+    if (strncmp(line, "alias", 5) == 0 && (line[5] == ' ' || line[5] == '\t')) {
+        char *word = strdup(trim_whitespace(line + 5));
+        if (!word || !strchr(word, '=') || add_definition(defs, RC_ALIAS, word) != 0) {
+            free(word);
+            return -1;
+        }
+        return 0;
+    }
+    if (is_function_definition(line)) {
+        char *word = strdup(line);
+        if (!word || add_definition(defs, RC_FUNCTION, word) != 0) {
+            free(word);
+            return -1;
+        }
+        return 0;
+    }
+
+    count = tokenize(line, tokens);
+    if (count <= 0) {
+        return -1;
+    }
+
+    if (strcmp(tokens[0], "export") == 0) {
+        if (count != 2 || !is_assignment(tokens[1]) || add_definition(defs, RC_EXPORT, tokens[1]) != 0) {
+            rc = -1;
+        } else {
+            tokens[1] = NULL;
+        }
+    } else {
+        for (int i = 0; i < count && rc == 0; i++) {
+            if (!is_assignment(tokens[i]) || add_definition(defs, RC_SET, tokens[i]) != 0) {
+                rc = -1;
+            } else {
+                tokens[i] = NULL;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(tokens[i]);
+    }
+    return rc;
+}
+
+/**
+ * Parse the whole file as definitions; returns -1 if it is a script
+ */
+static int parse_definitions(const char *text, Definitions *defs) {
+    char *copy = strdup(text);
+    char *line = copy;
+    int rc = copy ? 0 : -1;
+
+    while (line && rc == 0) {
+        char *nl = strchr(line, '\n');
+        if (nl) *nl = '\0';
+        rc = parse_line(line, defs);
+        line = nl ? nl + 1 : NULL;
+    }
+    free(copy);
+    return rc;
+}
+
+/**
+ * Run the file as a script, one line at a time
+ */
+static void run_script(const char *text) {
+    char *copy = strdup(text);
+    char *line = copy;
+    int exit_requested = 0;
+
+    while (line && !exit_requested) {
+        char *nl = strchr(line, '\n');
+        char *trimmed;
+
+        if (nl) *nl = '\0';
+        trimmed = trim_whitespace(line);
+        if (*trimmed != '\0' && *trimmed != '#') {
+            g_last_exit_status = execute_line(trimmed, &exit_requested);
+        }
+        line = nl ? nl + 1 : NULL;
+    }
+    free(copy);
+}
+
+#ifndef _WIN32
+
+static int snapshot_path(char *buf, size_t size) {
+    size_t len;
+
+    if (cache_dir(buf, size) != 0) {
+        return -1;
+    }
+    len = strlen(buf);
+    snprintf(buf + len, size - len, "/%s", RC_SNAPSHOT);
+    return 0;
+}
+
+/**
+ * Replay the definitions of a snapshot taken from the rc file as it is now
+ * Returns -1, having done nothing, if there is none or it is stale
+ */
+static int replay_snapshot(const char *snapshot, const char *path, const struct stat *st, uint64_t hash) {
+    struct stat sst;
+    RcHeader header;
+    size_t size;
+    size_t pos;
+    size_t path_len = strlen(path);
+    char *map;
+    int fd = open(snapshot, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &sst) != 0 || (size_t)sst.st_size < sizeof(RcHeader)) {
+        close(fd);
+        return -1;
+    }
+    size = (size_t)sst.st_size;
+    map = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    pos = sizeof(header) + RC_ALIGN(path_len);
+    if (memcmp(header.magic, RC_MAGIC, sizeof(header.magic)) != 0 ||
+        header.size != (uint64_t)st->st_size ||
+        header.mtime != (int64_t)st->st_mtim.tv_sec ||
+        header.mtime_nsec != (int64_t)st->st_mtim.tv_nsec ||
+        header.hash != hash ||
+        header.path_len != path_len || pos > size ||
+        memcmp(map + sizeof(header), path, path_len) != 0) {
+        munmap(map, size);
+        return -1;
+    }
+
+    /* Check every record before running any */
+    size_t start = pos;
+    for (uint32_t i = 0; i < header.count; i++) {
+        RcRecord record;
+
+        if (pos + sizeof(record) > size) {
+            munmap(map, size);
+            return -1;
+        }
+        memcpy(&record, map + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.len == 0 || record.len > size - pos || map[pos + record.len - 1] != '\0') {
+            munmap(map, size);
+            return -1;
+        }
+        pos += RC_ALIGN(record.len);
+    }
+
+    for (pos = start; header.count > 0; header.count--) {
+        RcRecord record;
+
+        memcpy(&record, map + pos, sizeof(record));
+        apply((int)record.type, map + pos + sizeof(record));
+        pos += sizeof(record) + RC_ALIGN(record.len);
+    }
+
+    munmap(map, size);
+    return 0;
+}
+
+/**
+ * Write the parsed definitions to a new snapshot
+ * Failing only means parsing the file again next time, so errors are quiet
+ */
+static void save_snapshot(const char *snapshot, const char *path, const struct stat *st,
+                          uint64_t hash, const Definitions *defs) {
+    char tmp[PATH_MAX + 32];
+    RcHeader header;
+    size_t path_len = strlen(path);
+    size_t size = sizeof(header) + RC_ALIGN(path_len);
+    char *buf;
+    size_t pos;
+    int fd;
+
+    for (int i = 0; i < defs->count; i++) {
+        size += sizeof(RcRecord) + RC_ALIGN(strlen(defs->items[i].word) + 1);
+    }
+    if (!(buf = (char*)calloc(1, size))) {
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RC_MAGIC, sizeof(header.magic));
+    header.size = (uint64_t)st->st_size;
+    header.mtime = (int64_t)st->st_mtim.tv_sec;
+    header.mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    header.hash = hash;
+    header.path_len = (uint32_t)path_len;
+    header.count = (uint32_t)defs->count;
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), path, path_len);
+    pos = sizeof(header) + RC_ALIGN(path_len);
+
+    for (int i = 0; i < defs->count; i++) {
+        RcRecord record;
+
+        record.type = (uint32_t)defs->items[i].type;
+        record.len = (uint32_t)strlen(defs->items[i].word) + 1;
+        memcpy(buf + pos, &record, sizeof(record));
+        memcpy(buf + pos + sizeof(record), defs->items[i].word, record.len);
+        pos += sizeof(record) + RC_ALIGN(record.len);
+    }
+
+    /* Publish it whole: other shells may be starting right now */
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", snapshot, (int)getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        int ok = write(fd, buf, size) == (ssize_t)size;
+        close(fd);
+        if (!ok || rename(tmp, snapshot) != 0) {
+            unlink(tmp);
+        }
+    }
+    free(buf);
+}
+
+#endif
+
+/**
+ * Run ~/.minishellrc, from its snapshot when it is current
+ */
+void rc_load(void) {
+    char path[4096];
+    struct stat st;
+    char *text;
+    uint64_t hash;
+    Definitions defs = { NULL, 0, 0 };
+
+    if (rc_path(path, sizeof(path)) != 0 || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    if (!(text = read_file(path, (size_t)st.st_size))) {
+        print_error("Failed to read ~/" RC_FILE);
+        return;
+    }
+    hash = rc_hash(text, (size_t)st.st_size);
+
+    #ifndef _WIN32
+    char snapshot[PATH_MAX];
+    int have_snapshot = snapshot_path(snapshot, sizeof(snapshot)) == 0;
+
+    if (have_snapshot && replay_snapshot(snapshot, path, &st, hash) == 0) {
+        free(text);
+        return;
+    }
+    #endif
+
+    if (parse_definitions(text, &defs) == 0) {
+        for (int i = 0; i < defs.count; i++) {
+            apply(defs.items[i].type, defs.items[i].word);
+        }
+        #ifndef _WIN32
+        if (have_snapshot) {
+            save_snapshot(snapshot, path, &st, hash, &defs);
+        }
+        #endif
+    } else {
+        run_script(text);
+    }
+
+    free_definitions(&defs);
+    free(text);
+}
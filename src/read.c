@@ -0,0 +1,410 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/*
+ * Reading input into variables
+ *
+ *   read [-r] [-u FD] [NAME...]
+ *       Read a line from standard input, or descriptor FD, and split it at
+ *       blanks, one word per NAME and the rest of the line for the last one
+ *       (all of it goes to REPLY when no NAME is given). Without -r a
+ *       backslash quotes the next character and one at the end of a line
+ *       continues it. Returns 1 at EOF.
+ *
+ *   mapfile [-t] [-n COUNT] [ARRAY]         (also readarray)
+ *       Read lines into ARRAY (MAPFILE by default), at most COUNT of them;
+ *       -t strips the newlines.
+ *
+ * Regular files are read in large blocks. Whatever was read beyond the last
+ * line consumed is given back by seeking to the end of that line, so the
+ * next command finds its input where a byte-at-a-time read would have left
+ * it. The block stays buffered: when the next read finds the offset
+ * unchanged it carries on from the buffer. Pipes and terminals cannot seek
+ * and are read a byte at a time.
+ */
+
+#define READ_BUFFER_SIZE 65536
+
+typedef struct {
+    int fd;                 /* -1: nothing buffered */
+    off_t start;            /* file offset of buf[0] */
+    size_t len;
+    size_t pos;             /* next unread byte */
+    char buf[READ_BUFFER_SIZE];
+} Reader;
+
+static Reader g_reader = { -1, 0, 0, 0, { 0 } };
+
+/* The line being read, reused from line to line */
+static char *g_line = NULL;
+static size_t g_line_cap = 0;
+
+/**
+ * Drop the buffered input, e.g. when stdin is redirected elsewhere
+ */
+void read_reset(void) {
+    g_reader.fd = -1;
+    g_reader.len = 0;
+    g_reader.pos = 0;
+}
+
+/**
+ * Start reading fd: keep the buffer if fd is still where we left it
+ * Returns 1 when fd is read in blocks, 0 when a byte at a time
+ */
+static int reader_attach(int fd) {
+    #ifdef _WIN32
+    /* Text mode translation makes offsets unreliable */
+    return 0;
+    #else
+    Reader *r = &g_reader;
+    struct stat st;
+    off_t cur = lseek(fd, 0, SEEK_CUR);
+
+    if (cur < 0) {
+        return 0;
+    }
+    if (r->fd == fd && cur == r->start + (off_t)r->pos) {
+        return 1;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+    r->fd = fd;
+    r->start = cur;
+    r->len = 0;
+    r->pos = 0;
+    return 1;
+    #endif
+}
+
+/**
+ * Seek fd back to the end of the last line consumed
+ */
+static void reader_give_back(int fd) {
+    if (g_reader.fd == fd) {
+        lseek(fd, g_reader.start + (off_t)g_reader.pos, SEEK_SET);
+    }
+}
+
+static int line_append(size_t *len, const char *data, size_t n) {
+    if (*len + n + 1 > g_line_cap) {
+        size_t cap = g_line_cap ? g_line_cap : 256;
+        while (cap < *len + n + 1) cap *= 2;
+        char *grown = (char*)realloc(g_line, cap);
+        if (!grown) {
+            return -1;
+        }
+        g_line = grown;
+        g_line_cap = cap;
+    }
+    memcpy(g_line + *len, data, n);
+    *len += n;
+    g_line[*len] = '\0';
+    return 0;
+}
+
+/**
+ * Append the next line of fd to g_line, without its newline
+ * Returns 1 for a line, 0 at EOF, -1 on error; *newline tells if it had one
+ */
+static int next_line(int fd, int buffered, size_t *len, int *newline) {
+    Reader *r = &g_reader;
+    size_t before = *len;
+
+    *newline = 0;
+    if (line_append(len, "", 0) != 0) {
+        return -1;
+    }
+
+    while (!buffered) {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+
+        if (n < 0) {
+            if (errno == EINTR && !g_interrupted) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        if (c == '\n') {
+            *newline = 1;
+            break;
+        }
+        if (line_append(len, &c, 1) != 0) {
+            return -1;
+        }
+    }
+
+    while (buffered) {
+        if (r->pos == r->len) {
+            ssize_t n;
+
+            /* The offset may have been given back since the last block */
+            r->start += (off_t)r->len;
+            r->len = 0;
+            r->pos = 0;
+            if (lseek(fd, r->start, SEEK_SET) < 0) {
+                return -1;
+            }
+            n = read(fd, r->buf, sizeof(r->buf));
+            if (n < 0) {
+                if (errno == EINTR && !g_interrupted) continue;
+                return -1;
+            }
+            if (n == 0) break;
+            r->len = (size_t)n;
+        }
+
+        char *nl = (char*)memchr(r->buf + r->pos, '\n', r->len - r->pos);
+        size_t n = nl ? (size_t)(nl - (r->buf + r->pos)) : r->len - r->pos;
+
+        if (line_append(len, r->buf + r->pos, n) != 0) {
+            return -1;
+        }
+        r->pos += n;
+        if (nl) {
+            r->pos++;
+            *newline = 1;
+            break;
+        }
+    }
+
+    return *len > before || *newline;
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/* How take_field() ends a field */
+enum {
+    FIELD_WORD,             /* at the next blank */
+    FIELD_REST,             /* at the end, without trailing blanks */
+    FIELD_LINE              /* at the end, as it is */
+};
+
+/**
+ * Copy the field of s starting at *pos into out, removing backslashes
+ * unless raw; advances *pos past it
+ */
+static void take_field(const char *s, size_t len, size_t *pos, int mode, int raw, char *out) {
+    size_t n = 0;
+    size_t keep = 0;        /* end of the field without trailing blanks */
+
+    while (*pos < len) {
+        char c = s[*pos];
+
+        if (c == '\\' && !raw) {
+            if (*pos + 1 < len) {
+                out[n++] = s[*pos + 1];
+                keep = n;
+            }
+            *pos += 2;
+            continue;
+        }
+        if (mode == FIELD_WORD && is_blank(c)) {
+            break;
+        }
+        out[n++] = c;
+        (*pos)++;
+        if (!is_blank(c)) {
+            keep = n;
+        }
+    }
+    out[mode == FIELD_REST ? keep : n] = '\0';
+}
+
+/**
+ * Open the input of a read or mapfile command
+ */
+static int open_input(Command *cmd) {
+    if (!cmd->input_file) {
+        return STDIN_FILENO;
+    }
+
+    int flags = O_RDONLY;
+    #ifndef _WIN32
+    flags |= O_CLOEXEC;
+    #endif
+
+    int fd = open(cmd->input_file, flags);
+    if (fd < 0) {
+        print_error("Failed to open input file");
+    }
+    return fd;
+}
+
+static void close_input(int fd) {
+    if (fd != STDIN_FILENO) {
+        close(fd);
+        read_reset();
+    }
+}
+
+/**
+ * read [-r] [-u FD] [NAME...]
+ */
+int builtin_read(Command *cmd) {
+    char **args = cmd->tokens;
+    int raw = 0;
+    int from = -1;
+    int i = 1;
+
+    for (; args[i] && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            raw = 1;
+        } else if (strcmp(args[i], "-u") == 0 && args[i + 1] &&
+                   isdigit((unsigned char)args[i + 1][0])) {
+            from = atoi(args[++i]);
+        } else {
+            print_error("Usage: read [-r] [-u FD] [NAME...]");
+            return -1;
+        }
+    }
+    for (int j = i; args[j]; j++) {
+        if (!valid_var_name(args[j], strlen(args[j]))) {
+            print_error("read: invalid variable name");
+            return -1;
+        }
+    }
+
+    /* -u reads a descriptor in place, e.g. a coprocess's output */
+    if (from >= 0 && !redirect_fd_usable(from)) {
+        print_error("Bad file descriptor");
+        return -1;
+    }
+    int fd = from >= 0 ? from : open_input(cmd);
+    if (fd < 0) {
+        return -1;
+    }
+    int buffered = reader_attach(fd);
+
+    size_t len = 0;
+    int newline;
+    int rc;
+
+    /* A backslash at the end continues the line unless -r */
+    while ((rc = next_line(fd, buffered, &len, &newline)) > 0 && newline && !raw) {
+        size_t slashes = 0;
+        while (slashes < len && g_line[len - 1 - slashes] == '\\') slashes++;
+        if (slashes % 2 == 0) break;
+        len--;
+    }
+    reader_give_back(fd);
+    if (from < 0) {
+        close_input(fd);
+    }
+
+    if (rc < 0) {
+        print_error("read: failed to read input");
+        return -1;
+    }
+
+    char *field = (char*)malloc(len + 1);
+    if (!field) {
+        print_error("Memory allocation failed");
+        return -1;
+    }
+
+    size_t pos = 0;
+    if (!args[i]) {
+        take_field(g_line, len, &pos, FIELD_LINE, raw, field);
+        var_set("REPLY", field);
+    }
+    for (; args[i]; i++) {
+        while (pos < len && is_blank(g_line[pos])) pos++;
+        take_field(g_line, len, &pos, args[i + 1] ? FIELD_WORD : FIELD_REST, raw, field);
+        var_set(args[i], field);
+    }
+    free(field);
+
+    /* Like other shells, a last line without a newline still counts as EOF */
+    return rc > 0 && newline ? 0 : 1;
+}
+
+/**
+ * mapfile [-t] [-n COUNT] [ARRAY]
+ */
+int builtin_mapfile(Command *cmd) {
+    char **args = cmd->tokens;
+    const char *name = "MAPFILE";
+    int strip = 0;
+    size_t limit = 0;
+    int i = 1;
+
+    for (; args[i] && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-t") == 0) {
+            strip = 1;
+        } else if (strcmp(args[i], "-n") == 0 && args[i + 1]) {
+            char *end;
+            limit = (size_t)strtoul(args[++i], &end, 10);
+            if (*end != '\0' || args[i][0] == '-') {
+                print_error("mapfile: invalid count");
+                return -1;
+            }
+        } else {
+            print_error("Usage: mapfile [-t] [-n COUNT] [ARRAY]");
+            return -1;
+        }
+    }
+    if (args[i]) {
+        name = args[i];
+        if (args[i + 1] || !valid_var_name(name, strlen(name))) {
+            print_error("Usage: mapfile [-t] [-n COUNT] [ARRAY]");
+            return -1;
+        }
+    }
+
+    int fd = open_input(cmd);
+    if (fd < 0) {
+        return -1;
+    }
+    int buffered = reader_attach(fd);
+
+    char **items = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    int rc = 0;
+
+    while (!limit || count < limit) {
+        size_t len = 0;
+        int newline;
+
+        rc = next_line(fd, buffered, &len, &newline);
+        if (rc <= 0) {
+            break;
+        }
+        if (newline && !strip && line_append(&len, "\n", 1) != 0) {
+            rc = -1;
+            break;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **grown = (char**)realloc(items, cap * sizeof(char*));
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+            items = grown;
+        }
+        if (!(items[count] = (char*)malloc(len + 1))) {
+            rc = -1;
+            break;
+        }
+        memcpy(items[count++], g_line, len + 1);
+    }
+    reader_give_back(fd);
+    close_input(fd);
+
+    if (var_set_array(name, items, count) != 0 || rc < 0) {
+        print_error("mapfile: failed to read input");
+        return -1;
+    }
+    return 0;
+}
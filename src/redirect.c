@@ -0,0 +1,403 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <fcntl.h>
+
+/*
+ * Descriptor redirections
+ *
+ *   N> file  N>> file  N< file  N<> file    open file as descriptor N
+ *   &> file  &>> file                       standard output and error
+ *   N>&M  N<&M                              make N a copy of M
+ *   N>&-                                    close N
+ *   exec REDIRECTIONS                       keep them for the shell itself
+ *
+ * < and > without a number stay in Command.input_file and output_file (see
+ * parser.c); these are applied after them, in the order they were written.
+ * A child applies them for good before exec. A builtin or function runs in
+ * the shell, so the descriptors it changes are saved first and put back
+ * afterwards; a builtin's standard output is its output buffer (output.c),
+ * which N>&1 copies and >&M simply points elsewhere, so echo >&3 in a loop
+ * costs no system calls besides the write.
+ *
+ * exec without a command changes the shell's own descriptors 0-9 and those
+ * stay open across commands and are inherited by them. Every descriptor the
+ * shell opens for itself is close-on-exec. At startup 3-9 are filled with
+ * close-on-exec /dev/null placeholders, so the shell's own descriptors,
+ * including those the prompt thread opens while a command runs, always get
+ * numbers from SHELL_FD_BASE up and exec N>file can never replace one of
+ * them. N>&- puts the placeholder back, and a copy of a placeholder is a
+ * bad descriptor. The shell may also take a slot for a descriptor that
+ * scripts name by number, such as a coprocess's pipes (jobs.c).
+ */
+
+#ifndef _WIN32
+
+/* Descriptors 3-9 opened by exec, which children must inherit */
+static int g_user_fds = 0;
+
+/* Descriptors 3-9 the shell took with redirect_take_slot() */
+static int g_shell_slots = 0;
+
+/* Source of the placeholders */
+static int g_placeholder = -1;
+
+/**
+ * Fill the free descriptors 3-9 with placeholders; call before anything
+ * else opens descriptors or starts threads
+ */
+void redirect_init(void) {
+    g_placeholder = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    for (int fd = STDERR_FILENO + 1; fd < SHELL_FD_BASE; fd++) {
+        if (fcntl(fd, F_GETFD) >= 0) {
+            /* Inherited from whoever started the shell */
+            if (fd != g_placeholder) {
+                g_user_fds |= 1 << fd;
+            }
+        } else if (g_placeholder >= 0) {
+            dup3(g_placeholder, fd, O_CLOEXEC);
+        }
+    }
+
+    if (g_placeholder >= 0 && g_placeholder < SHELL_FD_BASE) {
+        int high = fcntl(g_placeholder, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+        if (high >= 0) {
+            /* Its old number stays behind as a placeholder itself */
+            g_placeholder = high;
+        }
+    }
+}
+
+/**
+ * Close descriptor fd, or put its placeholder back
+ */
+static void close_fd(int fd) {
+    if (fd > STDERR_FILENO && fd < SHELL_FD_BASE && g_placeholder >= 0) {
+        dup3(g_placeholder, fd, O_CLOEXEC);
+    } else {
+        close(fd);
+    }
+}
+
+/**
+ * Check that fd is open and not a placeholder
+ */
+int redirect_fd_usable(int fd) {
+    int flags = fcntl(fd, F_GETFD);
+
+    if (flags < 0) {
+        return 0;
+    }
+    if (fd <= STDERR_FILENO || fd >= SHELL_FD_BASE || (g_shell_slots & (1 << fd))) {
+        return 1;
+    }
+    /* Descriptors the user opened below SHELL_FD_BASE never close on exec */
+    return !(flags & FD_CLOEXEC);
+}
+
+/**
+ * Move fd into a free descriptor 3-9, keeping it close-on-exec, so that
+ * redirections can name it; returns the new number, or -1 and closes fd
+ * when all of them are in use
+ */
+int redirect_take_slot(int fd) {
+    for (int slot = STDERR_FILENO + 1; slot < SHELL_FD_BASE; slot++) {
+        int flags;
+
+        if ((g_user_fds | g_shell_slots) & (1 << slot)) {
+            continue;
+        }
+        /* Only placeholders are free; a builtin may be redirecting one */
+        flags = fcntl(slot, F_GETFD);
+        if (flags < 0 || !(flags & FD_CLOEXEC) || dup3(fd, slot, O_CLOEXEC) < 0) {
+            continue;
+        }
+        close(fd);
+        g_shell_slots |= 1 << slot;
+        return slot;
+    }
+    close(fd);
+    return -1;
+}
+
+/**
+ * Give back a slot of redirect_take_slot(), unless exec has replaced it
+ */
+void redirect_free_slot(int slot) {
+    if (slot > STDERR_FILENO && slot < SHELL_FD_BASE && (g_shell_slots & (1 << slot))) {
+        g_shell_slots &= ~(1 << slot);
+        close_fd(slot);
+    }
+}
+
+/**
+ * Open the file of a redirection, close-on-exec like every descriptor of
+ * the shell until it is moved to its number
+ */
+static int open_redirect(const Redirect *r) {
+    int flags = O_CLOEXEC;
+
+    switch (r->type) {
+    case REDIR_READ:
+        flags |= O_RDONLY;
+        break;
+    case REDIR_WRITE:
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+    case REDIR_APPEND:
+        flags |= O_WRONLY | O_CREAT | O_APPEND;
+        break;
+    default:
+        flags |= O_RDWR | O_CREAT;
+        break;
+    }
+
+    int fd = open(r->file, flags, 0644);
+    if (fd < 0) {
+        print_error(r->type == REDIR_READ ? "Failed to open input file" : "Failed to open output file");
+    }
+    return fd;
+}
+
+/**
+ * Make descriptor target refer to what fd refers to, and close fd
+ */
+static int move_fd(int fd, int target) {
+    if (fd == target) {
+        /* open() picked the free number itself: it must survive exec */
+        return fcntl(fd, F_SETFD, 0);
+    }
+    if (dup2(fd, target) < 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Apply one redirection to the descriptors of this process
+ * source stands in for r->source of a copy
+ */
+static int apply_one(const Redirect *r, int source) {
+    int fd;
+
+    if (r->type == REDIR_CLOSE) {
+        close_fd(r->fd);
+        return 0;
+    }
+    if (r->type == REDIR_DUP) {
+        if (!redirect_fd_usable(source)) {
+            print_error("Bad file descriptor");
+            return -1;
+        }
+        return source == r->fd || dup2(source, r->fd) >= 0 ? 0 : -1;
+    }
+
+    fd = open_redirect(r);
+    if (fd < 0) {
+        return -1;
+    }
+    if (move_fd(fd, r->fd) != 0) {
+        print_error("Failed to redirect");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Apply all of cmd's redirections for good: in a child before exec, or to
+ * the shell itself for exec
+ */
+int redirect_apply(const Command *cmd) {
+    int fd;
+
+    if (cmd->input_file) {
+        Redirect in = { STDIN_FILENO, REDIR_READ, -1, cmd->input_file };
+        if ((fd = open_redirect(&in)) < 0 || move_fd(fd, STDIN_FILENO) != 0) {
+            return -1;
+        }
+    }
+    if (cmd->output_file) {
+        Redirect out = { STDOUT_FILENO, cmd->append_output ? REDIR_APPEND : REDIR_WRITE, -1, cmd->output_file };
+        if ((fd = open_redirect(&out)) < 0 || move_fd(fd, STDOUT_FILENO) != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        if (apply_one(&cmd->redirects[i], cmd->redirects[i].source) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Apply cmd's redirections while a builtin (builtin set) or function runs,
+ * keeping what they replace in save for redirect_pop()
+ */
+int redirect_push(const Command *cmd, RedirectSave *save, int builtin) {
+    save->count = 0;
+    save->out_fd = -1;
+
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const Redirect *r = &cmd->redirects[i];
+        int source = r->source;
+
+        /* A builtin's standard output is its output buffer */
+        if (builtin && source == STDOUT_FILENO) {
+            source = out_get_fd();
+        }
+        if (builtin && r->fd == STDOUT_FILENO && r->type == REDIR_DUP) {
+            if (!redirect_fd_usable(source)) {
+                print_error("Bad file descriptor");
+                redirect_pop(save);
+                return -1;
+            }
+            out_flush();
+            int prev = out_set_fd(source);
+            if (save->out_fd < 0) {
+                save->out_fd = prev;
+            }
+            continue;
+        }
+
+        out_flush();
+        save->fd[save->count] = r->fd;
+        save->saved[save->count] = fcntl(r->fd, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+        save->count++;
+
+        if (apply_one(r, source) != 0) {
+            redirect_pop(save);
+            return -1;
+        }
+        if (r->fd == STDIN_FILENO) {
+            read_reset();
+        }
+        if (builtin && r->fd == STDOUT_FILENO && save->out_fd < 0) {
+            save->out_fd = out_set_fd(STDOUT_FILENO);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Put back the descriptors redirect_push() changed
+ */
+void redirect_pop(RedirectSave *save) {
+    out_flush();
+    while (save->count > 0) {
+        int i = --save->count;
+
+        if (save->saved[i] >= 0) {
+            dup2(save->saved[i], save->fd[i]);
+            close(save->saved[i]);
+        } else {
+            close_fd(save->fd[i]);
+        }
+        if (save->fd[i] == STDIN_FILENO) {
+            read_reset();
+        }
+    }
+    if (save->out_fd >= 0) {
+        out_set_fd(save->out_fd);
+        save->out_fd = -1;
+    }
+}
+
+/**
+ * Check if exec left descriptors above 2 open for commands to inherit
+ */
+int redirect_user_fds(void) {
+    return g_user_fds != 0;
+}
+
+/**
+ * exec [REDIRECTIONS]           change the shell's own descriptors
+ * exec command [args]          replace the shell with command
+ */
+int builtin_exec(Command *cmd) {
+    out_flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    if (cmd->tee_count > 0) {
+        print_error("exec: only one output file can be kept open");
+        return -1;
+    }
+    if (redirect_apply(cmd) != 0) {
+        return 1;
+    }
+    if (cmd->input_file) {
+        read_reset();
+    }
+    for (int i = 0; i < cmd->redirect_count; i++) {
+        const Redirect *r = &cmd->redirects[i];
+
+        if (r->fd == STDIN_FILENO) {
+            read_reset();
+        } else if (r->fd > STDERR_FILENO) {
+            g_shell_slots &= ~(1 << r->fd);
+            if (r->type == REDIR_CLOSE) {
+                g_user_fds &= ~(1 << r->fd);
+            } else {
+                g_user_fds |= 1 << r->fd;
+            }
+        }
+    }
+
+    if (cmd->token_count > 1) {
+        execvp(cmd->tokens[1], cmd->tokens + 1);
+        fprintf(stderr, "%smini-shell: %s: command not found%s\n",
+                COLOR_RED, cmd->tokens[1], COLOR_RESET);
+        return 127;
+    }
+    return 0;
+}
+
+#else
+
+void redirect_init(void) {
+}
+
+int redirect_fd_usable(int fd) {
+    return fd >= 0 && fd <= STDERR_FILENO;
+}
+
+int redirect_take_slot(int fd) {
+    return -1;
+}
+
+void redirect_free_slot(int slot) {
+}
+
+int redirect_apply(const Command *cmd) {
+    return 0;
+}
+
+int redirect_push(const Command *cmd, RedirectSave *save, int builtin) {
+    save->count = 0;
+    save->out_fd = -1;
+    if (cmd->redirect_count > 0) {
+        print_error("Descriptor redirections are not supported on Windows");
+        return -1;
+    }
+    return 0;
+}
+
+void redirect_pop(RedirectSave *save) {
+}
+
+int redirect_user_fds(void) {
+    return 0;
+}
+
+int builtin_exec(Command *cmd) {
+    print_error("exec is not supported on Windows");
+    return -1;
+}
+
+#endif
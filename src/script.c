@@ -0,0 +1,501 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <fcntl.h>
+#include <ctype.h>
+
+/*
+ * Command lists, loops and functions
+ *
+ * A line is a list of commands separated by ';'. The compound commands are
+ *
+ *   while COMMAND; do COMMANDS; done [< file]
+ *   NAME() { COMMANDS; }
+ *
+ * A while loop runs COMMANDS for as long as COMMAND succeeds, with its
+ * standard input taken from file if given. A function definition stores
+ * COMMANDS under NAME; NAME used as a command then runs them with $1...
+ * set to its arguments, until the end or a return.
+ *
+ * A line is split into a tree of nodes once, and each command in it into
+ * words; running a node only expands its words (see build_command() in
+ * parser.c), so they see the current values of variables. A function keeps
+ * the tree it was defined with, so calls never split text again.
+ */
+
+#define FUNCTION_BUCKETS 64
+#define MAX_CALL_DEPTH 256
+
+enum {
+    NODE_COMMAND,
+    NODE_WHILE,
+    NODE_FUNCTION
+};
+
+typedef struct Function Function;
+
+typedef struct Node {
+    int type;
+    char *text;             /* (( expression )), run as it is */
+    char **words;           /* the command, or the loop condition */
+    int word_count;
+    char *input_file;       /* done < file */
+    Function *function;     /* NAME() { ... } */
+    struct Node *body;
+    struct Node *next;
+} Node;
+
+struct Function {
+    char *name;
+    Node *body;
+    int refs;               /* its definition, the table, calls running */
+    struct Function *next;
+};
+
+static Function *g_functions[FUNCTION_BUCKETS];
+static int g_call_depth = 0;
+static int g_returning = 0;
+static int g_return_status = 0;
+
+static void release_function(Function *fn);
+
+static void free_nodes(Node *node) {
+    while (node) {
+        Node *next = node->next;
+        free(node->text);
+        for (int i = 0; i < node->word_count; i++) {
+            free(node->words[i]);
+        }
+        free(node->words);
+        free(node->input_file);
+        release_function(node->function);
+        free_nodes(node->body);
+        free(node);
+        node = next;
+    }
+}
+
+static unsigned int function_hash(const char *name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    }
+    return h % FUNCTION_BUCKETS;
+}
+
+static Function** function_link(const char *name) {
+    Function **link = &g_functions[function_hash(name)];
+
+    while (*link && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void release_function(Function *fn) {
+    if (fn && --fn->refs == 0) {
+        free_nodes(fn->body);
+        free(fn->name);
+        free(fn);
+    }
+}
+
+/**
+ * Enter a function in the table, replacing one of the same name
+ */
+static void define_function(Function *fn) {
+    Function **link = function_link(fn->name);
+
+    if (*link == fn) {
+        return;
+    }
+    fn->refs++;
+    fn->next = NULL;
+    if (*link) {
+        fn->next = (*link)->next;
+        release_function(*link);
+    }
+    *link = fn;
+}
+
+int is_function(const char *name) {
+    return *function_link(name) != NULL;
+}
+
+/**
+ * Remove a function; returns -1 if there is none
+ */
+int unset_function(const char *name) {
+    Function **link = function_link(name);
+    Function *fn = *link;
+
+    if (!fn) {
+        return -1;
+    }
+    *link = fn->next;
+    release_function(fn);
+    return 0;
+}
+
+/**
+ * If segment starts with the keyword word, return what follows it
+ */
+static char* after_keyword(char *segment, const char *word) {
+    size_t len = strlen(word);
+
+    if (strncmp(segment, word, len) != 0 ||
+        (segment[len] != '\0' && !isspace((unsigned char)segment[len]))) {
+        return NULL;
+    }
+    return trim_whitespace(segment + len);
+}
+
+/**
+ * Length of a NAME() { that starts s, 0 if there is none
+ */
+static size_t function_header(const char *s, size_t *name_len) {
+    size_t i = 0;
+
+    while (isalnum((unsigned char)s[i]) || s[i] == '_' || s[i] == '-') i++;
+    *name_len = i;
+    if (i == 0) {
+        return 0;
+    }
+    while (s[i] == ' ' || s[i] == '\t') i++;
+    if (s[i++] != '(') {
+        return 0;
+    }
+    while (s[i] == ' ' || s[i] == '\t') i++;
+    if (s[i++] != ')') {
+        return 0;
+    }
+    while (s[i] == ' ' || s[i] == '\t') i++;
+    if (s[i++] != '{' || (s[i] != '\0' && !isspace((unsigned char)s[i]))) {
+        return 0;
+    }
+    return i;
+}
+
+/**
+ * Check if a line starts with a function definition
+ */
+int is_function_definition(const char *line) {
+    size_t name_len;
+    return function_header(line, &name_len) > 0;
+}
+
+/**
+ * Give a node its command: split into words now, so that running it again
+ * in a loop or a function only expands them
+ */
+static int set_command(Node *node, char *text) {
+    char *tokens[MAX_NUM_TOKENS];
+    size_t len = strlen(text);
+    int count;
+
+    /* (( expression )) is evaluated from its compiled form, see arith.c */
+    if (len >= 4 && strncmp(text, "((", 2) == 0 && strcmp(text + len - 2, "))") == 0) {
+        node->text = strdup(text);
+        return node->text ? 0 : -1;
+    }
+
+    count = tokenize(text, tokens);
+    if (count < 0 || !(node->words = (char**)malloc((size_t)(count + 1) * sizeof(char*)))) {
+        for (int i = 0; i < count; i++) free(tokens[i]);
+        return -1;
+    }
+    memcpy(node->words, tokens, (size_t)count * sizeof(char*));
+    node->words[count] = NULL;
+    node->word_count = count;
+    return 0;
+}
+
+/**
+ * Parse segments from *i on into a list, up to the keyword end (done or })
+ * Returns 0 on success, -1 on a syntax error
+ */
+static int parse_list(char **segments, int count, int *i, const char *end, Node **list) {
+    Node **tail = list;
+    char *rest;
+    size_t header;
+    size_t name_len;
+
+    *list = NULL;
+    while (*i < count) {
+        char *segment = segments[*i];
+        Node *node;
+
+        if (*segment == '\0') {
+            (*i)++;
+            continue;
+        }
+        if (after_keyword(segment, "done") || after_keyword(segment, "}")) {
+            return end && after_keyword(segment, end) ? 0 : -1;
+        }
+        if (after_keyword(segment, "do")) {
+            return -1;
+        }
+
+        node = (Node*)calloc(1, sizeof(Node));
+        if (!node) {
+            return -1;
+        }
+        *tail = node;
+        tail = &node->next;
+
+        if ((header = function_header(segment, &name_len)) > 0) {
+            Function *fn = (Function*)calloc(1, sizeof(Function));
+
+            node->type = NODE_FUNCTION;
+            node->function = fn;
+            if (!fn || !(fn->name = (char*)malloc(name_len + 1))) {
+                return -1;
+            }
+            fn->refs = 1;
+            memcpy(fn->name, segment, name_len);
+            fn->name[name_len] = '\0';
+
+            /* The body may start right after { */
+            segments[*i] = trim_whitespace(segment + header);
+            if (parse_list(segments, count, i, "}", &fn->body) != 0 || *i >= count) {
+                return -1;
+            }
+            if (*after_keyword(segments[(*i)++], "}") != '\0') {
+                return -1;
+            }
+            continue;
+        }
+
+        if (!(rest = after_keyword(segment, "while"))) {
+            node->type = NODE_COMMAND;
+            if (set_command(node, segment) != 0) {
+                return -1;
+            }
+            (*i)++;
+            continue;
+        }
+
+        node->type = NODE_WHILE;
+        if (*rest == '\0' || set_command(node, rest) != 0 ||
+            ++(*i) >= count || !(rest = after_keyword(segments[*i], "do"))) {
+            return -1;
+        }
+
+        /* The body may start right after do */
+        segments[*i] = rest;
+        if (parse_list(segments, count, i, "done", &node->body) != 0 || *i >= count) {
+            return -1;
+        }
+
+        rest = after_keyword(segments[(*i)++], "done");
+        if (*rest == '<') {
+            node->input_file = strdup(trim_whitespace(rest + 1));
+        } else if (*rest != '\0') {
+            return -1;
+        }
+    }
+    return end ? -1 : 0;
+}
+
+/**
+ * Point target (standard input or output) at file
+ * Returns a copy of the old descriptor for restore_fd(), -1 on failure
+ */
+static int redirect_fd(const char *file, int flags, int target) {
+    int saved;
+    int fd;
+
+    #ifndef _WIN32
+    flags |= O_CLOEXEC;
+    #endif
+    fd = open(file, flags, 0644);
+
+    if (fd < 0) {
+        print_error(target == STDIN_FILENO ? "Failed to open input file" : "Failed to open output file");
+        return -1;
+    }
+    out_flush();
+    #ifdef _WIN32
+    saved = dup(target);
+    #else
+    saved = fcntl(target, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+    #endif
+    dup2(fd, target);
+    close(fd);
+    read_reset();
+    return saved;
+}
+
+static void restore_fd(int saved, int target) {
+    if (saved >= 0) {
+        out_flush();
+        read_reset();
+        dup2(saved, target);
+        close(saved);
+    }
+}
+
+static int run_command(Node *node, int *exit_requested) {
+    if (node->text) {
+        return execute_simple(node->text, exit_requested);
+    }
+    return execute_words(node->words, node->word_count, exit_requested);
+}
+
+static int run_list(Node *node, int *exit_requested);
+
+/**
+ * Run a while loop; returns the status of the last body command
+ */
+static int run_while(Node *node, int *exit_requested) {
+    int saved_in = -1;
+    int status = 0;
+
+    if (node->input_file && (saved_in = redirect_fd(node->input_file, O_RDONLY, STDIN_FILENO)) < 0) {
+        return 1;
+    }
+
+    while (!*exit_requested && !g_interrupted && !g_returning) {
+        g_last_exit_status = run_command(node, exit_requested);
+        if (g_last_exit_status != 0 || *exit_requested || g_interrupted || g_returning) {
+            break;
+        }
+        status = run_list(node->body, exit_requested);
+        if (status == 128 + SIGINT) {
+            break;
+        }
+    }
+
+    restore_fd(saved_in, STDIN_FILENO);
+    return status;
+}
+
+static int run_list(Node *node, int *exit_requested) {
+    int status = g_last_exit_status;
+
+    for (; node && !*exit_requested && !g_interrupted && !g_returning; node = node->next) {
+        if (node->type == NODE_WHILE) {
+            status = run_while(node, exit_requested);
+        } else if (node->type == NODE_FUNCTION) {
+            define_function(node->function);
+            status = 0;
+        } else {
+            status = run_command(node, exit_requested);
+        }
+        g_last_exit_status = status;
+    }
+    return status;
+}
+
+/**
+ * Run the function named by the first word of cmd, with the others as $1...
+ */
+int call_function(Command *cmd, int *exit_requested) {
+    Function *fn = *function_link(cmd->tokens[0]);
+    char **args = cmd->tokens + 1;
+    int count = cmd->token_count - 1;
+    int saved_in = -1;
+    int saved_out = -1;
+    RedirectSave save;
+    int status;
+
+    if (g_call_depth >= MAX_CALL_DEPTH) {
+        print_error("Function calls nested too deeply");
+        return 1;
+    }
+    if (cmd->input_file && (saved_in = redirect_fd(cmd->input_file, O_RDONLY, STDIN_FILENO)) < 0) {
+        return 1;
+    }
+    if (cmd->output_file) {
+        int flags = O_WRONLY | O_CREAT | (cmd->append_output ? O_APPEND : O_TRUNC);
+        if ((saved_out = redirect_fd(cmd->output_file, flags, STDOUT_FILENO)) < 0) {
+            restore_fd(saved_in, STDIN_FILENO);
+            return 1;
+        }
+    }
+
+    if (redirect_push(cmd, &save, 0) != 0) {
+        restore_fd(saved_out, STDOUT_FILENO);
+        restore_fd(saved_in, STDIN_FILENO);
+        return 1;
+    }
+
+    /* Redefining the function while it runs must not free it */
+    fn->refs++;
+    g_call_depth++;
+    var_swap_args(&args, &count);
+    status = run_list(fn->body, exit_requested);
+    var_swap_args(&args, &count);
+    g_call_depth--;
+    release_function(fn);
+
+    if (g_returning) {
+        g_returning = 0;
+        status = g_return_status;
+    }
+
+    redirect_pop(&save);
+    restore_fd(saved_out, STDOUT_FILENO);
+    restore_fd(saved_in, STDIN_FILENO);
+    return status;
+}
+
+/**
+ * return [N]
+ */
+int builtin_return(char **args) {
+    if (g_call_depth == 0) {
+        print_error("return: not in a function");
+        return 1;
+    }
+    g_return_status = args[1] ? atoi(args[1]) : g_last_exit_status;
+    g_returning = 1;
+    return g_return_status;
+}
+
+/**
+ * Parse and run one command line
+ * Sets *exit_requested when the line ran the exit built-in
+ */
+int execute_line(char *input, int *exit_requested) {
+    char *copy;
+    char *segments[MAX_NUM_TOKENS];
+    int count = 0;
+    int i = 0;
+    Node *list;
+    int status;
+
+    *exit_requested = 0;
+
+    /* A plain command needs no tree */
+    if (!strchr(input, ';') && !after_keyword(trim_whitespace(input), "while") &&
+        !is_function_definition(trim_whitespace(input))) {
+        return execute_simple(input, exit_requested);
+    }
+
+    copy = strdup(input);
+    if (!copy) {
+        print_error("Failed to parse command");
+        return -1;
+    }
+    for (char *p = copy; p && count < MAX_NUM_TOKENS; count++) {
+        char *semi = strchr(p, ';');
+        if (semi) *semi = '\0';
+        segments[count] = trim_whitespace(p);
+        p = semi ? semi + 1 : NULL;
+    }
+
+    if (parse_list(segments, count, &i, NULL, &list) != 0) {
+        print_error("Syntax error: expected while COMMAND; do COMMANDS; done or NAME() { COMMANDS; }");
+        free_nodes(list);
+        free(copy);
+        return -1;
+    }
+
+    status = run_list(list, exit_requested);
+    free_nodes(list);
+    free(copy);
+    return status;
+}
@@ -0,0 +1,417 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+/*
+ * Command server mode (mini-shell --server /path.sock)
+ *
+ * Every connection is served by its own forked shell process, so each client
+ * keeps a private cwd and environment across commands. Clients send command
+ * lines terminated by '\n'. For every line the server streams back frames:
+ *
+ *   +------+----------------+-----------------+
+ *   | type | length (u32 BE) | payload         |
+ *   +------+----------------+-----------------+
+ *
+ * FRAME_STDOUT and FRAME_STDERR frames carry output as it is produced, and a
+ * final FRAME_EXIT frame carries the exit status as a big-endian int32.
+ */
+
+#define RELAY_BUFFER_SIZE (64 * 1024)
+#define SERVER_BACKLOG 128
+
+static volatile sig_atomic_t g_server_stop = 0;
+
+/* Output relay running next to the command being executed */
+typedef struct {
+    int sock;
+    int out_fd;         /* read end of the command's stdout pipe */
+    int err_fd;         /* read end of the command's stderr pipe */
+    int stop_fd;        /* becomes readable when the command returned */
+} OutputRelay;
+
+static void handle_server_stop(int sig) {
+    (void)sig;
+    g_server_stop = 1;
+}
+
+/**
+ * Reap finished connection processes; the server has no job table and no
+ * signal pipe, so unlike the interactive handler this one waits itself
+ */
+static void handle_server_child(int sig) {
+    int saved_errno = errno;
+
+    (void)sig;
+    while (waitpid(-1, NULL, WNOHANG) > 0) {
+        continue;
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Send one frame; returns -1 when the client went away
+ */
+static int send_frame(int sock, char type, const char *payload, uint32_t len) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t total = FRAME_HEADER_SIZE + len;
+    size_t sent = 0;
+
+    header[0] = (unsigned char)type;
+    header[1] = (unsigned char)(len >> 24);
+    header[2] = (unsigned char)(len >> 16);
+    header[3] = (unsigned char)(len >> 8);
+    header[4] = (unsigned char)len;
+
+    while (sent < total) {
+        memset(&msg, 0, sizeof(msg));
+        if (sent < FRAME_HEADER_SIZE) {
+            iov[0].iov_base = header + sent;
+            iov[0].iov_len = FRAME_HEADER_SIZE - sent;
+            iov[1].iov_base = (void*)payload;
+            iov[1].iov_len = len;
+            msg.msg_iovlen = len > 0 ? 2 : 1;
+        } else {
+            iov[0].iov_base = (void*)(payload + (sent - FRAME_HEADER_SIZE));
+            iov[0].iov_len = total - sent;
+            msg.msg_iovlen = 1;
+        }
+        msg.msg_iov = iov;
+
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Forward what is readable on fd as one frame
+ * Returns 1 after forwarding data, 2 when nothing is available, 0 at EOF
+ */
+static int relay_fd(OutputRelay *relay, int fd, char type, char *buf) {
+    ssize_t n;
+
+    do {
+        n = read(fd, buf, RELAY_BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+        send_frame(relay->sock, type, buf, (uint32_t)n);
+        return 1;
+    }
+    if (n < 0 && errno == EAGAIN) {
+        return 2;
+    }
+    return 0;
+}
+
+/**
+ * Relay thread: streams stdout/stderr of the running command to the client
+ */
+static void* relay_output(void *arg) {
+    OutputRelay *relay = (OutputRelay*)arg;
+    char *buf = (char*)malloc(RELAY_BUFFER_SIZE);
+    int out_open = 1;
+    int err_open = 1;
+
+    if (!buf) {
+        return NULL;
+    }
+
+    while (out_open || err_open) {
+        struct pollfd pfd[3] = {
+            {out_open ? relay->out_fd : -1, POLLIN, 0},
+            {err_open ? relay->err_fd : -1, POLLIN, 0},
+            {relay->stop_fd, POLLIN, 0}
+        };
+
+        if (poll(pfd, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd[0].revents) out_open = relay_fd(relay, relay->out_fd, FRAME_STDOUT, buf);
+        if (pfd[1].revents) err_open = relay_fd(relay, relay->err_fd, FRAME_STDERR, buf);
+
+        if (pfd[2].revents) {
+            /* Command finished: drain what is buffered, leave background jobs */
+            fcntl(relay->out_fd, F_SETFL, O_NONBLOCK);
+            fcntl(relay->err_fd, F_SETFL, O_NONBLOCK);
+            while (out_open && relay_fd(relay, relay->out_fd, FRAME_STDOUT, buf) == 1) {
+                continue;
+            }
+            while (err_open && relay_fd(relay, relay->err_fd, FRAME_STDERR, buf) == 1) {
+                continue;
+            }
+            break;
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+/**
+ * Run one command line with stdout/stderr streamed to the client
+ */
+static int serve_command(int sock, char *line, int *exit_requested) {
+    int out_pipe[2], err_pipe[2], stop_pipe[2];
+    int saved_out, saved_err;
+    pthread_t thread;
+    OutputRelay relay;
+    int relaying;
+    int status;
+
+    if (pipe2(out_pipe, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    if (pipe2(err_pipe, O_CLOEXEC) != 0) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return -1;
+    }
+    if (pipe2(stop_pipe, O_CLOEXEC) != 0) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        close(err_pipe[0]);
+        close(err_pipe[1]);
+        return -1;
+    }
+
+    relay.sock = sock;
+    relay.out_fd = out_pipe[0];
+    relay.err_fd = err_pipe[0];
+    relay.stop_fd = stop_pipe[0];
+
+    /* Point this process's stdout/stderr at the pipes while the line runs */
+    fflush(stdout);
+    fflush(stderr);
+    saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+    saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+    dup2(out_pipe[1], STDOUT_FILENO);
+    dup2(err_pipe[1], STDERR_FILENO);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+
+    relaying = pthread_create(&thread, NULL, relay_output, &relay) == 0;
+    if (relaying) {
+        status = execute_line(line, exit_requested);
+        out_flush();
+
+        /* Nothing else collects background jobs here: SIGCHLD is default */
+        jobs_update();
+        jobs_report();
+        fflush(stdout);
+        fflush(stderr);
+    } else {
+        status = -1;
+        *exit_requested = 1;
+    }
+
+    /* Restore the real descriptors; this closes our pipe write ends */
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+
+    if (relaying) {
+        if (write(stop_pipe[1], "", 1) < 0) {
+            /* Relay exits on EOF anyway */
+        }
+        pthread_join(thread, NULL);
+    }
+
+    close(out_pipe[0]);
+    close(err_pipe[0]);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+
+    return status;
+}
+
+/**
+ * Serve one client until it disconnects or runs exit
+ */
+static void serve_connection(int sock) {
+    char *buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    int exit_requested = 0;
+
+    /* Commands must not read from the socket */
+    int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        close(devnull);
+    }
+
+    while (!exit_requested) {
+        char *newline;
+
+        /* Run every complete line already received */
+        while (!exit_requested && buf && (newline = memchr(buf, '\n', len)) != NULL) {
+            size_t line_len = (size_t)(newline - buf);
+            unsigned char status_be[4];
+            int status;
+
+            *newline = '\0';
+            if (line_len > 0 && buf[line_len - 1] == '\r') {
+                buf[line_len - 1] = '\0';
+            }
+
+            if (is_empty_line(buf)) {
+                status = 0;
+            } else {
+                status = serve_command(sock, buf, &exit_requested);
+                g_last_exit_status = status;
+            }
+
+            status_be[0] = (unsigned char)((uint32_t)status >> 24);
+            status_be[1] = (unsigned char)((uint32_t)status >> 16);
+            status_be[2] = (unsigned char)((uint32_t)status >> 8);
+            status_be[3] = (unsigned char)status;
+            if (send_frame(sock, FRAME_EXIT, (const char*)status_be, 4) != 0) {
+                exit_requested = 1;
+            }
+
+            len -= line_len + 1;
+            memmove(buf, newline + 1, len);
+        }
+        if (exit_requested) {
+            break;
+        }
+
+        if (cap - len < 4096) {
+            cap = cap ? cap * 2 : 8192;
+            char *grown = (char*)realloc(buf, cap);
+            if (!grown) {
+                break;
+            }
+            buf = grown;
+        }
+
+        ssize_t n = read(sock, buf + len, cap - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+    }
+
+    free(buf);
+}
+
+/**
+ * Accept clients on a Unix domain socket, one shell process per connection
+ */
+int run_server(const char *socket_path) {
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    int listen_fd;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        print_error("Socket path too long");
+        return 1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        print_error("Failed to create socket");
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+
+    /* Only the owner may submit commands */
+    mode_t old_mask = umask(077);
+    int rc = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(old_mask);
+
+    if (rc != 0 || listen(listen_fd, SERVER_BACKLOG) != 0) {
+        print_error("Failed to listen on socket");
+        close(listen_fd);
+        return 1;
+    }
+
+    /* Reap connection processes; stop cleanly on SIGINT/SIGTERM */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_server_child;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    sa.sa_handler = handle_server_stop;
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "mini-shell: serving on %s\n", socket_path);
+
+    while (!g_server_stop) {
+        int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            print_error("Failed to accept connection");
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            /* Connection process: a private shell context */
+            close(listen_fd);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGPIPE, SIG_DFL);
+
+            g_history = init_history();
+            update_cwd_cache();
+            serve_connection(conn);
+
+            close(conn);
+            free_history(g_history);
+            _exit(0);
+        }
+        if (pid < 0) {
+            print_error("Failed to fork connection handler");
+        }
+        close(conn);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
+
+#else
+
+int run_server(const char *socket_path) {
+    print_error("Server mode is not supported on Windows");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sched.h>
+#include <termios.h>
+#include <sys/resource.h>
+#endif
+
+/*
+ * Attributes of spawned commands
+ *
+ * Settings made with builtins such as ulimit, taskset or nice do not touch
+ * the shell itself; they are collected here and applied in each child
+ * between fork and exec, whether the child is forked by the shell, by pmap
+ * or by the zygote.
+ */
+
+static SpawnAttr g_spawn_attr;
+
+/**
+ * Replace all attributes, e.g. to undo a one-command change
+ */
+void spawn_attr_restore(const SpawnAttr *attr) {
+    g_spawn_attr = *attr;
+}
+
+/**
+ * Run spawned commands on the CPUs set in cpus, or anywhere with NULL
+ */
+void spawn_set_cpus(const uint64_t *cpus) {
+    if (!cpus) {
+        g_spawn_attr.cpus_set = 0;
+        return;
+    }
+    memcpy(g_spawn_attr.cpus, cpus, sizeof(g_spawn_attr.cpus));
+    g_spawn_attr.cpus_set = 1;
+}
+
+#ifndef _WIN32
+
+static const int spawn_resources[SPAWN_LIMIT_COUNT] = {
+    RLIMIT_CPU, RLIMIT_AS, RLIMIT_NOFILE, RLIMIT_NPROC
+};
+
+static int g_policy = SPAWN_POLICY_OFF;
+static int g_policy_nice;
+static int g_last_cpu = -1;             /* CPU of the last placed job */
+static int g_shell_cpu = -1;            /* CPU reserved for the shell, if pinned */
+static cpu_set_t g_shell_cpus;          /* the shell's CPUs before pinning */
+
+static int clamp_nice(int value) {
+    return value < -20 ? -20 : value > 19 ? 19 : value;
+}
+
+/**
+ * Niceness of the shell plus increment, within the valid range
+ */
+static int nice_from_shell(int increment, int *value) {
+    int base;
+
+    errno = 0;
+    base = getpriority(PRIO_PROCESS, 0);
+    if (base == -1 && errno != 0) {
+        return -1;
+    }
+    *value = clamp_nice(base + increment);
+    return 0;
+}
+
+static rlim_t to_rlim(uint64_t value) {
+    return value == SPAWN_LIMIT_UNLIMITED ? RLIM_INFINITY : (rlim_t)value;
+}
+
+static uint64_t from_rlim(rlim_t value) {
+    return value == RLIM_INFINITY ? SPAWN_LIMIT_UNLIMITED : (uint64_t)value;
+}
+
+/**
+ * Limit a resource for commands started from now on
+ * soft/hard select which limit is changed; both when neither is set
+ * Returns -1 (errno EPERM) when the hard limit would have to be raised
+ */
+int spawn_limit_set(int which, int soft, int hard, uint64_t value) {
+    struct rlimit current;
+
+    if (which < 0 || which >= SPAWN_LIMIT_COUNT) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!soft && !hard) {
+        soft = hard = 1;
+    }
+
+    /* Children cannot go beyond what the shell may raise itself */
+    if (getrlimit(spawn_resources[which], &current) == 0 && current.rlim_max != RLIM_INFINITY &&
+        (value == SPAWN_LIMIT_UNLIMITED || value > (uint64_t)current.rlim_max)) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if (soft) {
+        g_spawn_attr.limit_soft_set[which] = 1;
+        g_spawn_attr.limit_soft[which] = value;
+    }
+    if (hard) {
+        g_spawn_attr.limit_hard_set[which] = 1;
+        g_spawn_attr.limit_hard[which] = value;
+    }
+    return 0;
+}
+
+/**
+ * Limit that spawned commands get: the configured one, else the shell's own
+ */
+int spawn_limit_get(int which, int hard, uint64_t *value) {
+    struct rlimit current;
+
+    if (which < 0 || which >= SPAWN_LIMIT_COUNT) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (hard && g_spawn_attr.limit_hard_set[which]) {
+        *value = g_spawn_attr.limit_hard[which];
+        return 0;
+    }
+    if (!hard && g_spawn_attr.limit_soft_set[which]) {
+        *value = g_spawn_attr.limit_soft[which];
+        return 0;
+    }
+
+    if (getrlimit(spawn_resources[which], &current) != 0) {
+        return -1;
+    }
+    *value = from_rlim(hard ? current.rlim_max : current.rlim_cur);
+    return 0;
+}
+
+/**
+ * Run spawned commands at the shell's niceness plus increment
+ */
+int spawn_set_nice(int increment) {
+    int value;
+
+    if (nice_from_shell(increment, &value) != 0) {
+        return -1;
+    }
+    g_spawn_attr.nice = value;
+    g_spawn_attr.nice_set = 1;
+    return 0;
+}
+
+/**
+ * Keep the shell on one of its CPUs, the one it is on if possible, so
+ * placed jobs can stay off it; nothing is reserved with a single CPU
+ */
+static void pin_shell(void) {
+    cpu_set_t one;
+    int cpu;
+
+    if (sched_getaffinity(0, sizeof(g_shell_cpus), &g_shell_cpus) != 0 ||
+        CPU_COUNT(&g_shell_cpus) < 2) {
+        return;
+    }
+
+    cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &g_shell_cpus)) {
+        for (cpu = 0; cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &g_shell_cpus); cpu++) {
+            continue;
+        }
+    }
+
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    if (sched_setaffinity(0, sizeof(one), &one) == 0) {
+        g_shell_cpu = cpu;
+    }
+}
+
+/**
+ * Choose how jobs are placed; increment is the niceness of placed jobs
+ * Spreading pins the shell to a reserved CPU, turning it off undoes that
+ */
+int spawn_set_policy(int policy, int increment) {
+    if (policy != SPAWN_POLICY_OFF && policy != SPAWN_POLICY_SPREAD) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (policy == SPAWN_POLICY_SPREAD && g_shell_cpu < 0) {
+        pin_shell();
+    } else if (policy == SPAWN_POLICY_OFF && g_shell_cpu >= 0) {
+        sched_setaffinity(0, sizeof(g_shell_cpus), &g_shell_cpus);
+        g_shell_cpu = -1;
+    }
+    g_policy = policy;
+    g_policy_nice = increment;
+    g_last_cpu = -1;
+    return 0;
+}
+
+int spawn_get_policy(int *increment) {
+    *increment = g_policy_nice;
+    return g_policy;
+}
+
+/**
+ * Adjust the attributes of one job to the placement policy
+ * Background jobs go round-robin to the CPUs the shell may use, skipping
+ * the one reserved for the shell, so they do not slow down the prompt
+ */
+void spawn_attr_job(SpawnAttr *attr, int background) {
+    cpu_set_t allowed;
+
+    if (g_policy != SPAWN_POLICY_SPREAD || !background) {
+        return;
+    }
+
+    if (!attr->nice_set && nice_from_shell(g_policy_nice, &attr->nice) == 0) {
+        attr->nice_set = 1;
+    }
+
+    if (g_shell_cpu >= 0) {
+        allowed = g_shell_cpus;
+    } else if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    if (attr->cpus_set) {
+        /* Stay within a CPU set chosen with taskset */
+        for (int cpu = 0; cpu < SPAWN_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (!(attr->cpus[cpu / 64] >> (cpu % 64) & 1)) {
+                CPU_CLR(cpu, &allowed);
+            }
+        }
+    }
+
+    if (CPU_COUNT(&allowed) < 2 && g_shell_cpu >= 0 && CPU_ISSET(g_shell_cpu, &allowed)) {
+        return;
+    }
+
+    for (int i = 1; i <= SPAWN_MAX_CPUS; i++) {
+        int cpu = (g_last_cpu + i) % SPAWN_MAX_CPUS;
+
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) && cpu != g_shell_cpu) {
+            memset(attr->cpus, 0, sizeof(attr->cpus));
+            attr->cpus[cpu / 64] = (uint64_t)1 << (cpu % 64);
+            attr->cpus_set = 1;
+            g_last_cpu = cpu;
+            return;
+        }
+    }
+}
+
+/**
+ * Apply attributes in a freshly forked child
+ */
+int spawn_attr_apply(const SpawnAttr *attr) {
+    int rc = 0;
+
+    if (!attr) {
+        return 0;
+    }
+
+    if (attr->new_pgrp && setpgid(0, 0) != 0) {
+        rc = -1;
+    }
+    if (attr->new_pgrp && attr->foreground) {
+        /* Take the terminal before exec, so the command cannot read it
+           while still in the background; SIGTTOU would stop us here */
+        int tty = open("/dev/tty", O_RDWR | O_CLOEXEC);
+        sigset_t ttou, old_mask;
+
+        sigemptyset(&ttou);
+        sigaddset(&ttou, SIGTTOU);
+        sigprocmask(SIG_BLOCK, &ttou, &old_mask);
+        if (tty >= 0) {
+            tcsetpgrp(tty, getpid());
+            close(tty);
+        }
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    }
+
+    for (int i = 0; i < SPAWN_LIMIT_COUNT; i++) {
+        struct rlimit limit;
+
+        if (!attr->limit_soft_set[i] && !attr->limit_hard_set[i]) {
+            continue;
+        }
+        if (getrlimit(spawn_resources[i], &limit) != 0) {
+            rc = -1;
+            continue;
+        }
+        if (attr->limit_hard_set[i]) {
+            limit.rlim_max = to_rlim(attr->limit_hard[i]);
+        }
+        if (attr->limit_soft_set[i]) {
+            limit.rlim_cur = to_rlim(attr->limit_soft[i]);
+        }
+
+        /* A lowered hard limit also caps the soft one */
+        if (limit.rlim_max != RLIM_INFINITY &&
+            (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > limit.rlim_max)) {
+            limit.rlim_cur = limit.rlim_max;
+        }
+        if (setrlimit(spawn_resources[i], &limit) != 0) {
+            rc = -1;
+        }
+    }
+
+    if (attr->cpus_set) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < SPAWN_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (attr->cpus[cpu / 64] >> (cpu % 64) & 1) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            rc = -1;
+        }
+    } else if (g_shell_cpu >= 0) {
+        /* Not the shell's reserved CPU: give back what it had */
+        if (sched_setaffinity(0, sizeof(g_shell_cpus), &g_shell_cpus) != 0) {
+            rc = -1;
+        }
+    }
+    if (attr->nice_set && setpriority(PRIO_PROCESS, 0, attr->nice) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+#else
+
+int spawn_limit_set(int which, int soft, int hard, uint64_t value) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int spawn_limit_get(int which, int hard, uint64_t *value) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int spawn_attr_apply(const SpawnAttr *attr) {
+    return 0;
+}
+
+int spawn_set_nice(int increment) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int spawn_set_policy(int policy, int increment) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int spawn_get_policy(int *increment) {
+    *increment = 0;
+    return SPAWN_POLICY_OFF;
+}
+
+void spawn_attr_job(SpawnAttr *attr, int background) {
+}
+
+#endif
+
+/**
+ * Attributes for the next spawned command
+ */
+void spawn_attr_current(SpawnAttr *attr) {
+    *attr = g_spawn_attr;
+}
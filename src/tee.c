@@ -0,0 +1,321 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <fcntl.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+/*
+ * Output fan-out: one stream copied to several descriptors
+ *
+ * Used by the tee builtin and by commands with more than one > / >> target
+ * ("cmd > a > b >> c"). The stream lives in a pipe; every target but the
+ * last gets its bytes through tee(2) into a private side pipe and splice(2)
+ * from there, and the last target splices straight out of the input pipe,
+ * which consumes the data. Targets splice() cannot write to (terminals on
+ * newer kernels) fall back to a buffered copy.
+ */
+
+#define FANOUT_PIPE_SIZE (1024 * 1024)
+#define FANOUT_COPY_SIZE (64 * 1024)
+
+/**
+ * Open every output target of a command, first output_file then tee_files
+ * Returns the number of descriptors stored in fds, or -1 after an error
+ */
+int open_output_targets(Command *cmd, int *fds) {
+    int count = 0;
+
+    for (int i = -1; i < cmd->tee_count; i++) {
+        const char *path = i < 0 ? cmd->output_file : cmd->tee_files[i];
+        int append = i < 0 ? cmd->append_output : cmd->tee_append[i];
+        int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+
+        if (!path) continue;
+        #ifndef _WIN32
+        flags |= O_CLOEXEC;
+        #endif
+
+        fds[count] = open(path, flags, 0644);
+        if (fds[count] < 0) {
+            print_error("Failed to open output file");
+            while (count > 0) close(fds[--count]);
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+#ifndef _WIN32
+
+typedef struct {
+    int fd;
+    int side[2];        /* duplicate of the stream for this target */
+    int copy;           /* splice() not supported by this target */
+    int failed;         /* write error: discard its data */
+} FanTarget;
+
+static int g_devnull = -1;
+
+/**
+ * Move len bytes out of a pipe into a target; returns the bytes moved,
+ * short only at end of input or, with once set, after the first transfer
+ */
+static size_t move_bytes(int from, FanTarget *t, size_t len, int once) {
+    char buf[FANOUT_COPY_SIZE];
+    size_t moved = 0;
+
+    while (len > 0) {
+        ssize_t n;
+
+        if (t->failed) {
+            n = splice(from, NULL, g_devnull, NULL, len, SPLICE_F_MOVE);
+        } else if (!t->copy) {
+            n = splice(from, NULL, t->fd, NULL, len, SPLICE_F_MOVE);
+            if (n < 0 && errno == EINVAL) {
+                t->copy = 1;
+                continue;
+            }
+        } else {
+            n = read(from, buf, len < sizeof(buf) ? len : sizeof(buf));
+            for (ssize_t done = 0; n > 0 && done < n; ) {
+                ssize_t w = write(t->fd, buf + done, (size_t)(n - done));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) {
+                    t->failed = 1;
+                    break;
+                }
+                done += w;
+            }
+        }
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && !t->failed) {
+            t->failed = 1;
+            continue;
+        }
+        if (n <= 0) break;
+        len -= (size_t)n;
+        moved += (size_t)n;
+        if (once) break;
+    }
+    return moved;
+}
+
+/**
+ * Duplicate up to max bytes at the head of pipe in to every target;
+ * exact means the pipe holds max bytes that must all be handed out
+ * Returns the number of bytes handed out, 0 at end of input
+ */
+static ssize_t fan_round(int in, FanTarget *targets, int count, size_t max, int exact) {
+    ssize_t got[MAX_TEE_FILES + 2];
+    ssize_t m = -1;
+
+    /* Duplicate into the side pipes without consuming the input */
+    for (int i = 0; i < count - 1; i++) {
+        do {
+            got[i] = tee(in, targets[i].side[1], max, 0);
+        } while (got[i] < 0 && errno == EINTR);
+
+        if (got[i] <= 0) {
+            return got[i];
+        }
+        if (m < 0 || got[i] < m) m = got[i];
+    }
+    if (m < 0) {
+        /* Single target: pass on whatever is there */
+        return (ssize_t)move_bytes(in, &targets[0], max, !exact);
+    }
+
+    /* Everyone takes m; a side pipe that got more drops the excess,
+       which the next round duplicates again */
+    for (int i = 0; i < count - 1; i++) {
+        move_bytes(targets[i].side[0], &targets[i], (size_t)m, 0);
+        if (got[i] > m) {
+            splice(targets[i].side[0], NULL, g_devnull, NULL, (size_t)(got[i] - m), 0);
+        }
+    }
+    return (ssize_t)move_bytes(in, &targets[count - 1], (size_t)m, 0);
+}
+
+/**
+ * Copy everything readable from in_fd to every descriptor in fds
+ * A non-pipe input is first spliced into a private pipe
+ * Returns -1 when reading failed or any target could not be written; the
+ * other targets still get everything
+ */
+int fanout(int in_fd, const int *fds, int count) {
+    FanTarget targets[MAX_TEE_FILES + 2];
+    struct stat st;
+    int relay[2] = {-1, -1};
+    int in = in_fd;
+    int rc = 0;
+
+    if (count < 1 || count > MAX_TEE_FILES + 2) {
+        return -1;
+    }
+    if (g_devnull < 0) {
+        g_devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    }
+
+    for (int i = 0; i < count; i++) {
+        targets[i].fd = fds[i];
+        targets[i].side[0] = targets[i].side[1] = -1;
+        targets[i].copy = 0;
+        targets[i].failed = 0;
+        if (i < count - 1) {
+            if (pipe2(targets[i].side, O_CLOEXEC) != 0) {
+                rc = -1;
+                count = i;
+                break;
+            }
+            fcntl(targets[i].side[1], F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+        }
+    }
+
+    /* tee(2) needs a pipe on the input side */
+    int is_pipe = fstat(in_fd, &st) == 0 && S_ISFIFO(st.st_mode);
+    if (rc == 0 && !is_pipe) {
+        if (pipe2(relay, O_CLOEXEC) != 0) {
+            rc = -1;
+        } else {
+            fcntl(relay[1], F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+            in = relay[0];
+        }
+    } else if (rc == 0) {
+        fcntl(in_fd, F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+    }
+
+    while (rc == 0) {
+        ssize_t max = FANOUT_PIPE_SIZE;
+
+        if (!is_pipe) {
+            /* Fill the relay pipe; terminals and the like are copied */
+            max = splice(in_fd, NULL, relay[1], NULL, FANOUT_PIPE_SIZE, SPLICE_F_MOVE);
+            if (max < 0 && errno == EINVAL) {
+                char buf[FANOUT_COPY_SIZE];
+                max = read(in_fd, buf, sizeof(buf));
+                if (max > 0 && write(relay[1], buf, (size_t)max) != max) {
+                    max = -1;
+                }
+            }
+            if (max < 0 && errno == EINTR) continue;
+            if (max <= 0) {
+                rc = max < 0 ? -1 : 0;
+                break;
+            }
+        }
+
+        /* A relay pipe is emptied completely before it is refilled */
+        ssize_t n;
+        do {
+            n = fan_round(in, targets, count, (size_t)max, !is_pipe);
+            if (n > 0 && !is_pipe) max -= n;
+        } while ((n > 0 && !is_pipe && max > 0) || (n < 0 && errno == EINTR));
+
+        if (n <= 0) {
+            rc = n < 0 ? -1 : 0;
+            break;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (targets[i].failed) rc = -1;
+        if (targets[i].side[0] >= 0) close(targets[i].side[0]);
+        if (targets[i].side[1] >= 0) close(targets[i].side[1]);
+    }
+    if (relay[0] >= 0) {
+        close(relay[0]);
+        close(relay[1]);
+    }
+    return rc;
+}
+
+/**
+ * tee [-a] [file...]: copy standard input to the output and every file
+ */
+int builtin_tee(Command *cmd) {
+    char **args = cmd->tokens;
+    int fds[MAX_TEE_FILES + 2];
+    int append = 0;
+    int count = 0;
+    int in_fd = STDIN_FILENO;
+    int rc;
+    int i = 1;
+
+    if (args[i] && strcmp(args[i], "-a") == 0) {
+        append = 1;
+        i++;
+    }
+
+    out_flush();
+    fds[count++] = out_get_fd();
+
+    for (; args[i]; i++) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+
+        if (count == MAX_TEE_FILES + 2) {
+            print_error("tee: too many files");
+            rc = -1;
+            goto done;
+        }
+        fds[count] = open(args[i], flags, 0644);
+        if (fds[count] < 0) {
+            print_error("tee: failed to open output file");
+            rc = -1;
+            goto done;
+        }
+        count++;
+    }
+
+    if (cmd->input_file) {
+        in_fd = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+        if (in_fd < 0) {
+            print_error("Failed to open input file");
+            rc = -1;
+            goto done;
+        }
+    }
+
+    rc = fanout(in_fd, fds, count);
+    if (rc != 0) {
+        print_error("tee: write failed");
+    }
+
+    if (in_fd != STDIN_FILENO) {
+        close(in_fd);
+    }
+
+done:
+    /* fds[0] is the shell's output descriptor */
+    for (int j = 1; j < count; j++) {
+        close(fds[j]);
+    }
+    return rc;
+}
+
+#else
+
+int fanout(int in_fd, const int *fds, int count) {
+    char buf[4096];
+    int n;
+
+    while ((n = _read(in_fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < count; i++) {
+            _write(fds[i], buf, n);
+        }
+    }
+    return n < 0 ? -1 : 0;
+}
+
+int builtin_tee(Command *cmd) {
+    print_error("tee is not supported on Windows");
+    return -1;
+}
+
+#endif
@@ -1,43 +1,17 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
 #include "../include/shell.h"
 #include <ctype.h>
-
-/**
- * Print command prompt
- */
-void print_prompt(void) {
-    char cwd[MAX_PATH_SIZE];
-    char *display_path = cwd;
-
-    #ifdef _WIN32
-    char *home = getenv("USERPROFILE");
-    #else
-    char *home = getenv("HOME");
-    #endif
-
-    /* Get current directory */
-    if (getcwd(cwd, sizeof(cwd)) != NULL) {
-        /* Replace home directory with ~ */
-        if (home && strncmp(cwd, home, strlen(home)) == 0) {
-            static char short_path[MAX_PATH_SIZE];
-            snprintf(short_path, sizeof(short_path), "~%s", cwd + strlen(home));
-            display_path = short_path;
-        }
-    } else {
-        display_path = "???";
-    }
-
-    /* Print colorful prompt */
-    printf("%s[%smini-shell%s] %s%s%s\n",
-           COLOR_CYAN, COLOR_MAGENTA, COLOR_CYAN,
-           COLOR_BLUE, display_path, COLOR_RESET);
-    printf("%s$ %s", COLOR_GREEN, COLOR_RESET);
-    fflush(stdout);
-}
+#include <fcntl.h>
 
 /**
  * Print error message
  */
 void print_error(char *message) {
+    /* Keep errors ordered after output already produced */
+    out_flush();
     fprintf(stderr, "%s[ERROR]%s %s\n", COLOR_RED, COLOR_RESET, message);
 }
 
@@ -81,27 +55,62 @@ int is_empty_line(char *line) {
     return (strlen(trimmed) == 0);
 }
 
+#ifndef _WIN32
+/* Self-pipe: handlers only write the signal number, the main loop acts */
+static int g_signal_pipe[2] = {-1, -1};
+
+static void note_signal(int sig) {
+    int saved_errno = errno;
+    unsigned char c = (unsigned char)sig;
+
+    if (g_signal_pipe[1] >= 0 && write(g_signal_pipe[1], &c, 1) < 0) {
+        /* Pipe full: a wakeup is already pending */
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Read end of the signal self-pipe, for poll()
+ */
+int signal_fd(void) {
+    return g_signal_pipe[0];
+}
+
+/**
+ * Drain the self-pipe; returns 1 when SIGCHLD arrived since the last call
+ */
+int consume_signals(void) {
+    unsigned char buf[64];
+    int chld = 0;
+    ssize_t n;
+
+    while ((n = read(g_signal_pipe[0], buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == SIGCHLD) chld = 1;
+        }
+    }
+    return chld;
+}
+#endif
+
 /**
  * Signal handler for SIGINT (Ctrl+C)
+ * Async-signal-safe: only records the interrupt
  */
 void handle_sigint(int sig) {
     g_interrupted = 1;
-    printf("\n");
-    print_prompt();
-    fflush(stdout);
+    #ifndef _WIN32
+    note_signal(sig);
+    #endif
 }
 
 #ifndef _WIN32
 /**
- * Signal handler for SIGCHLD (child process termination) - POSIX only
+ * Signal handler for SIGCHLD - POSIX only
+ * Children are reaped by the job table, never from the handler
  */
 void handle_sigchld(int sig) {
-    /* Reap zombie processes */
-    int saved_errno = errno;
-    while (waitpid(-1, NULL, WNOHANG) > 0) {
-        continue;
-    }
-    errno = saved_errno;
+    note_signal(sig);
 }
 #endif
 
@@ -117,19 +126,26 @@ void setup_signal_handlers(void) {
     struct sigaction sa_int;
     struct sigaction sa_chld;
 
+    if (pipe(g_signal_pipe) == 0) {
+        for (int i = 0; i < 2; i++) {
+            fcntl(g_signal_pipe[i], F_SETFD, FD_CLOEXEC);
+            fcntl(g_signal_pipe[i], F_SETFL, O_NONBLOCK);
+        }
+    }
+
     /* Handle SIGINT (Ctrl+C) */
     sa_int.sa_handler = handle_sigint;
     sigemptyset(&sa_int.sa_mask);
     sa_int.sa_flags = SA_RESTART;
     sigaction(SIGINT, &sa_int, NULL);
 
-    /* Handle SIGCHLD (child process termination) */
+    /* Handle SIGCHLD (child exited or stopped) */
     sa_chld.sa_handler = handle_sigchld;
     sigemptyset(&sa_chld.sa_mask);
-    sa_chld.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sa_chld.sa_flags = SA_RESTART;
     sigaction(SIGCHLD, &sa_chld, NULL);
 
-    /* Ignore SIGTSTP (Ctrl+Z) for now */
+    /* Ctrl+Z stops jobs, never the shell */
     signal(SIGTSTP, SIG_IGN);
 
     /* Ignore SIGQUIT (Ctrl+\) */
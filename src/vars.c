@@ -0,0 +1,391 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+#include <ctype.h>
+
+/*
+ * Shell variables
+ *
+ * Variables set by assignments (NAME=value), read and mapfile live in a
+ * hash table of their own and are not passed to commands. Lookups fall back
+ * to the environment, and assigning to a name that is in the environment
+ * updates it there, so exported variables behave the same way.
+ * A variable may hold an array (mapfile); $NAME is its element 0.
+ * While a function runs, $1... are the words it was called with.
+ * Expansion is in expand.c.
+ */
+
+#define VAR_BUCKETS 256
+
+struct Var {
+    char *name;
+    char **items;           /* items[0] is the scalar value */
+    size_t count;
+    struct Var *next;
+};
+
+static Var *g_vars[VAR_BUCKETS];
+
+/* Bumped whenever an entry is freed, which invalidates handles */
+static unsigned long g_var_generation = 1;
+
+/* Positional parameters $1... of the running function */
+static char **g_args = NULL;
+static int g_arg_count = 0;
+
+static unsigned int var_hash(const char *name, size_t len) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h % VAR_BUCKETS;
+}
+
+static Var* var_find(const char *name, size_t len) {
+    for (Var *v = g_vars[var_hash(name, len)]; v; v = v->next) {
+        if (strncmp(v->name, name, len) == 0 && v->name[len] == '\0') {
+            return v;
+        }
+    }
+    return NULL;
+}
+
+static void var_clear(Var *v) {
+    for (size_t i = 0; i < v->count; i++) {
+        free(v->items[i]);
+    }
+    free(v->items);
+    v->items = NULL;
+    v->count = 0;
+}
+
+/**
+ * Check that name[0..len) is a valid variable name
+ */
+int valid_var_name(const char *name, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {
+        return 0;
+    }
+    for (size_t i = 1; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Find or create the table entry for a name
+ */
+static Var* var_entry(const char *name) {
+    size_t len = strlen(name);
+    Var *v = var_find(name, len);
+
+    if (v) {
+        return v;
+    }
+
+    v = (Var*)calloc(1, sizeof(Var));
+    if (!v || !(v->name = strdup(name))) {
+        free(v);
+        return NULL;
+    }
+    unsigned int h = var_hash(name, len);
+    v->next = g_vars[h];
+    g_vars[h] = v;
+    return v;
+}
+
+/**
+ * Give an entry a scalar value
+ */
+static int set_scalar(Var *v, const char *value) {
+    char *copy = strdup(value);
+
+    if (!copy) {
+        return -1;
+    }
+
+    /* Reuse the slot of a scalar */
+    if (v->count == 1) {
+        free(v->items[0]);
+        v->items[0] = copy;
+        return 0;
+    }
+
+    var_clear(v);
+    v->items = (char**)malloc(sizeof(char*));
+    if (!v->items) {
+        free(copy);
+        return -1;
+    }
+    v->items[0] = copy;
+    v->count = 1;
+    return 0;
+}
+
+/**
+ * Set a scalar variable; exported variables are updated in the environment
+ */
+int var_set(const char *name, const char *value) {
+    Var *v;
+
+    if (!valid_var_name(name, strlen(name))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Exported variables have no shell copy */
+    v = var_find(name, strlen(name));
+    if (!v && getenv(name)) {
+        #ifdef _WIN32
+        return _putenv_s(name, value) == 0 ? 0 : -1;
+        #else
+        return setenv(name, value, 1);
+        #endif
+    }
+
+    if (!v && !(v = var_entry(name))) {
+        return -1;
+    }
+    return set_scalar(v, value);
+}
+
+/**
+ * Handle to the table entry of name, created if needed, for repeated access
+ * NULL for exported variables, which live in the environment
+ * Handles stay valid while var_generation() is unchanged
+ */
+Var* var_resolve(const char *name) {
+    Var *v = var_find(name, strlen(name));
+
+    if (v || getenv(name) || !valid_var_name(name, strlen(name))) {
+        return v;
+    }
+    return var_entry(name);
+}
+
+unsigned long var_generation(void) {
+    return g_var_generation;
+}
+
+/**
+ * Scalar value behind a handle, NULL when unset
+ */
+const char* var_value(const Var *v) {
+    return v->count > 0 ? v->items[0] : NULL;
+}
+
+int var_assign(Var *v, const char *value) {
+    return set_scalar(v, value);
+}
+
+/**
+ * Make name an array; takes ownership of items and the strings in it
+ */
+int var_set_array(const char *name, char **items, size_t count) {
+    Var *v;
+
+    if (!valid_var_name(name, strlen(name)) || !(v = var_entry(name))) {
+        for (size_t i = 0; i < count; i++) free(items[i]);
+        free(items);
+        return -1;
+    }
+    var_clear(v);
+    v->items = items;
+    v->count = count;
+    return 0;
+}
+
+/**
+ * Value of a positional or special parameter: $0 $1... $# $@ $*
+ */
+static const char* special_param(const char *name, size_t len) {
+    static char count[16];
+    size_t index = 0;
+
+    if (len == 1 && name[0] == '#') {
+        snprintf(count, sizeof(count), "%d", g_arg_count);
+        return count;
+    }
+
+    if (len == 1 && (name[0] == '@' || name[0] == '*')) {
+        size_t total = 1;
+        char *joined;
+        char *p;
+
+        for (int i = 0; i < g_arg_count; i++) {
+            total += strlen(g_args[i]) + 1;
+        }
+        if (!(joined = p = (char*)arena_alloc(total))) {
+            return NULL;
+        }
+        for (int i = 0; i < g_arg_count; i++) {
+            size_t n = strlen(g_args[i]);
+            if (i > 0) *p++ = ' ';
+            memcpy(p, g_args[i], n);
+            p += n;
+        }
+        *p = '\0';
+        return joined;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (!isdigit((unsigned char)name[i])) {
+            return NULL;
+        }
+        index = index * 10 + (size_t)(name[i] - '0');
+        if (index > (size_t)g_arg_count) {
+            return NULL;
+        }
+    }
+    if (len == 0) {
+        return NULL;
+    }
+    return index == 0 ? "mini-shell" : g_args[index - 1];
+}
+
+/**
+ * Value of name[0..len), NULL when unset
+ */
+const char* var_lookup(const char *name, size_t len) {
+    Var *v;
+    char key[256];
+
+    if (len > 0 && !isalpha((unsigned char)name[0]) && name[0] != '_') {
+        return special_param(name, len);
+    }
+
+    v = var_find(name, len);
+    if (v) {
+        return var_value(v);
+    }
+    if (len >= sizeof(key)) {
+        return NULL;
+    }
+    memcpy(key, name, len);
+    key[len] = '\0';
+    return getenv(key);
+}
+
+const char* var_get(const char *name) {
+    return var_lookup(name, strlen(name));
+}
+
+/**
+ * Element index of an array (a scalar has one element), NULL past the end
+ */
+const char* var_get_item(const char *name, size_t len, size_t index) {
+    Var *v = var_find(name, len);
+
+    if (!v) {
+        return index == 0 ? var_lookup(name, len) : NULL;
+    }
+    return index < v->count ? v->items[index] : NULL;
+}
+
+/**
+ * Number of elements of an array, 1 for a set scalar, 0 when unset
+ */
+size_t var_item_count(const char *name, size_t len) {
+    Var *v = var_find(name, len);
+
+    if (v) {
+        return v->count;
+    }
+    return var_lookup(name, len) ? 1 : 0;
+}
+
+/**
+ * Install args[0..count) as the positional parameters $1...
+ * The previous ones come back through the same pointers, to be put back
+ */
+void var_swap_args(char ***args, int *count) {
+    char **items = g_args;
+    int n = g_arg_count;
+
+    g_args = *args;
+    g_arg_count = *count;
+    *args = items;
+    *count = n;
+}
+
+/**
+ * The positional parameters; returns their number
+ */
+int var_args(char ***args) {
+    *args = g_args;
+    return g_arg_count;
+}
+
+/**
+ * Forget the shell copy of name, e.g. after it was exported
+ */
+void var_forget(const char *name) {
+    size_t len = strlen(name);
+    Var **link = &g_vars[var_hash(name, len)];
+
+    while (*link) {
+        Var *v = *link;
+        if (strcmp(v->name, name) == 0) {
+            *link = v->next;
+            var_clear(v);
+            free(v->name);
+            free(v);
+            g_var_generation++;
+            return;
+        }
+        link = &v->next;
+    }
+}
+
+/**
+ * Remove a shell variable and its environment entry
+ */
+void var_unset(const char *name) {
+    var_forget(name);
+
+    #ifdef _WIN32
+    _putenv_s(name, "");
+    #else
+    unsetenv(name);
+    #endif
+}
+
+/**
+ * Check if a word has the form NAME=value
+ */
+int is_assignment(const char *word) {
+    const char *eq = strchr(word, '=');
+    return eq && (size_t)(eq - word) < 256 && valid_var_name(word, (size_t)(eq - word));
+}
+
+/**
+ * Perform the assignment NAME=value
+ */
+int assign_word(const char *word) {
+    const char *eq = strchr(word, '=');
+    char name[256];
+
+    memcpy(name, word, (size_t)(eq - word));
+    name[eq - word] = '\0';
+    return var_set(name, eq + 1);
+}
+
+/**
+ * Remove shell variables, or functions with -f
+ */
+int builtin_unset(char **args) {
+    int functions = args[1] && strcmp(args[1], "-f") == 0;
+
+    for (int i = 1 + functions; args[i]; i++) {
+        if (functions) {
+            unset_function(args[i]);
+        } else {
+            var_unset(args[i]);
+        }
+    }
+    return 0;
+}
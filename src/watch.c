@@ -0,0 +1,637 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#endif
+
+/*
+ * Re-running commands
+ *
+ *   on-change [-r] [-d MS] PATH... -- command [args]
+ *       Run command each time one of the files changes, or a file in one of
+ *       the directories (and, with -r, their subdirectories). The shell
+ *       sleeps in poll() on an inotify descriptor, so nothing runs between
+ *       changes. A burst of events, such as an editor's write-rename-chmod
+ *       or a checkout, is waited out until MS milliseconds (100 by default)
+ *       pass without one, and then runs the command once. Changes made while
+ *       the command runs, its own output included, do not trigger it again.
+ *       A file that is replaced rather than rewritten is watched again.
+ *
+ *   watch [-n S] command [args]
+ *       Run command every S seconds (2 by default) and show its output. On
+ *       a terminal only the lines that differ from the last run are
+ *       redrawn, each frame in a single write; elsewhere the output is
+ *       printed again whenever it changes.
+ *
+ * Both run until Ctrl-C, and the command until it is interrupted too. The
+ * command may also be an alias, function or builtin, which runs in the
+ * shell with its output carried to the same place.
+ */
+
+#define WATCH_DEBOUNCE_MS 100
+#define WATCH_MAX_WATCHES 4096
+#define WATCH_FILE_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+#define WATCH_DIR_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+#ifndef _WIN32
+
+typedef struct {
+    int wd;                 /* -1 once the kernel dropped it */
+    char *path;
+} Watch;
+
+typedef struct {
+    int fd;
+    int recursive;
+    Watch *watches;
+    int count;
+    int lost;               /* watches to add again */
+} Watcher;
+
+/**
+ * Watch path; with -r, directories below it too
+ */
+static int add_watch(Watcher *w, const char *path, int top) {
+    struct stat st;
+    int is_dir;
+    int wd;
+
+    if (stat(path, &st) != 0) {
+        if (top) print_error("on-change: no such file or directory");
+        return -1;
+    }
+    is_dir = S_ISDIR(st.st_mode);
+
+    wd = inotify_add_watch(w->fd, path, is_dir ? WATCH_DIR_EVENTS : WATCH_FILE_EVENTS);
+    if (wd < 0) {
+        if (top) print_error("on-change: failed to watch path");
+        return -1;
+    }
+
+    /* The kernel hands out the same wd for the same inode */
+    int known = 0;
+    for (int i = 0; i < w->count && !known; i++) {
+        known = w->watches[i].wd == wd;
+    }
+    if (!known) {
+        if (w->count == WATCH_MAX_WATCHES) {
+            print_error("on-change: too many directories to watch");
+            inotify_rm_watch(w->fd, wd);
+            return -1;
+        }
+        Watch *entry = &w->watches[w->count];
+        if (!(entry->path = strdup(path))) {
+            inotify_rm_watch(w->fd, wd);
+            return -1;
+        }
+        entry->wd = wd;
+        w->count++;
+    }
+
+    if (is_dir && w->recursive) {
+        DIR *dir = opendir(path);
+        struct dirent *de;
+
+        while (dir && (de = readdir(dir)) != NULL) {
+            char child[PATH_MAX];
+
+            if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0 ||
+                (de->d_type != DT_DIR && de->d_type != DT_UNKNOWN)) {
+                continue;
+            }
+            if (snprintf(child, sizeof(child), "%s/%s", path, de->d_name) >= (int)sizeof(child)) {
+                continue;
+            }
+            if (de->d_type == DT_DIR || (stat(child, &st) == 0 && S_ISDIR(st.st_mode))) {
+                add_watch(w, child, 0);
+            }
+        }
+        if (dir) closedir(dir);
+    }
+    return 0;
+}
+
+static Watch* find_watch(Watcher *w, int wd) {
+    for (int i = 0; i < w->count; i++) {
+        if (w->watches[i].wd == wd) {
+            return &w->watches[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Read the pending events, keeping the watches up to date
+ * Returns 1 when something changed
+ */
+static int drain_events(Watcher *w) {
+    char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    int changed = 0;
+
+    while ((n = read(w->fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event*)p;
+            Watch *watch = find_watch(w, ev->wd);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_IGNORED) {
+                /* Deleted, or replaced by a rename: watch the path again */
+                if (watch) {
+                    watch->wd = -1;
+                    w->lost = 1;
+                }
+                continue;
+            }
+            changed = 1;
+
+            if (w->recursive && watch && ev->len > 0 && (ev->mask & IN_ISDIR) &&
+                (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                char child[PATH_MAX];
+                if (snprintf(child, sizeof(child), "%s/%s", watch->path, ev->name) < (int)sizeof(child)) {
+                    add_watch(w, child, 0);
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+/**
+ * Add the watches the kernel dropped again, for paths that exist by now
+ */
+static void restore_watches(Watcher *w) {
+    w->lost = 0;
+    for (int i = 0; i < w->count; i++) {
+        Watch *watch = &w->watches[i];
+        struct stat st;
+
+        if (watch->wd >= 0) {
+            continue;
+        }
+        if (stat(watch->path, &st) != 0 ||
+            (watch->wd = inotify_add_watch(w->fd, watch->path,
+                S_ISDIR(st.st_mode) ? WATCH_DIR_EVENTS : WATCH_FILE_EVENTS)) < 0) {
+            w->lost = 1;
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && w->recursive) {
+            add_watch(w, watch->path, 0);
+        }
+    }
+}
+
+/**
+ * Wait until fd is readable, the timeout (ms, -1 for none) passes or
+ * Ctrl-C is pressed; returns 1 when fd is readable
+ */
+static int wait_readable(int fd, int timeout) {
+    struct pollfd pfd[2];
+    struct timespec now;
+    double deadline = 0;
+    int count = 0;
+
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        deadline = (double)now.tv_sec * 1000 + (double)now.tv_nsec / 1e6 + timeout;
+    }
+
+    if (fd >= 0) {
+        pfd[count].fd = fd;
+        pfd[count++].events = POLLIN;
+    }
+    if (signal_fd() >= 0) {
+        pfd[count].fd = signal_fd();
+        pfd[count++].events = POLLIN;
+    }
+
+    while (!g_interrupted) {
+        if (timeout >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double left = deadline - ((double)now.tv_sec * 1000 + (double)now.tv_nsec / 1e6);
+            timeout = left > 0 ? (int)left + 1 : 0;
+        }
+
+        int n = poll(pfd, (nfds_t)count, timeout);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        if (fd >= 0 && (pfd[0].revents & POLLIN)) {
+            return 1;
+        }
+        /* SIGINT or SIGCHLD: reap background jobs and look again */
+        jobs_update();
+    }
+    return 0;
+}
+
+/**
+ * Set up inner to run the words of cmd from first on, aliases expanded
+ * Returns 1 when it is a function or builtin, which runs in the shell
+ */
+static int prepare_command(Command *inner, Command *cmd, int first) {
+    char *words[MAX_NUM_TOKENS];
+
+    init_subcommand(inner, cmd, first);
+    inner->background = 0;
+    inner->token_count = expand_aliases(inner->tokens, inner->token_count, words);
+    memcpy(inner->tokens, words, (size_t)inner->token_count * sizeof(char*));
+    inner->tokens[inner->token_count] = NULL;
+
+    return inner->token_count > 0 &&
+           (is_function(inner->tokens[0]) || is_builtin(inner->tokens[0]));
+}
+
+/**
+ * Run a function or builtin with its output on out_fd
+ */
+static int run_in_shell(Command *inner, int out_fd) {
+    int exit_requested = 0;
+    int saved = -1;
+    int status;
+
+    out_flush();
+    fflush(stdout);
+    int prev = out_set_fd(out_fd);
+
+    if (is_function(inner->tokens[0])) {
+        /* Commands the function spawns write to the real standard output */
+        saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+        if (saved < 0 || dup2(out_fd, STDOUT_FILENO) < 0) {
+            print_error("Failed to redirect output");
+            status = -1;
+        } else {
+            status = call_function(inner, &exit_requested);
+            out_flush();
+            fflush(stdout);
+        }
+        if (saved >= 0) {
+            dup2(saved, STDOUT_FILENO);
+            close(saved);
+        }
+    } else {
+        status = execute_builtin(inner);
+        out_flush();
+    }
+
+    out_set_fd(prev);
+    return status;
+}
+
+/**
+ * Run the command of cmd from word first on, with the output of the builtin
+ */
+static int run_command(Command *cmd, int first, int out_fd) {
+    Command inner;
+    int via_zygote;
+    pid_t pid;
+
+    if (prepare_command(&inner, cmd, first)) {
+        return run_in_shell(&inner, out_fd);
+    }
+
+    pid = spawn_command(&inner, out_fd, &via_zygote, 0);
+    return pid < 0 ? -1 : wait_command(&inner, pid, via_zygote);
+}
+
+/**
+ * on-change [-r] [-d MS] PATH... -- command [args]
+ */
+int builtin_on_change(Command *cmd) {
+    char **args = cmd->tokens;
+    int debounce = WATCH_DEBOUNCE_MS;
+    int setup_failed = 0;
+    int status = 0;
+    int first = 0;
+    int i = 1;
+    Watcher w;
+
+    memset(&w, 0, sizeof(w));
+    for (; args[i] && args[i][0] == '-' && strcmp(args[i], "--") != 0; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            w.recursive = 1;
+        } else if (strcmp(args[i], "-d") == 0 && args[i + 1]) {
+            debounce = atoi(args[++i]);
+        } else {
+            break;
+        }
+    }
+    for (int j = i; args[j]; j++) {
+        if (strcmp(args[j], "--") == 0) {
+            first = j + 1;
+            break;
+        }
+    }
+    if (first == 0 || first == i + 1 || !args[first] || debounce < 0) {
+        print_error("Usage: on-change [-r] [-d MS] PATH... -- command [args]");
+        return -1;
+    }
+
+    w.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    w.watches = (Watch*)malloc(WATCH_MAX_WATCHES * sizeof(Watch));
+    if (w.fd < 0 || !w.watches) {
+        print_error("on-change: failed to start watching");
+        setup_failed = 1;
+    }
+    for (int j = i; !setup_failed && j < first - 1; j++) {
+        if (add_watch(&w, args[j], 1) != 0) {
+            setup_failed = 1;
+        }
+    }
+
+    /* A run that fails, even with -1, does not end the watch */
+    while (!g_interrupted && !setup_failed) {
+        if (!wait_readable(w.fd, -1) || !drain_events(&w)) {
+            continue;
+        }
+
+        /* Let the burst settle */
+        while (wait_readable(w.fd, debounce)) {
+            drain_events(&w);
+        }
+        if (g_interrupted) {
+            break;
+        }
+        if (w.lost) {
+            restore_watches(&w);
+        }
+
+        status = run_command(cmd, first, out_get_fd());
+        if (status == 128 + SIGINT) {
+            break;
+        }
+
+        /* What changed while it ran, its own writes included, is not new */
+        drain_events(&w);
+        if (w.lost) {
+            restore_watches(&w);
+        }
+    }
+
+    if (w.fd >= 0) {
+        close(w.fd);
+    }
+    for (int j = 0; j < w.count; j++) {
+        free(w.watches[j].path);
+    }
+    free(w.watches);
+    return setup_failed ? -1 : status;
+}
+
+typedef struct {
+    char *text;
+    size_t len;
+    size_t cap;
+    const char **lines;     /* into text, each ended by a NUL */
+    int count;
+    int lines_cap;
+} Frame;
+
+static void free_frame(Frame *f) {
+    free(f->text);
+    free(f->lines);
+    memset(f, 0, sizeof(*f));
+}
+
+/**
+ * Run the command into f and split its output into lines
+ */
+static int capture(Command *cmd, int first, Frame *f, int *status) {
+    Command inner;
+    int via_zygote;
+    pid_t pid = 0;
+    int p[2];
+    ssize_t n;
+
+    f->len = 0;
+    f->count = 0;
+
+    if (prepare_command(&inner, cmd, first)) {
+        /* Runs to the end before anything is read: spool, not a pipe */
+        FILE *spool = tmpfile();
+        if (!spool) {
+            print_error("Failed to create temporary file");
+            return -1;
+        }
+        fcntl(fileno(spool), F_SETFD, FD_CLOEXEC);
+        p[0] = fcntl(fileno(spool), F_DUPFD_CLOEXEC, 0);
+        *status = run_in_shell(&inner, fileno(spool));
+        fclose(spool);
+        if (p[0] < 0 || lseek(p[0], 0, SEEK_SET) != 0) {
+            if (p[0] >= 0) close(p[0]);
+            print_error("Failed to read command output");
+            return -1;
+        }
+    } else {
+        if (pipe2(p, O_CLOEXEC) != 0) {
+            print_error("Failed to create pipe");
+            return -1;
+        }
+        pid = spawn_command(&inner, p[1], &via_zygote, 0);
+        close(p[1]);
+        if (pid < 0) {
+            close(p[0]);
+            return -1;
+        }
+    }
+
+    for (;;) {
+        if (f->cap - f->len < 4096) {
+            size_t cap = f->cap ? f->cap * 2 : 65536;
+            char *grown = (char*)realloc(f->text, cap);
+            if (!grown) break;
+            f->text = grown;
+            f->cap = cap;
+        }
+        n = read(p[0], f->text + f->len, f->cap - f->len - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        f->len += (size_t)n;
+    }
+    close(p[0]);
+    if (pid > 0) {
+        *status = wait_command(&inner, pid, via_zygote);
+    }
+
+    /* Lines in place: every newline becomes a NUL */
+    if (!f->text) {
+        return 0;
+    }
+    f->text[f->len] = '\0';
+    for (char *s = f->text; s < f->text + f->len; ) {
+        char *nl = memchr(s, '\n', (size_t)(f->text + f->len - s));
+
+        if (f->count == f->lines_cap) {
+            int cap = f->lines_cap ? f->lines_cap * 2 : 256;
+            const char **grown = (const char**)realloc(f->lines, (size_t)cap * sizeof(char*));
+            if (!grown) break;
+            f->lines = grown;
+            f->lines_cap = cap;
+        }
+        f->lines[f->count++] = s;
+        if (!nl) break;
+        *nl = '\0';
+        s = nl + 1;
+    }
+    return 0;
+}
+
+/**
+ * Bytes of line that fit in cols columns, not cutting a UTF-8 sequence
+ */
+static size_t fit_line(const char *line, int cols) {
+    size_t len = strlen(line);
+
+    if (len <= (size_t)cols) {
+        return len;
+    }
+    len = (size_t)cols;
+    while (len > 0 && ((unsigned char)line[len] & 0xC0) == 0x80) {
+        len--;
+    }
+    return len;
+}
+
+/**
+ * Draw cur over prev: the header, then only the lines that differ
+ */
+static void redraw(const Frame *cur, const Frame *prev, int first_frame,
+                   const char *title, int rows, int cols) {
+    char stamp[32];
+    time_t now = time(NULL);
+    int shown = cur->count < rows - 2 ? cur->count : rows - 2;
+    int was = prev->count < rows - 2 ? prev->count : rows - 2;
+
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&now));
+    if (first_frame) {
+        out_printf("\033[H\033[2J%.*s", cols > 12 ? cols - 12 : cols, title);
+    }
+    if (cols > 12) {
+        out_printf("\033[1;%dH%s", cols - 8, stamp);
+    }
+
+    for (int i = 0; i < shown; i++) {
+        if (!first_frame && i < was && strcmp(cur->lines[i], prev->lines[i]) == 0) {
+            continue;
+        }
+        out_printf("\033[%d;1H", i + 3);
+        out_write(cur->lines[i], fit_line(cur->lines[i], cols));
+        out_puts("\033[K");
+    }
+    if (shown < was || first_frame) {
+        out_printf("\033[%d;1H\033[J", shown + 3);
+    }
+    out_printf("\033[%d;1H", shown + 3);
+    out_flush();
+}
+
+/**
+ * watch [-n S] command [args]
+ */
+int builtin_watch(Command *cmd) {
+    char **args = cmd->tokens;
+    double interval = 2.0;
+    char title[MAX_INPUT_SIZE];
+    Frame frames[2];
+    int cur = 0;
+    int drawn = 0;
+    int status = 0;
+    int i = 1;
+
+    if (args[i] && strcmp(args[i], "-n") == 0 && args[i + 1]) {
+        char *end;
+        interval = strtod(args[i + 1], &end);
+        if (*end != '\0' || interval < 0.1) {
+            print_error("watch: interval must be at least 0.1 seconds");
+            return -1;
+        }
+        i += 2;
+    }
+    if (args[i] && strcmp(args[i], "--") == 0) {
+        i++;
+    }
+    if (!args[i]) {
+        print_error("Usage: watch [-n S] command [args]");
+        return -1;
+    }
+
+    size_t len = (size_t)snprintf(title, sizeof(title), "Every %gs:", interval);
+    for (int j = i; args[j] && len < sizeof(title); j++) {
+        len += (size_t)snprintf(title + len, sizeof(title) - len, " %s", args[j]);
+    }
+
+    memset(frames, 0, sizeof(frames));
+    out_flush();
+    int tty = isatty(out_get_fd());
+
+    while (!g_interrupted) {
+        Frame *f = &frames[cur];
+        Frame *prev = &frames[!cur];
+
+        if (capture(cmd, i, f, &status) != 0 || status == 128 + SIGINT) {
+            break;
+        }
+
+        if (tty) {
+            struct winsize ws;
+            int rows = 24, cols = 80;
+            if (ioctl(out_get_fd(), TIOCGWINSZ, &ws) == 0 && ws.ws_row > 2 && ws.ws_col > 0) {
+                rows = ws.ws_row;
+                cols = ws.ws_col;
+            }
+            redraw(f, prev, !drawn, title, rows, cols);
+        } else if (!drawn || f->len != prev->len ||
+                   (f->len > 0 && memcmp(f->text, prev->text, f->len) != 0)) {
+            /* The newlines became NULs: put them back for the copy */
+            for (int j = 0; j + 1 < f->count; j++) {
+                out_write(f->lines[j], strlen(f->lines[j]));
+                out_puts("\n");
+            }
+            if (f->count > 0) {
+                out_write(f->lines[f->count - 1], strlen(f->lines[f->count - 1]));
+                if (f->text[f->len - 1] == '\0') out_puts("\n");
+            }
+            out_flush();
+        }
+        drawn = 1;
+        cur = !cur;
+
+        wait_readable(-1, (int)(interval * 1000));
+    }
+
+    if (tty && drawn) {
+        out_puts("\n");
+    }
+    free_frame(&frames[0]);
+    free_frame(&frames[1]);
+    return status;
+}
+
+#else
+
+int builtin_on_change(Command *cmd) {
+    print_error("on-change is not supported on Windows");
+    return -1;
+}
+
+int builtin_watch(Command *cmd) {
+    print_error("watch is not supported on Windows");
+    return -1;
+}
+
+#endif
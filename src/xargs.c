@@ -0,0 +1,376 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+/*
+ * Argument batching
+ *
+ *   xargs [-n N] [-P J] [-0] [command [args]] [< file]
+ *
+ * Reads words from standard input (blanks and newlines separate them, or
+ * NULs with -0) and runs the command (echo by default) with as many of them
+ * after its own arguments as one exec can take: the limit is
+ * sysconf(_SC_ARG_MAX) less the environment, which the kernel counts too.
+ * -n caps the words per run, and -P runs up to J batches at the same time.
+ * Quotes have no special meaning, and without -0 NULs are dropped with a
+ * warning. Input is read in large blocks, and words are collected in one
+ * buffer that is reused for every batch, because the child gets a copy of
+ * it at fork. The batches run as one job in their own process group, which
+ * takes the terminal unless the words are typed at it. The status is 123
+ * when a run failed, as with the external xargs.
+ */
+
+#define XARGS_MAX_JOBS 256
+#define XARGS_READ_SIZE (256 * 1024)
+#define XARGS_HEADROOM 2048             /* POSIX leaves this to the exec */
+#define XARGS_MAX_WORD (128 * 1024)     /* Linux refuses longer arguments */
+
+static unsigned long g_xargs_batches = 0;
+static unsigned long g_xargs_forks = 0;
+static unsigned long g_xargs_words = 0;
+static unsigned long g_xargs_max_words = 0;
+static size_t g_xargs_max_bytes = 0;
+
+void xargs_print_stats(void) {
+    out_printf("xargs: %lu batches, %lu forks, %lu args (largest batch %lu args, %zu bytes)\n",
+               g_xargs_batches, g_xargs_forks, g_xargs_words,
+               g_xargs_max_words, g_xargs_max_bytes);
+}
+
+#ifndef _WIN32
+
+typedef struct {
+    char **base;            /* the command and its own arguments */
+    int base_count;
+    size_t limit;           /* bytes of argv and environment per exec */
+    size_t cost;            /* of the batch so far */
+    int max_words;          /* -n, 0 for no cap */
+    int jobs;               /* -P */
+    pid_t pids[XARGS_MAX_JOBS];
+    int running;
+    ArgvGroup group;        /* the batches as one job */
+    int null_fd;            /* stdin of the commands */
+    int out_fd;
+    int status;
+    char *buf;              /* words of the batch, each ended by a NUL */
+    size_t used;
+    int count;
+    char **argv;
+    int argv_cap;
+} Xargs;
+
+/**
+ * What one word adds to an exec: its bytes and its argv slot
+ */
+static size_t word_cost(size_t len) {
+    return len + 1 + sizeof(char*);
+}
+
+/**
+ * Bytes left for arguments once the environment is counted
+ */
+static size_t arg_limit(void) {
+    long max = sysconf(_SC_ARG_MAX);
+    size_t env = 0;
+
+    if (max <= 0) {
+        max = 131072;
+    }
+    for (char **e = environ; *e; e++) {
+        env += word_cost(strlen(*e));
+    }
+    if ((size_t)max <= env + XARGS_HEADROOM) {
+        return 0;
+    }
+    return (size_t)max - env - XARGS_HEADROOM;
+}
+
+/**
+ * Wait for one of the batches to exit
+ */
+static int wait_batch(Xargs *x) {
+    int status;
+    int j;
+
+    if (x->running == 0) {
+        return -1;
+    }
+    j = wait_argv(&x->group, x->pids, x->running, &status);
+    if (j < 0) {
+        return -1;
+    }
+
+    x->pids[j] = x->pids[--x->running];
+    if (WIFSIGNALED(status) && x->status == 0) {
+        x->status = 125;
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0 && x->status == 0) {
+        x->status = 123;
+    }
+    return 0;
+}
+
+/**
+ * Wait for typed input, returning 0 when a signal came first
+ * Ctrl-C reaches only the shell then, so it is passed on to the batches
+ */
+static int wait_input(Xargs *x, int fd) {
+    struct pollfd pfd[2] = {{fd, POLLIN, 0}, {signal_fd(), POLLIN, 0}};
+
+    if (poll(pfd, 2, -1) < 0 || pfd[1].revents) {
+        jobs_update();
+    }
+    if (g_interrupted && x->group.pgid > 0) {
+        kill(-x->group.pgid, SIGINT);
+    }
+    return pfd[0].revents != 0;
+}
+
+/**
+ * Run the command with the words collected so far and start a new batch
+ */
+static int run_batch(Xargs *x) {
+    int argc = x->base_count;
+    char *word = x->buf;
+    pid_t pid;
+
+    if (x->count == 0) {
+        return 0;
+    }
+    while (x->running >= x->jobs) {
+        if (wait_batch(x) != 0) {
+            break;
+        }
+    }
+
+    if (x->base_count + x->count + 1 > x->argv_cap) {
+        int cap = x->base_count + x->count + 1;
+        char **grown = (char**)realloc(x->argv, (size_t)cap * sizeof(char*));
+        if (!grown) {
+            print_error("Memory allocation failed");
+            return -1;
+        }
+        x->argv = grown;
+        x->argv_cap = cap;
+    }
+    memcpy(x->argv, x->base, (size_t)x->base_count * sizeof(char*));
+    for (int i = 0; i < x->count; i++) {
+        x->argv[argc++] = word;
+        word += strlen(word) + 1;
+    }
+    x->argv[argc] = NULL;
+
+    g_xargs_batches++;
+    g_xargs_words += (unsigned long)x->count;
+    if ((unsigned long)x->count > g_xargs_max_words) {
+        g_xargs_max_words = (unsigned long)x->count;
+    }
+    if (x->used > g_xargs_max_bytes) {
+        g_xargs_max_bytes = x->used;
+    }
+
+    pid = spawn_argv(x->argv, x->null_fd, x->out_fd, &x->group);
+    if (pid < 0) {
+        print_error("Failed to fork process");
+        return -1;
+    }
+    g_xargs_forks++;
+    x->pids[x->running++] = pid;
+
+    x->used = 0;
+    x->count = 0;
+    x->cost = 0;
+    for (int i = 0; i < x->base_count; i++) {
+        x->cost += word_cost(strlen(x->base[i]));
+    }
+    return 0;
+}
+
+/**
+ * Add the word of len bytes being built at x->buf + x->used to the batch,
+ * running the batch first when the word does not fit
+ */
+static int add_word(Xargs *x, size_t len) {
+    size_t cost = word_cost(len);
+
+    if (x->count > 0 && x->cost + cost > x->limit) {
+        size_t start = x->used;
+        if (run_batch(x) != 0) {
+            return -1;
+        }
+        memmove(x->buf, x->buf + start, len);
+    }
+    if (x->cost + cost > x->limit) {
+        print_error("xargs: argument list too long");
+        return -1;
+    }
+
+    x->buf[x->used + len] = '\0';
+    x->used += len + 1;
+    x->cost += cost;
+    x->count++;
+    if (x->max_words > 0 && x->count == x->max_words) {
+        return run_batch(x);
+    }
+    return 0;
+}
+
+/**
+ * xargs [-n N] [-P J] [-0] [command [args]]
+ */
+int builtin_xargs(Command *cmd) {
+    static char *echo[] = { "echo", NULL };
+    char **args = cmd->tokens;
+    int null_sep = 0;
+    int i = 1;
+    Xargs x;
+
+    memset(&x, 0, sizeof(x));
+    x.jobs = 1;
+
+    for (; args[i] && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-n") == 0 && args[i + 1]) {
+            x.max_words = atoi(args[++i]);
+            if (x.max_words < 1) {
+                print_error("xargs: invalid number of arguments");
+                return -1;
+            }
+        } else if (strcmp(args[i], "-P") == 0 && args[i + 1]) {
+            x.jobs = atoi(args[++i]);
+            if (x.jobs < 1 || x.jobs > XARGS_MAX_JOBS) {
+                print_error("xargs: invalid number of jobs");
+                return -1;
+            }
+        } else if (strcmp(args[i], "-0") == 0) {
+            null_sep = 1;
+        } else if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        } else {
+            print_error("Usage: xargs [-n N] [-P J] [-0] [command [args]]");
+            return -1;
+        }
+    }
+
+    x.base = args[i] ? args + i : echo;
+    while (x.base[x.base_count]) {
+        x.cost += word_cost(strlen(x.base[x.base_count++]));
+    }
+    x.limit = arg_limit();
+    if (x.cost >= x.limit) {
+        print_error("xargs: environment too large for any arguments");
+        return -1;
+    }
+
+    int fd = STDIN_FILENO;
+    if (cmd->input_file && (fd = open(cmd->input_file, O_RDONLY | O_CLOEXEC)) < 0) {
+        print_error("Failed to open input file");
+        return -1;
+    }
+
+    /* Words typed at the terminal need it, so the batches stay behind */
+    x.group.foreground = fd != STDIN_FILENO || !isatty(fd);
+
+    char *block = (char*)malloc(XARGS_READ_SIZE);
+    int failed = 0;
+    size_t max_word = x.limit < XARGS_MAX_WORD ? x.limit : XARGS_MAX_WORD;
+    x.buf = (char*)malloc(x.limit + max_word + 1);
+    x.null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (!block || !x.buf || x.null_fd < 0) {
+        print_error("xargs: failed to allocate buffers");
+        failed = 1;
+    }
+
+    out_flush();
+    fflush(stdout);
+    x.out_fd = out_get_fd();
+
+    /* The word being read sits at x.buf + x.used until it is complete */
+    size_t len = 0;
+    int in_word = 0;
+    int warned_nul = 0;
+    while (!failed && !g_interrupted) {
+        if (!x.group.foreground && !wait_input(&x, fd)) {
+            continue;
+        }
+
+        ssize_t n = read(fd, block, XARGS_READ_SIZE);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            print_error("xargs: failed to read input");
+            failed = 1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        for (ssize_t j = 0; j < n && !failed; j++) {
+            char c = block[j];
+            int sep = null_sep ? c == '\0' : (c == ' ' || c == '\t' || c == '\n');
+
+            if (c == '\0' && !null_sep) {
+                /* An argument cannot hold a NUL; drop it like GNU xargs */
+                if (!warned_nul) {
+                    print_error("xargs: ignoring NUL in input (did you mean -0?)");
+                    warned_nul = 1;
+                }
+            } else if (!sep) {
+                if (len == max_word) {
+                    print_error("xargs: argument too long");
+                    failed = 1;
+                    break;
+                }
+                x.buf[x.used + len++] = c;
+                in_word = 1;
+            } else if (in_word || null_sep) {
+                /* With -0 every NUL ends a word, even an empty one */
+                if (add_word(&x, len) != 0) {
+                    failed = 1;
+                }
+                len = 0;
+                in_word = 0;
+            }
+        }
+    }
+
+    if (!failed && in_word && add_word(&x, len) != 0) {
+        failed = 1;
+    }
+    if (!failed && !g_interrupted && run_batch(&x) != 0) {
+        failed = 1;
+    }
+    while (x.running > 0 && wait_batch(&x) == 0) {
+        continue;
+    }
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    } else {
+        /* The shell's own input moved under the buffer of read */
+        read_reset();
+    }
+    if (x.null_fd >= 0) {
+        close(x.null_fd);
+    }
+    free(x.argv);
+    free(x.buf);
+    free(block);
+    return failed ? -1 : x.status;
+}
+
+#else
+
+int builtin_xargs(Command *cmd) {
+    print_error("xargs is not supported on Windows");
+    return -1;
+}
+
+#endif
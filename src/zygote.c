@@ -0,0 +1,467 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "../include/shell.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+
+/*
+ * Spawn zygote
+ *
+ * A helper process forked at startup, while the shell is still small, that
+ * forks and execs commands on the shell's behalf. Forking a tiny process is
+ * cheap no matter how much memory the shell itself has grown to.
+ *
+ * The shell sends one SOCK_SEQPACKET message per spawn: a ZygoteRequest
+ * header followed by NUL-separated cwd, argv and environment strings, with
+ * the child's stdin/stdout/stderr attached as SCM_RIGHTS. The zygote answers
+ * ZYGOTE_SPAWNED with the pid, and later ZYGOTE_EXITED or ZYGOTE_STOPPED
+ * with the wait status. Notices for other children than the one waited for
+ * are handed to the notify callback (the job table).
+ */
+
+#define ZYGOTE_MAX_REQUEST (256 * 1024)
+
+enum {
+    ZYGOTE_SPAWNED = 1,
+    ZYGOTE_EXITED = 2,
+    ZYGOTE_STOPPED = 3
+};
+
+typedef struct {
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t cwd_len;       /* 0: keep the zygote's cwd */
+    SpawnAttr attr;
+} ZygoteRequest;
+
+typedef struct {
+    int32_t type;
+    int32_t pid;            /* negative errno when the spawn failed */
+    int32_t status;
+} ZygoteReply;
+
+static int g_zygote_sock = -1;
+static pid_t g_zygote_pid = -1;
+static void (*g_notify)(pid_t pid, int status);
+
+/**
+ * Zygote side: fork and exec one request
+ */
+static pid_t zygote_fork_child(char *data, const ZygoteRequest *req, const int fds[3]) {
+    char **argv = (char**)calloc(req->argc + 1, sizeof(char*));
+    char **envp = (char**)calloc(req->envc + 1, sizeof(char*));
+    char *cwd = NULL;
+    char *p = data;
+    pid_t pid;
+
+    if (!argv || !envp) {
+        free(argv);
+        free(envp);
+        return -ENOMEM;
+    }
+
+    if (req->cwd_len > 0) {
+        cwd = p;
+        p += req->cwd_len + 1;
+    }
+    for (uint32_t i = 0; i < req->argc; i++) {
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+    for (uint32_t i = 0; i < req->envc; i++) {
+        envp[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        sigset_t none;
+
+        for (int i = 0; i < 3; i++) {
+            dup2(fds[i], i);
+        }
+        if (cwd && chdir(cwd) != 0) {
+            _exit(EXIT_FAILURE);
+        }
+        if (spawn_attr_apply(&req->attr) != 0) {
+            fprintf(stderr, "mini-shell: %s: failed to apply spawn attributes\n", argv[0]);
+        }
+
+        /* Undo the zygote's signal setup */
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+
+        environ = envp;
+        execvp(argv[0], argv);
+
+        fprintf(stderr, "%smini-shell: %s: command not found%s\n",
+                COLOR_RED, argv[0], COLOR_RESET);
+        _exit(EXIT_FAILURE);
+    }
+
+    /* Also from this side, so the group exists once the shell hears of it */
+    if (pid > 0 && req->attr.new_pgrp) {
+        setpgid(pid, pid);
+    }
+
+    free(argv);
+    free(envp);
+    return pid < 0 ? -errno : pid;
+}
+
+/* Zygote side: exit notices the shell's socket had no room for yet */
+static ZygoteReply *g_pending = NULL;
+static size_t g_pending_count = 0;
+static size_t g_pending_cap = 0;
+
+static void queue_notice(const ZygoteReply *reply) {
+    if (g_pending_count == g_pending_cap) {
+        size_t cap = g_pending_cap ? g_pending_cap * 2 : 64;
+        ZygoteReply *grown = (ZygoteReply*)realloc(g_pending, cap * sizeof(*grown));
+        if (!grown) {
+            return;
+        }
+        g_pending = grown;
+        g_pending_cap = cap;
+    }
+    g_pending[g_pending_count++] = *reply;
+}
+
+/**
+ * Send queued notices in order until the socket is full; never blocks on
+ * a shell that is busy, the rest goes out once the socket is writable
+ */
+static void flush_notices(int sock) {
+    size_t sent = 0;
+
+    while (sent < g_pending_count) {
+        if (send(sock, &g_pending[sent], sizeof(*g_pending), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            /* Shell gone: nobody left to tell */
+            sent = g_pending_count;
+            break;
+        }
+        sent++;
+    }
+    memmove(g_pending, g_pending + sent, (g_pending_count - sent) * sizeof(*g_pending));
+    g_pending_count -= sent;
+}
+
+/**
+ * Zygote main loop: serve spawn requests and report exits
+ */
+static void zygote_main(int sock) {
+    char *buf = (char*)malloc(ZYGOTE_MAX_REQUEST);
+    sigset_t chld;
+    int sfd;
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, NULL);
+    signal(SIGCHLD, SIG_DFL);
+    sfd = signalfd(-1, &chld, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    if (!buf || sfd < 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    while (1) {
+        short events = (short)(POLLIN | (g_pending_count > 0 ? POLLOUT : 0));
+        struct pollfd pfd[2] = {{sock, events, 0}, {sfd, POLLIN, 0}};
+
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd[0].revents & POLLOUT) {
+            flush_notices(sock);
+        }
+
+        if (pfd[1].revents & POLLIN) {
+            struct signalfd_siginfo si;
+            ZygoteReply reply;
+            int status;
+            pid_t pid;
+
+            while (read(sfd, &si, sizeof(si)) > 0) {
+                continue;
+            }
+            while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0) {
+                reply.type = WIFSTOPPED(status) ? ZYGOTE_STOPPED : ZYGOTE_EXITED;
+                reply.pid = pid;
+                reply.status = status;
+                queue_notice(&reply);
+            }
+            flush_notices(sock);
+        }
+
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char control[CMSG_SPACE(sizeof(int) * 3)];
+            struct iovec iov = {buf, ZYGOTE_MAX_REQUEST};
+            struct msghdr msg;
+            int fds[3] = {-1, -1, -1};
+            ZygoteReply reply;
+
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                /* Shell exited */
+                break;
+            }
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+            }
+
+            reply.type = ZYGOTE_SPAWNED;
+            reply.status = 0;
+            if ((size_t)n < sizeof(ZygoteRequest) || fds[2] < 0) {
+                reply.pid = -EINVAL;
+            } else {
+                ZygoteRequest req;
+                memcpy(&req, buf, sizeof(req));
+                buf[n - 1] = '\0';
+                reply.pid = zygote_fork_child(buf + sizeof(req), &req, fds);
+            }
+
+            for (int i = 0; i < 3; i++) {
+                if (fds[i] >= 0) close(fds[i]);
+            }
+            send(sock, &reply, sizeof(reply), MSG_NOSIGNAL);
+        }
+    }
+
+    _exit(0);
+}
+
+/**
+ * Fork the zygote; call as early as possible while the shell is small
+ */
+int zygote_start(void) {
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0) {
+        return -1;
+    }
+
+    g_zygote_pid = fork();
+    if (g_zygote_pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+
+    if (g_zygote_pid == 0) {
+        close(sv[0]);
+        zygote_main(sv[1]);
+    }
+
+    close(sv[1]);
+    g_zygote_sock = sv[0];
+    return 0;
+}
+
+int zygote_active(void) {
+    return g_zygote_sock >= 0;
+}
+
+/**
+ * Ask the zygote to run argv with the given stdin/stdout/stderr and attributes
+ * Returns the child's pid, or -1 (errno set) when the caller should fall back
+ */
+pid_t zygote_spawn(char **argv, const int fds[3], const char *cwd, const SpawnAttr *attr) {
+    static char *buf = NULL;
+    char control[CMSG_SPACE(sizeof(int) * 3)];
+    ZygoteRequest req;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    ZygoteReply reply;
+    size_t len = sizeof(req);
+
+    if (g_zygote_sock < 0) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    if (!buf && !(buf = (char*)malloc(ZYGOTE_MAX_REQUEST))) {
+        return -1;
+    }
+
+    /* Pack cwd, argv and the current environment */
+    memset(&req, 0, sizeof(req));
+    if (attr) {
+        req.attr = *attr;
+    }
+    req.cwd_len = cwd ? (uint32_t)strlen(cwd) : 0;
+    if (cwd) {
+        if (len + req.cwd_len + 1 > ZYGOTE_MAX_REQUEST) goto too_big;
+        memcpy(buf + len, cwd, req.cwd_len + 1);
+        len += req.cwd_len + 1;
+    }
+    for (char **a = argv; *a; a++, req.argc++) {
+        size_t n = strlen(*a) + 1;
+        if (len + n > ZYGOTE_MAX_REQUEST) goto too_big;
+        memcpy(buf + len, *a, n);
+        len += n;
+    }
+    for (char **e = environ; e && *e; e++, req.envc++) {
+        size_t n = strlen(*e) + 1;
+        if (len + n > ZYGOTE_MAX_REQUEST) goto too_big;
+        memcpy(buf + len, *e, n);
+        len += n;
+    }
+    memcpy(buf, &req, sizeof(req));
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
+
+    while (sendmsg(g_zygote_sock, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            /* Zygote is gone: stop using it */
+            zygote_stop();
+            return -1;
+        }
+    }
+
+    /* Pass on notices about earlier background children */
+    while (1) {
+        ssize_t n = recv(g_zygote_sock, &reply, sizeof(reply), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n != (ssize_t)sizeof(reply)) {
+            zygote_stop();
+            errno = ECHILD;
+            return -1;
+        }
+        if (reply.type == ZYGOTE_SPAWNED) break;
+        if (g_notify) g_notify(reply.pid, reply.status);
+    }
+
+    if (reply.pid < 0) {
+        errno = -reply.pid;
+        return -1;
+    }
+    return reply.pid;
+
+too_big:
+    errno = E2BIG;
+    return -1;
+}
+
+/**
+ * Wait until the zygote reports that pid exited or stopped; stores the
+ * wait status
+ */
+int zygote_wait(pid_t pid, int *status) {
+    ZygoteReply reply;
+
+    while (g_zygote_sock >= 0) {
+        ssize_t n = recv(g_zygote_sock, &reply, sizeof(reply), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n != (ssize_t)sizeof(reply)) {
+            zygote_stop();
+            break;
+        }
+        if (reply.type == ZYGOTE_SPAWNED) continue;
+        if (reply.pid == pid) {
+            *status = reply.status;
+            return 0;
+        }
+        if (g_notify) g_notify(reply.pid, reply.status);
+    }
+    return -1;
+}
+
+/**
+ * Socket to poll for notices about background children, -1 without zygote
+ */
+int zygote_fd(void) {
+    return g_zygote_sock;
+}
+
+/**
+ * Set the function that receives notices about children nobody waits for
+ */
+void zygote_set_notify(void (*notify)(pid_t pid, int status)) {
+    g_notify = notify;
+}
+
+/**
+ * Hand every queued notice to the notify callback without blocking
+ */
+void zygote_poll_notices(void) {
+    ZygoteReply reply;
+
+    while (g_zygote_sock >= 0) {
+        ssize_t n = recv(g_zygote_sock, &reply, sizeof(reply), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) break;
+        if (n != (ssize_t)sizeof(reply)) {
+            zygote_stop();
+            break;
+        }
+        if (reply.type != ZYGOTE_SPAWNED && g_notify) {
+            g_notify(reply.pid, reply.status);
+        }
+    }
+}
+
+void zygote_stop(void) {
+    if (g_zygote_sock >= 0) {
+        close(g_zygote_sock);
+        g_zygote_sock = -1;
+    }
+    if (g_zygote_pid > 0) {
+        waitpid(g_zygote_pid, NULL, 0);
+        g_zygote_pid = -1;
+    }
+}
+
+#else
+
+int zygote_start(void) {
+    return -1;
+}
+
+int zygote_active(void) {
+    return 0;
+}
+
+void zygote_stop(void) {
+}
+
+#endif
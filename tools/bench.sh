@@ -0,0 +1,136 @@
+#!/bin/bash
+
+# Mini Shell Benchmark Suite
+# Run from the repository root after building: make bench
+
+SHELL_BIN=${SHELL_BIN:-./bin/mini-shell}
+CLIENT_BIN=${CLIENT_BIN:-./bin/msh-client}
+SPAWN_BENCH_BIN=${SPAWN_BENCH_BIN:-./bin/spawn-bench}
+COUNT=${COUNT:-5000}
+CLIENTS=${CLIENTS:-8}
+WORK_DIR=$(mktemp -d)
+
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+echo "========================================="
+echo "   Mini Shell Benchmark Suite"
+echo "========================================="
+echo ""
+
+# Benchmark 1: command server throughput
+echo "Benchmark 1: Command Server (--server)"
+echo "--------------------------------------"
+SOCK="$WORK_DIR/shell.sock"
+"$SHELL_BIN" --server "$SOCK" 2>/dev/null &
+SERVER_PID=$!
+for _ in $(seq 50); do
+    [ -S "$SOCK" ] && break
+    sleep 0.1
+done
+
+"$CLIENT_BIN" --bench -n "$COUNT" -c 1 "$SOCK" echo ok
+"$CLIENT_BIN" --bench -n "$COUNT" -c "$CLIENTS" "$SOCK" echo ok
+"$CLIENT_BIN" --bench -n "$((COUNT / 5))" -c 1 "$SOCK" true
+"$CLIENT_BIN" --bench -n "$((COUNT / 5))" -c "$CLIENTS" "$SOCK" true
+
+kill "$SERVER_PID" 2>/dev/null
+wait "$SERVER_PID" 2>/dev/null
+SERVER_PID=
+
+# Baseline: one shell process per command
+RUNS=$((COUNT / 25))
+START=$(date +%s.%N)
+for _ in $(seq "$RUNS"); do
+    echo "echo ok" | "$SHELL_BIN" > /dev/null
+done
+END=$(date +%s.%N)
+echo "$RUNS" "$START" "$END" | awk '{ printf "%-24s process per command %7d %8.3f s %10.0f cmds/s\n", "echo ok", $1, $3 - $2, $1 / ($3 - $2) }'
+echo ""
+
+# Benchmark 2: spawn latency, direct fork/exec vs zygote (--zygote)
+echo "Benchmark 2: Spawn Zygote (--zygote)"
+echo "------------------------------------"
+SPAWNS=$((COUNT / 5))
+for MB in 0 256 1024; do
+    "$SPAWN_BENCH_BIN" -n "$SPAWNS" -m "$MB" true
+done
+echo ""
+
+# Benchmark 3: line filter over a large file, plain vs pmap
+echo "Benchmark 3: Parallel Map (pmap)"
+echo "--------------------------------"
+JOBS=$(nproc)
+seq 1 4000000 | awk '{ print "line " $1 " value " ($1 * 7) % 1000 }' > "$WORK_DIR/big.log"
+for LINE in "grep value.99 < $WORK_DIR/big.log > $WORK_DIR/out" \
+            "pmap -j $JOBS --ordered grep value.99 < $WORK_DIR/big.log > $WORK_DIR/out"; do
+    START=$(date +%s.%N)
+    echo "$LINE" | "$SHELL_BIN" > /dev/null
+    END=$(date +%s.%N)
+    echo "$START" "$END" | awk -v l="${LINE%% <*}" '{ printf "%-40s %8.3f s\n", l, $2 - $1 }'
+done
+echo ""
+
+# Benchmark 4: fan-out throughput, tee builtin vs external tee
+echo "Benchmark 4: Fan-out (tee, > a > b)"
+echo "-----------------------------------"
+TEE_MB=${TEE_MB:-256}
+head -c "$((TEE_MB * 1024 * 1024))" /dev/zero > "$WORK_DIR/tee.in"
+for CASE in "tee builtin|tee $WORK_DIR/t1 $WORK_DIR/t2 < $WORK_DIR/tee.in > $WORK_DIR/t3" \
+            "> a > b > c|cat $WORK_DIR/tee.in > $WORK_DIR/t1 > $WORK_DIR/t2 > $WORK_DIR/t3" \
+            "external tee|/usr/bin/env tee $WORK_DIR/t1 $WORK_DIR/t2 < $WORK_DIR/tee.in > $WORK_DIR/t3"; do
+    START=$(date +%s.%N)
+    echo "${CASE#*|}" | "$SHELL_BIN" > /dev/null
+    END=$(date +%s.%N)
+    echo "$START" "$END" | awk -v l="${CASE%%|*}" -v mb="$TEE_MB" \
+        '{ printf "%-24s 3 targets %6d MB %8.3f s %10.0f MB/s\n", l, mb, $2 - $1, 3 * mb / ($2 - $1) }'
+done
+rm -f "$WORK_DIR"/t1 "$WORK_DIR"/t2 "$WORK_DIR"/t3 "$WORK_DIR/tee.in"
+echo ""
+
+# Benchmark 5: reading a file line by line into variables
+echo "Benchmark 5: Line Reads (read, mapfile)"
+echo "---------------------------------------"
+READ_LINES=${READ_LINES:-1000000}
+seq 1 "$READ_LINES" | awk '{ print "line " $1 " value " ($1 * 7) % 1000 }' > "$WORK_DIR/lines.txt"
+for LINE in "while read -r line; do x=\$line; done < $WORK_DIR/lines.txt" \
+            "mapfile -t lines < $WORK_DIR/lines.txt"; do
+    START=$(date +%s.%N)
+    echo "$LINE" | "$SHELL_BIN" > /dev/null
+    END=$(date +%s.%N)
+    echo "$READ_LINES" "$START" "$END" | awk -v l="${LINE%% <*}" \
+        '{ printf "%-44s %8d lines %8.3f s %10.0f lines/s\n", l, $1, $3 - $2, $1 / ($3 - $2) }'
+done
+rm -f "$WORK_DIR/lines.txt"
+echo ""
+
+# Benchmark 6: startup with a large ~/.minishellrc, parsed vs from its snapshot
+echo "Benchmark 6: Startup (~/.minishellrc)"
+echo "-------------------------------------"
+RC_DEFS=${RC_DEFS:-5000}
+STARTS=${STARTS:-100}
+mkdir -p "$WORK_DIR/home" "$WORK_DIR/cache"
+seq 1 "$RC_DEFS" | awk '{ if ($1 % 5) print "VAR_" $1 "=value_" $1; else print "export EXP_" $1 "=$HOME/bin/" $1 }' \
+    > "$WORK_DIR/home/.minishellrc"
+for CASE in "no rc file" "cold (parse, write snapshot)" "warm (mapped snapshot)"; do
+    START=$(date +%s.%N)
+    for _ in $(seq "$STARTS"); do
+        case "$CASE" in
+            no*) mv "$WORK_DIR/home/.minishellrc" "$WORK_DIR/rc.off" ;;
+            cold*) rm -f "$WORK_DIR/cache/mini-shell/rc.snapshot" ;;
+        esac
+        echo ":" | HOME="$WORK_DIR/home" XDG_CACHE_HOME="$WORK_DIR/cache" "$SHELL_BIN" > /dev/null
+        [ -f "$WORK_DIR/rc.off" ] && mv "$WORK_DIR/rc.off" "$WORK_DIR/home/.minishellrc"
+    done
+    END=$(date +%s.%N)
+    echo "$STARTS" "$START" "$END" | awk -v l="$CASE" -v d="$RC_DEFS" \
+        '{ printf "%-32s %6d defs %8.3f ms/start\n", l, d, 1000 * ($3 - $2) / $1 }'
+done
+echo ""
+
+echo "========================================="
+echo "   Benchmarks Complete!"
+echo "========================================="
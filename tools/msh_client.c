@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+
+#include "../include/shell.h"
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * Tiny client for mini-shell --server
+ *
+ *   msh-client SOCKET [COMMAND...]
+ *       Run COMMAND (or every line of stdin) and print its output.
+ *       Exits with the status of the last command.
+ *
+ *   msh-client --bench [-n COUNT] [-c CLIENTS] SOCKET [COMMAND...]
+ *       Run COMMAND (default "echo ok") COUNT times spread over CLIENTS
+ *       concurrent connections and report commands per second.
+ */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_server(const char *path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, (char*)buf + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Read frames until the exit frame; output frames go to out/err when set
+ */
+static int read_result(int fd, int out, int err, int *status) {
+    static char *payload = NULL;
+    static size_t cap = 0;
+    unsigned char header[FRAME_HEADER_SIZE];
+
+    while (1) {
+        if (read_full(fd, header, sizeof(header)) != 0) {
+            return -1;
+        }
+
+        uint32_t len = ((uint32_t)header[1] << 24) | ((uint32_t)header[2] << 16) |
+                       ((uint32_t)header[3] << 8) | header[4];
+        if (len > cap) {
+            char *grown = (char*)realloc(payload, len);
+            if (!grown) return -1;
+            payload = grown;
+            cap = len;
+        }
+        if (read_full(fd, payload, len) != 0) {
+            return -1;
+        }
+
+        if (header[0] == FRAME_EXIT && len == 4) {
+            unsigned char *p = (unsigned char*)payload;
+            *status = (int)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                            ((uint32_t)p[2] << 8) | p[3]);
+            return 0;
+        }
+        if (header[0] == FRAME_STDOUT && out >= 0) {
+            write_full(out, payload, len);
+        } else if (header[0] == FRAME_STDERR && err >= 0) {
+            write_full(err, payload, len);
+        }
+    }
+}
+
+static int run_line(int fd, const char *line, int *status) {
+    size_t len = strlen(line);
+
+    if (write_full(fd, line, len) != 0 || write_full(fd, "\n", 1) != 0) {
+        return -1;
+    }
+    return read_result(fd, STDOUT_FILENO, STDERR_FILENO, status);
+}
+
+/**
+ * One benchmark client: count sequential request/response round trips
+ */
+static int bench_client(const char *path, const char *line, long count) {
+    char *request;
+    size_t len = strlen(line);
+    int fd = connect_server(path);
+    int status;
+
+    if (fd < 0) {
+        return 1;
+    }
+
+    request = (char*)malloc(len + 2);
+    memcpy(request, line, len);
+    request[len] = '\n';
+    request[len + 1] = '\0';
+
+    for (long i = 0; i < count; i++) {
+        if (write_full(fd, request, len + 1) != 0 || read_result(fd, -1, -1, &status) != 0) {
+            fprintf(stderr, "msh-client: connection lost\n");
+            return 1;
+        }
+    }
+
+    free(request);
+    close(fd);
+    return 0;
+}
+
+static int run_bench(const char *path, const char *line, long count, int clients) {
+    long per_client = count / clients;
+    int failed = 0;
+    double start = now();
+
+    for (int i = 0; i < clients; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(bench_client(path, line, per_client));
+        }
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < clients; i++) {
+        int status;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+
+    double elapsed = now() - start;
+    long total = per_client * clients;
+    printf("%-24s clients=%-3d commands=%-7ld %8.3f s %10.0f cmds/s\n",
+           line, clients, total, elapsed, total / elapsed);
+    return failed;
+}
+
+static char* join_args(int argc, char **argv) {
+    size_t len = 1;
+    for (int i = 0; i < argc; i++) {
+        len += strlen(argv[i]) + 1;
+    }
+
+    char *line = (char*)calloc(len, 1);
+    for (int i = 0; line && i < argc; i++) {
+        if (i > 0) strcat(line, " ");
+        strcat(line, argv[i]);
+    }
+    return line;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: msh-client SOCKET [COMMAND...]\n"
+                    "       msh-client --bench [-n COUNT] [-c CLIENTS] SOCKET [COMMAND...]\n");
+}
+
+int main(int argc, char **argv) {
+    int bench = 0;
+    long count = 10000;
+    int clients = 1;
+    int argi = 1;
+    int status = 0;
+
+    if (argi < argc && strcmp(argv[argi], "--bench") == 0) {
+        bench = 1;
+        argi++;
+        while (argi + 1 < argc && argv[argi][0] == '-') {
+            if (strcmp(argv[argi], "-n") == 0) {
+                count = atol(argv[argi + 1]);
+            } else if (strcmp(argv[argi], "-c") == 0) {
+                clients = atoi(argv[argi + 1]);
+            } else {
+                usage();
+                return 2;
+            }
+            argi += 2;
+        }
+    }
+
+    if (argi >= argc || count <= 0 || clients <= 0) {
+        usage();
+        return 2;
+    }
+
+    const char *path = argv[argi++];
+    char *line = argi < argc ? join_args(argc - argi, argv + argi) : NULL;
+
+    if (bench) {
+        int rc = run_bench(path, line ? line : "echo ok", count, clients);
+        free(line);
+        return rc;
+    }
+
+    int fd = connect_server(path);
+    if (fd < 0) {
+        free(line);
+        return 1;
+    }
+
+    if (line) {
+        if (run_line(fd, line, &status) != 0) {
+            fprintf(stderr, "msh-client: connection lost\n");
+            status = 1;
+        }
+    } else {
+        char input[MAX_INPUT_SIZE];
+        while (fgets(input, sizeof(input), stdin)) {
+            input[strcspn(input, "\n")] = '\0';
+            if (run_line(fd, input, &status) != 0) {
+                fprintf(stderr, "msh-client: connection lost\n");
+                status = 1;
+                break;
+            }
+        }
+    }
+
+    free(line);
+    close(fd);
+    return status & 0xff;
+}
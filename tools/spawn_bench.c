@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+
+#include "../include/shell.h"
+#include <time.h>
+#include <sys/mman.h>
+
+/*
+ * Spawn latency benchmark: direct fork/exec vs the spawn zygote
+ *
+ *   spawn-bench [-n COUNT] [-m MEGABYTES] [COMMAND...]
+ *       Start a zygote, grow this process by MEGABYTES of touched memory
+ *       (emulating a long-running shell), then run COMMAND (default "true")
+ *       COUNT times each way and report the mean spawn+wait latency.
+ */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int spawn_direct(char **argv) {
+    int status;
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+        return -1;
+    }
+    return status;
+}
+
+static int spawn_zygote(char **argv) {
+    static const int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int status;
+    pid_t pid = zygote_spawn(argv, fds, NULL, NULL);
+
+    if (pid < 0 || zygote_wait(pid, &status) != 0) {
+        return -1;
+    }
+    return status;
+}
+
+static int run(const char *label, int (*spawn)(char **), char **argv, long count, long mb) {
+    double start = now();
+
+    for (long i = 0; i < count; i++) {
+        if (spawn(argv) != 0) {
+            fprintf(stderr, "spawn-bench: %s: %s failed\n", label, argv[0]);
+            return 1;
+        }
+    }
+
+    double elapsed = now() - start;
+    printf("%-16s rss=%5ld MB  spawns=%-6ld %8.1f us/spawn\n",
+           label, mb, count, elapsed * 1e6 / count);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static char *default_cmd[] = {"true", NULL};
+    long count = 1000;
+    long mb = 0;
+    int argi = 1;
+
+    while (argi + 1 < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-n") == 0) {
+            count = atol(argv[argi + 1]);
+        } else if (strcmp(argv[argi], "-m") == 0) {
+            mb = atol(argv[argi + 1]);
+        } else {
+            break;
+        }
+        argi += 2;
+    }
+    if (count <= 0 || mb < 0) {
+        fprintf(stderr, "usage: spawn-bench [-n COUNT] [-m MEGABYTES] [COMMAND...]\n");
+        return 2;
+    }
+
+    char **cmd = argi < argc ? argv + argi : default_cmd;
+
+    /* The zygote is forked while we are still small, as the shell does */
+    if (zygote_start() != 0) {
+        perror("zygote_start");
+        return 1;
+    }
+
+    if (mb > 0) {
+        size_t size = (size_t)mb << 20;
+        char *ballast = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ballast == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        for (size_t off = 0; off < size; off += 4096) {
+            ballast[off] = 1;
+        }
+    }
+
+    int rc = run("fork/exec", spawn_direct, cmd, count, mb);
+    rc |= run("zygote", spawn_zygote, cmd, count, mb);
+
+    zygote_stop();
+    return rc;
+}